@@ -0,0 +1,17 @@
+//
+// Created by sarah on 3/26/24.
+//
+
+#ifndef PASTEL_BENCH_H
+#define PASTEL_BENCH_H
+
+#include <time.h>
+
+// Seconds on the monotonic clock, for timing the steps of a benchmark.
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#endif //PASTEL_BENCH_H
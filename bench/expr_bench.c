@@ -0,0 +1,153 @@
+//
+// Created by sarah on 3/25/24.
+//
+
+/*
+ * Lexes, parses, flattens and expands functions returning one very deep expression of each shape the expression
+ * walks have to handle, and prints the time of every step. None of them may recurse along the chain, so this crashes
+ * on a stack overflow if one does. The expanded AST is flattened again and compared with the first flat AST.
+ *
+ *   expr_bench [depth]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lexer/lexer.h"
+#include "parser/parser.h"
+#include "parser/flat_ast.h"
+#include "../src/util/arena.h"
+#include "bench.h"
+
+typedef enum shape_t {
+    SHAPE_LEFT_CHAIN, // a + a + a ...
+    SHAPE_RIGHT_NESTED, // (a + (a + (a ...)))
+    SHAPE_MIXED, // a * a + a * a - a ...
+    SHAPE_PREFIX, // !!!...b
+    SHAPE_CASTS, // a to Int64 to Int32 ...
+    SHAPE_COUNT,
+} shape_t;
+
+static const char *shape_names[SHAPE_COUNT] = {
+        "left chain",
+        "right nested",
+        "mixed",
+        "prefix",
+        "casts",
+};
+
+typedef struct buffer_t {
+    char *data;
+    size_t size;
+    size_t capacity;
+} buffer_t;
+
+static void append(buffer_t *buffer, const char *str) {
+    size_t length = strlen(str);
+    if (buffer->size + length + 1 > buffer->capacity) {
+        while (buffer->size + length + 1 > buffer->capacity) buffer->capacity *= 2;
+        buffer->data = (char *) realloc(buffer->data, buffer->capacity);
+    }
+
+    memcpy(buffer->data + buffer->size, str, length + 1);
+    buffer->size += length;
+}
+
+static char *generate(shape_t shape, size_t depth, size_t *size) {
+    buffer_t buffer = { (char *) malloc(1024), 0, 1024 };
+    size_t i;
+
+    append(&buffer, "func f(a: Int32, b: Bool): Int32 {\n    return ");
+
+    switch (shape) {
+        case SHAPE_LEFT_CHAIN:
+            append(&buffer, "a");
+            for (i = 0; i < depth; i++) append(&buffer, " + a");
+            break;
+        case SHAPE_RIGHT_NESTED:
+            for (i = 0; i < depth; i++) append(&buffer, "(a + ");
+            append(&buffer, "a");
+            for (i = 0; i < depth; i++) append(&buffer, ")");
+            break;
+        case SHAPE_MIXED:
+            append(&buffer, "a");
+            for (i = 0; i < depth; i++) append(&buffer, i % 2 ? " * a" : i % 4 ? " - a" : " + a");
+            break;
+        case SHAPE_PREFIX:
+            for (i = 0; i < depth; i++) append(&buffer, "!");
+            append(&buffer, "b to Int32");
+            break;
+        case SHAPE_CASTS:
+            append(&buffer, "a");
+            for (i = 0; i < depth; i++) append(&buffer, i % 2 ? " to Int32" : " to Int64");
+            break;
+        default:
+            break;
+    }
+
+    append(&buffer, "\n}\n");
+
+    *size = buffer.size;
+    return buffer.data;
+}
+
+static int run(shape_t shape, size_t depth) {
+    size_t size;
+    char *source = generate(shape, depth, &size);
+
+    double start = now();
+    lexer_t *lexer = lexer_new(source, size);
+    lexer_lex_all(lexer);
+    token_stream_t *tokens = lexer_get_tokens(lexer);
+    lexer_free(lexer);
+    double lexed = now();
+
+    arena_t *arena = arena_new();
+    parser_t *parser = parser_new(tokens, arena);
+    ptr_list_t *stmts = parser_parse_all(parser);
+    parser_free(parser);
+    double parsed = now();
+
+    if (stmts == NULL) {
+        fprintf(stderr, "Failed to parse the %s expression!\n", shape_names[shape]);
+        return 0;
+    }
+
+    flat_ast_t *ast = flat_ast_from_stmts(stmts);
+    double flattened = now();
+
+    arena_t *expanded_arena = arena_new();
+    ptr_list_t *expanded = flat_ast_expand(ast, expanded_arena);
+    double expanded_time = now();
+
+    flat_ast_t *round_trip = flat_ast_from_stmts(expanded);
+    int ok = flat_ast_equal(ast, round_trip);
+
+    printf("%-12s %9lu tokens  lex %7.2f ms  parse %7.2f ms  flatten %7.2f ms  expand %7.2f ms%s\n",
+           shape_names[shape], tokens->size, (lexed - start) * 1e3, (parsed - lexed) * 1e3,
+           (flattened - parsed) * 1e3, (expanded_time - flattened) * 1e3, ok ? "" : "  MISMATCH");
+
+    flat_ast_free(round_trip);
+    flat_ast_free(ast);
+    arena_free(expanded_arena);
+    arena_free(arena);
+    token_stream_free(tokens);
+    free(source);
+
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    size_t depth = argc > 1 ? (size_t) strtoul(argv[1], NULL, 10) : 100000;
+    int ok = 1;
+
+    printf("depth %lu\n", depth);
+
+    shape_t shape;
+    for (shape = 0; shape < SHAPE_COUNT; shape++) {
+        if (!run(shape, depth)) ok = 0;
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,184 @@
+//
+// Created by sarah on 3/26/24.
+//
+
+/*
+ * Applies a series of edits to a generated source through the incremental parser and prints the time of every update
+ * next to the time of lexing and parsing the edited source from scratch. After every edit, the statements of the
+ * incremental parser are compared with the ones of the full parse, and the statements reported as changed and removed
+ * with the ones the edit should have touched. The syntax error is reported by the full parse the update falls back to.
+ *
+ *   incremental_bench [functions]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lexer/lexer.h"
+#include "parser/parser.h"
+#include "parser/flat_ast.h"
+#include "parser/incremental.h"
+#include "../src/util/arena.h"
+#include "bench.h"
+
+typedef struct bench_edit_t {
+    const char *name;
+    const char *find; // The edit replaces the first occurrence of this with replacement
+    const char *replacement;
+    int is_error; // Whether the edited source has a syntax error
+    size_t changed;
+    size_t removed;
+} bench_edit_t;
+
+// The functions are f0, f1, ... and each adds its number to its first parameter, see generate_source.
+static const bench_edit_t edits[] = {
+        { "literal", "a + 25;", "a + 4200;", 0, 1, 0 },
+        { "insertion", "func f10(", "func inserted(a: Int32): Int32 {\n    return a;\n}\n\nfunc f10(", 0, 1, 0 },
+        { "deletion", "func inserted(a: Int32): Int32 {\n    return a;\n}\n\n", "", 0, 0, 1 },
+        { "syntax error", "return x * b;\n}\n\nfunc f20(", "return x * b;\n\nfunc f20(", 1, 0, 0 },
+        { "fix", "return x * b;\n\nfunc f20(", "return x * b;\n}\n\nfunc f20(", 0, 0, 0 },
+        { "whitespace", "a + 30;", "a   +   30;", 0, 0, 0 },
+        { "rename", "func f40(", "func g40(", 0, 1, 1 },
+};
+
+#define EDIT_COUNT (sizeof(edits) / sizeof(edits[0]))
+
+static char *generate_source(size_t functions, size_t *size) {
+    const char *format = "func f%lu(a: Int32, b: Int32): Int32 {\n"
+                         "    var x: Int32 = a + %lu;\n"
+                         "    return x * b;\n"
+                         "}\n\n";
+
+    size_t capacity = functions * (strlen(format) + 40) + 1;
+    char *source = (char *) malloc(capacity);
+
+    size_t length = 0;
+    size_t i;
+    for (i = 0; i < functions; i++) {
+        length += (size_t) sprintf(source + length, format, i, i);
+    }
+
+    *size = length;
+    return source;
+}
+
+// Returns the edited copy of source, the incremental parser needs the old one until it's done with the update.
+static char *apply_edit(const char *source, size_t size, const bench_edit_t *bench_edit, size_t *new_size,
+                        source_edit_t *edit) {
+    const char *found = strstr(source, bench_edit->find);
+    if (found == NULL) return NULL;
+
+    edit->offset = (size_t) (found - source);
+    edit->old_length = strlen(bench_edit->find);
+    edit->new_length = strlen(bench_edit->replacement);
+
+    *new_size = size - edit->old_length + edit->new_length;
+    char *edited = (char *) malloc(*new_size + 1);
+
+    memcpy(edited, source, edit->offset);
+    memcpy(edited + edit->offset, bench_edit->replacement, edit->new_length);
+    memcpy(edited + edit->offset + edit->new_length, found + edit->old_length, size - edit->offset - edit->old_length);
+    edited[*new_size] = '\0';
+
+    return edited;
+}
+
+// Lexes and parses source from scratch, NULL on syntax errors.
+static ptr_list_t *parse_full(const char *source, size_t size, arena_t *arena) {
+    lexer_t *lexer = lexer_new(source, size);
+    lexer_lex_all(lexer);
+    token_stream_t *tokens = lexer_get_tokens(lexer);
+    lexer_free(lexer);
+
+    parser_t *parser = parser_new(tokens, arena);
+    parser_set_quiet(parser, 1);
+    ptr_list_t *stmts = parser_parse_all(parser);
+    parser_free(parser);
+
+    token_stream_free(tokens);
+    return stmts;
+}
+
+static int stmts_equal(ptr_list_t *a, ptr_list_t *b) {
+    flat_ast_t *flat_a = flat_ast_from_stmts(a);
+    flat_ast_t *flat_b = flat_ast_from_stmts(b);
+    int equal = flat_ast_equal(flat_a, flat_b);
+
+    flat_ast_free(flat_a);
+    flat_ast_free(flat_b);
+
+    return equal;
+}
+
+static int run_edit(incremental_parser_t *incremental, char **source, size_t *size, const bench_edit_t *bench_edit) {
+    size_t new_size;
+    source_edit_t edit;
+    char *edited = apply_edit(*source, *size, bench_edit, &new_size, &edit);
+    if (edited == NULL) {
+        fprintf(stderr, "Can't find the text of the %s edit!\n", bench_edit->name);
+        return 0;
+    }
+
+    double start = now();
+    int failed = incremental_parser_update(incremental, edited, new_size, edit);
+    double updated = now();
+
+    arena_t *arena = arena_new();
+    ptr_list_t *full = parse_full(edited, new_size, arena);
+    double parsed = now();
+
+    free(*source);
+    *source = edited;
+    *size = new_size;
+
+    size_t changed = ptr_list_size(incremental_parser_changed(incremental));
+    size_t removed = ptr_list_size(incremental_parser_removed(incremental));
+
+    int ok = failed == bench_edit->is_error && (full == NULL) == bench_edit->is_error;
+    if (ok && !failed) {
+        ok = changed == bench_edit->changed && removed == bench_edit->removed &&
+             stmts_equal(incremental_parser_stmts(incremental), full);
+    }
+
+    printf("%-14s update %8.3f ms  full %8.3f ms  changed %lu  removed %lu%s%s\n", bench_edit->name,
+           (updated - start) * 1e3, (parsed - updated) * 1e3, changed, removed, failed ? "  (syntax error)" : "",
+           ok ? "" : "  MISMATCH");
+
+    if (full != NULL) ptr_list_free(full);
+    arena_free(arena);
+
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    size_t functions = argc > 1 ? (size_t) strtoul(argv[1], NULL, 10) : 10000;
+    if (functions < 41) {
+        fprintf(stderr, "The edits need at least 41 functions!\n");
+        return 1;
+    }
+
+    size_t size;
+    char *source = generate_source(functions, &size);
+
+    incremental_parser_t *incremental = incremental_parser_new();
+
+    double start = now();
+    int ok = incremental_parser_parse(incremental, source, size) == 0;
+    printf("%lu functions, %lu bytes, initial parse %.3f ms\n", functions, size, (now() - start) * 1e3);
+
+    size_t i;
+    for (i = 0; i < EDIT_COUNT && ok; i++) {
+        ok = run_edit(incremental, &source, &size, &edits[i]);
+    }
+
+    incremental_parser_free(incremental);
+    free(source);
+
+    if (!ok) {
+        fprintf(stderr, "The incremental parser doesn't match a full parse!\n");
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,166 @@
+//
+// Created by sarah on 3/26/24.
+//
+
+/*
+ * Lexes a generated source that is almost only keywords, operators and identifiers that look like keywords, and
+ * prints the throughput. That's the work of the keyword and operator recognizer, every such token goes through it.
+ * The source is generated from a table of tokens, so every lexed token is also checked against the one it came from.
+ *
+ *   keyword_bench [functions] [repetitions]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lexer/lexer.h"
+#include "lexer/token.h"
+#include "bench.h"
+
+typedef struct bench_token_t {
+    const char *spelling;
+    token_type_t type;
+    int value; // keyword_t or operator_t, unused for the other types
+} bench_token_t;
+
+#define KEYWORD(spelling, keyword) { spelling, TOKEN_KEYWORD, keyword }
+#define OPERATOR(spelling, op) { spelling, TOKEN_OPERATOR, op }
+#define IDENTIFIER(spelling) { spelling, TOKEN_IDENTIFIER, 0 }
+#define CHAR(spelling) { spelling, TOKEN_CHAR, 0 }
+#define END { "\n", TOKEN_END_OF_STATEMENT, 0 }
+
+// One function, repeated for the whole source. The identifiers are prefixes and extensions of words the lexer knows.
+static const bench_token_t function_tokens[] = {
+        KEYWORD("func", KEYWORD_FUNCTION), IDENTIFIER("funcs"), CHAR("("), IDENTIFIER("t"), CHAR(":"),
+        IDENTIFIER("Int32"), CHAR(","), IDENTIFIER("tomato"), CHAR(":"), IDENTIFIER("Bool"), CHAR(")"), CHAR(":"),
+        IDENTIFIER("Int32"), CHAR("{"), END,
+        KEYWORD("var", KEYWORD_VAR), IDENTIFIER("iffy"), CHAR(":"), IDENTIFIER("Int32"), OPERATOR("=", OPERATOR_ASSIGN),
+        IDENTIFIER("t"), OPERATOR("+", OPERATOR_ADD), IDENTIFIER("t"), OPERATOR("*", OPERATOR_MUL), IDENTIFIER("t"),
+        OPERATOR("-", OPERATOR_SUB), IDENTIFIER("t"), OPERATOR("/", OPERATOR_DIV), IDENTIFIER("t"), END,
+        KEYWORD("let", KEYWORD_LET), IDENTIFIER("letter"), CHAR(":"), IDENTIFIER("Bool"),
+        OPERATOR("=", OPERATOR_ASSIGN), IDENTIFIER("tomato"), OPERATOR("==", OPERATOR_EQ),
+        KEYWORD("true", KEYWORD_TRUE), OPERATOR("!=", OPERATOR_NE), KEYWORD("false", KEYWORD_FALSE),
+        OPERATOR("==", OPERATOR_EQ), OPERATOR("!", OPERATOR_NOT), IDENTIFIER("truest"), END,
+        KEYWORD("while", KEYWORD_WHILE), IDENTIFIER("iffy"), OPERATOR("<=", OPERATOR_LE), IDENTIFIER("whiles"),
+        OPERATOR(">=", OPERATOR_GE), IDENTIFIER("forest"), OPERATOR("<", OPERATOR_LT), IDENTIFIER("falsehood"),
+        OPERATOR(">", OPERATOR_GT), IDENTIFIER("returned"), CHAR("{"), END,
+        IDENTIFIER("iffy"), OPERATOR("=", OPERATOR_ASSIGN), IDENTIFIER("iffy"), OPERATOR("to", OPERATOR_CAST),
+        IDENTIFIER("Int64"), OPERATOR("to", OPERATOR_CAST), IDENTIFIER("Int32"), END,
+        CHAR("}"), END,
+        KEYWORD("if", KEYWORD_IF), IDENTIFIER("letter"), CHAR("{"), END,
+        KEYWORD("return", KEYWORD_RETURN), IDENTIFIER("externs"), END,
+        CHAR("}"), KEYWORD("else", KEYWORD_ELSE), CHAR("{"), END,
+        KEYWORD("return", KEYWORD_RETURN), IDENTIFIER("elsewhere"), OPERATOR("+", OPERATOR_ADD), IDENTIFIER("variable"),
+        END,
+        CHAR("}"), END,
+        CHAR("}"), END,
+        KEYWORD("extern", KEYWORD_EXTERN), IDENTIFIER("fort"), CHAR("("), CHAR(")"), END,
+};
+
+#define FUNCTION_TOKEN_COUNT (sizeof(function_tokens) / sizeof(function_tokens[0]))
+
+// Tokens are separated by a blank, except around the newlines, which are tokens of their own.
+static char *generate_source(size_t functions, size_t *size) {
+    size_t function_size = 0;
+    size_t i;
+    for (i = 0; i < FUNCTION_TOKEN_COUNT; i++) {
+        function_size += strlen(function_tokens[i].spelling) + 1;
+    }
+
+    char *source = (char *) malloc(function_size * functions + 1);
+    char *end = source;
+
+    size_t f;
+    for (f = 0; f < functions; f++) {
+        for (i = 0; i < FUNCTION_TOKEN_COUNT; i++) {
+            size_t length = strlen(function_tokens[i].spelling);
+            memcpy(end, function_tokens[i].spelling, length);
+            end += length;
+
+            if (function_tokens[i].type != TOKEN_END_OF_STATEMENT) *end++ = ' ';
+        }
+    }
+
+    *end = '\0';
+    *size = (size_t) (end - source);
+    return source;
+}
+
+static int token_matches(token_stream_t *tokens, size_t i, const bench_token_t *expected) {
+    if (tokens->types[i] != expected->type) return 0;
+
+    switch (expected->type) {
+        case TOKEN_KEYWORD:
+            return tokens->values[i].keyword == (keyword_t) expected->value;
+        case TOKEN_OPERATOR:
+            return tokens->values[i].op == (operator_t) expected->value;
+        case TOKEN_CHAR:
+            return tokens->values[i].character == expected->spelling[0];
+        case TOKEN_IDENTIFIER:
+            return strcmp(tokens->values[i].name, expected->spelling) == 0;
+        default:
+            return 1;
+    }
+}
+
+static int check_tokens(token_stream_t *tokens, size_t functions) {
+    if (tokens->size != functions * FUNCTION_TOKEN_COUNT + 1) {
+        fprintf(stderr, "Expected %lu tokens, got %lu!\n", functions * FUNCTION_TOKEN_COUNT + 1, tokens->size);
+        return 0;
+    }
+
+    size_t i;
+    for (i = 0; i + 1 < tokens->size; i++) {
+        const bench_token_t *expected = &function_tokens[i % FUNCTION_TOKEN_COUNT];
+        if (!token_matches(tokens, i, expected)) {
+            fprintf(stderr, "Token %lu should be '%s'!\n", i, expected->spelling);
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static token_stream_t *lex(const char *source, size_t size) {
+    lexer_t *lexer = lexer_new(source, size);
+    lexer_lex_all(lexer);
+
+    token_stream_t *tokens = lexer_get_tokens(lexer);
+    lexer_free(lexer);
+    return tokens;
+}
+
+int main(int argc, char **argv) {
+    size_t functions = argc > 1 ? (size_t) strtoul(argv[1], NULL, 10) : 20000;
+    int repetitions = argc > 2 ? atoi(argv[2]) : 5;
+
+    size_t size;
+    char *source = generate_source(functions, &size);
+
+    token_stream_t *tokens = lex(source, size);
+    int ok = check_tokens(tokens, functions);
+    size_t token_count = tokens->size;
+    token_stream_free(tokens);
+
+    double best = 1e9;
+    int r;
+    for (r = 0; r < repetitions; r++) {
+        double start = now();
+        token_stream_free(lex(source, size));
+        double elapsed = now() - start;
+        if (elapsed < best) best = elapsed;
+    }
+
+    printf("%lu bytes, %lu tokens\n", size, token_count);
+    printf("%8.2f ms %8.1f Mtok/s\n", best * 1e3, token_count / best / 1e6);
+
+    free(source);
+
+    if (!ok) {
+        fprintf(stderr, "Keywords or operators were lexed wrong!\n");
+        return 1;
+    }
+
+    return 0;
+}
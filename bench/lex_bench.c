@@ -0,0 +1,124 @@
+//
+// Created by sarah on 3/23/24.
+//
+
+/*
+ * Lexes a source with 1, 2, 4, ... threads up to the CPU count and prints the throughput of each. Every parallel
+ * stream is checked against the sequential one, so this doubles as a check that chunking doesn't change the tokens.
+ *
+ *   lex_bench <file.pstl> [repetitions]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lexer/lexer.h"
+#include "lexer/token.h"
+#include "../src/util/source.h"
+#include "../src/util/thread_pool.h"
+#include "bench.h"
+
+// Only the member of the value that belongs to the token type is set, the rest of the union is garbage.
+static int values_equal(token_type_t type, token_value_t *a, token_value_t *b) {
+    switch (type) {
+        case TOKEN_IDENTIFIER:
+            return a->name == b->name;
+        case TOKEN_INTEGER:
+            return a->integer == b->integer;
+        case TOKEN_FLOAT:
+            return memcmp(&a->floating, &b->floating, sizeof(double)) == 0;
+        case TOKEN_CHAR:
+            return a->character == b->character;
+        case TOKEN_KEYWORD:
+            return a->keyword == b->keyword;
+        case TOKEN_OPERATOR:
+            return a->op == b->op;
+        default:
+            return 1;
+    }
+}
+
+static int streams_equal(token_stream_t *a, token_stream_t *b) {
+    if (a->size != b->size) return 0;
+
+    size_t i;
+    for (i = 0; i < a->size; i++) {
+        if (a->types[i] != b->types[i] || a->offsets[i] != b->offsets[i] || a->lengths[i] != b->lengths[i]) return 0;
+        if (!values_equal((token_type_t) a->types[i], &a->values[i], &b->values[i])) return 0;
+    }
+
+    return 1;
+}
+
+static token_stream_t *lex_sequential(source_t *source) {
+    lexer_t *lexer = lexer_new(source_data(source), source_size(source));
+    lexer_lex_all(lexer);
+
+    token_stream_t *tokens = lexer_get_tokens(lexer);
+    lexer_free(lexer);
+    return tokens;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <file.pstl> [repetitions]\n", argv[0]);
+        return 1;
+    }
+
+    int repetitions = argc > 2 ? atoi(argv[2]) : 5;
+
+    source_t *source = source_open(argv[1]);
+    if (source == NULL) return 1;
+
+    token_stream_t *expected = lex_sequential(source);
+    if (expected == NULL) return 1;
+
+    double best = 1e9;
+    int r;
+    for (r = 0; r < repetitions; r++) {
+        double start = now();
+        token_stream_free(lex_sequential(source));
+        double elapsed = now() - start;
+        if (elapsed < best) best = elapsed;
+    }
+
+    double sequential = best;
+    printf("%lu bytes, %lu tokens\n", source_size(source), expected->size);
+    printf("sequential  %8.2f ms %8.1f Mtok/s\n", sequential * 1e3, expected->size / sequential / 1e6);
+
+    size_t cpu_count = thread_pool_cpu_count();
+    size_t threads = 1;
+    int ok = 1;
+    while (1) {
+        thread_pool_t *pool = thread_pool_new(threads);
+
+        best = 1e9;
+        for (r = 0; r < repetitions; r++) {
+            double start = now();
+            token_stream_t *tokens = lexer_lex_parallel(source_data(source), source_size(source), pool);
+            double elapsed = now() - start;
+            if (elapsed < best) best = elapsed;
+
+            if (!streams_equal(expected, tokens)) ok = 0;
+            token_stream_free(tokens);
+        }
+
+        printf("%2lu threads  %8.2f ms %8.1f Mtok/s  %5.2fx\n", threads, best * 1e3,
+               expected->size / best / 1e6, sequential / best);
+        thread_pool_free(pool);
+
+        if (threads == cpu_count) break;
+        threads = threads * 2 < cpu_count ? threads * 2 : cpu_count; // Always end on cpu_count
+    }
+
+    token_stream_free(expected);
+    source_close(source);
+
+    if (!ok) {
+        fprintf(stderr, "Parallel token stream differs from the sequential one!\n");
+        return 1;
+    }
+
+    return 0;
+}
@@ -7,6 +7,8 @@
 
 #include <llvm-c/Types.h>
 #include "../../src/util/ptr_list.h"
+#include "../parser/ast.h"
+#include "../parser/parser.h"
 
 typedef enum compiler_opt_level_t {
     OPT_NONE,
@@ -18,11 +20,20 @@ typedef struct compiler_t compiler_t;
 compiler_t *compiler_new(ptr_list_t *stmts, compiler_opt_level_t opt_level);
 int compiler_compile(compiler_t *compiler);
 
+/*
+ * Compiles only the functions reachable from main, starting with main and following calls. Bodies that parser
+ * skipped are parsed when their function is first reached. Returns 1 on error.
+ */
+int compiler_compile_lazy(compiler_t *compiler, parser_t *parser);
+
+// Compiles one more top level statement and appends it to the compiler's statements. Returns 1 on error.
+int compiler_compile_stmt(compiler_t *compiler, stmt_t *stmt);
+
 void compiler_dump_all(compiler_t *compiler, int open_cfg);
 
 int compiler_is_main_void(compiler_t *compiler);
 LLVMValueRef compiler_get_main(compiler_t *compiler);
 LLVMModuleRef compiler_get_module(compiler_t *compiler);
-LLVMValueRef compiler_get_function(compiler_t *compiler, wchar_t *name);
+LLVMValueRef compiler_get_function(compiler_t *compiler, const char *name);
 
 #endif //PASTEL_COMPILER_H
@@ -6,16 +6,47 @@
 #define PASTEL_LEXER_H
 
 #include <stddef.h>
-#include "../../src/util/ptr_list.h"
+#include "token.h"
+#include "../../src/util/thread_pool.h"
 
 typedef struct lexer_t lexer_t;
 
 /*
- * input MUST be null-terminated, because it allows us to skip a lot of checks.
+ * input is the raw source text and MUST be null-terminated, because it allows us to skip a lot of checks. The lexer
+ * doesn't copy it, so it has to outlive the lexer and its tokens. Returns NULL for sources of 4 GiB or more.
  */
-lexer_t *lexer_new(const wchar_t *input, size_t size);
+lexer_t *lexer_new(const char *input, size_t size);
+
+/*
+ * Creates a lexer that only produces tokens on demand through lexer_next_token(). Its token stream is a window over
+ * the last LEXER_WINDOW_SIZE tokens, which is owned by the lexer.
+ */
+lexer_t *lexer_new_streaming(const char *input, size_t size);
+void lexer_free(lexer_t *lexer);
+
+#define LEXER_WINDOW_SIZE 16
 
 void lexer_lex_all(lexer_t *lexer);
-ptr_list_t *lexer_get_tokens(lexer_t *lexer);
+
+/*
+ * Lexes input from start up to end, without a TOKEN_NULL at the end. Token offsets are relative to input, not to start.
+ * Both ends have to lie between tokens, for example at the start of a line. The caller owns the returned stream.
+ */
+token_stream_t *lexer_lex_range(const char *input, size_t start, size_t end);
+
+/*
+ * Lexes the whole input on the pool's threads and returns the same stream lexer_lex_all() would produce, owned by the
+ * caller. Returns NULL for sources of 4 GiB or more.
+ */
+token_stream_t *lexer_lex_parallel(const char *input, size_t size, thread_pool_t *pool);
+
+// Lexes exactly one more token into the stream. At the end of the input, that's the final TOKEN_NULL.
+void lexer_next_token(lexer_t *lexer);
+
+/*
+ * For normal lexers, returns the stream once lexer_lex_all() is done, and the caller owns it. For streaming lexers,
+ * returns the window, which is filled as tokens are requested.
+ */
+token_stream_t *lexer_get_tokens(lexer_t *lexer);
 
 #endif //PASTEL_LEXER_H
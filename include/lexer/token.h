@@ -2,6 +2,7 @@
 #define PASTEL_TOKEN_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 typedef enum token_type_t {
     TOKEN_NULL = 0,
@@ -12,6 +13,7 @@ typedef enum token_type_t {
     TOKEN_KEYWORD,
     TOKEN_OPERATOR,
     TOKEN_END_OF_STATEMENT,
+    TOKEN_INVALID_INTEGER, // An integer literal that doesn't fit any integer type, the parser reports it
 } token_type_t;
 
 typedef enum keyword_t {
@@ -28,63 +30,121 @@ typedef enum keyword_t {
     KEYWORD_WHILE,
 } keyword_t;
 
+// The order of the first twelve has to match the operator DFA states in the lexer.
+typedef enum operator_t {
+    OPERATOR_ASSIGN,
+    OPERATOR_NOT,
+    OPERATOR_LT,
+    OPERATOR_GT,
+    OPERATOR_ADD,
+    OPERATOR_SUB,
+    OPERATOR_MUL,
+    OPERATOR_DIV,
+    OPERATOR_EQ,
+    OPERATOR_NE,
+    OPERATOR_LE,
+    OPERATOR_GE,
+    OPERATOR_CAST,
+    OPERATOR_COUNT,
+} operator_t;
+
+// Type suffix of a number literal, like the u8 in 10u8.
+typedef enum number_suffix_t {
+    SUFFIX_NONE,
+    SUFFIX_I8,
+    SUFFIX_I16,
+    SUFFIX_I32,
+    SUFFIX_I64,
+    SUFFIX_U8,
+    SUFFIX_U16,
+    SUFFIX_U32,
+    SUFFIX_U64,
+    SUFFIX_F32,
+    SUFFIX_F64,
+    SUFFIX_COUNT,
+} number_suffix_t;
+
+#define is_float_suffix(suffix) ((suffix) == SUFFIX_F32 || (suffix) == SUFFIX_F64)
+
+// Only computed when needed, tokens just store their offset.
 typedef struct token_pos_t {
     size_t line;
     size_t column;
 } token_pos_t;
 
-typedef struct token_t {
-    token_type_t type;
-    token_pos_t token_pos;
-    void *data;
-} token_t;
-
-typedef struct token_identifier_t {
-    token_type_t type;
-    token_pos_t token_pos;
-    wchar_t *value;
-} token_identifier_t;
-
-typedef struct token_integer_t {
-    token_type_t type;
-    token_pos_t token_pos;
-    int value;
-} token_integer_t;
-
-typedef struct token_float_t {
-    token_type_t type;
-    token_pos_t token_pos;
-    double *value;
-} token_float_t;
-
-typedef struct token_char_t {
-    token_type_t type;
-    token_pos_t token_pos;
-    wchar_t value;
-} token_char_t;
-
-typedef struct token_keyword_t {
-    token_type_t type;
-    token_pos_t token_pos;
+/*
+ * Payload of a token. For identifiers, that's their interned spelling. Integers hold the value of the literal, which
+ * fits Int64 unless it has the u64 suffix. Then it's never negative, and values above INT64_MAX come out negative.
+ */
+typedef union token_value_t {
+    int64_t integer;
+    double floating;
+    char character;
     keyword_t keyword;
-} token_keyword_t;
+    operator_t op;
+    char *name;
+} token_value_t;
+
+/*
+ * Tokens of a source, stored as parallel arrays. Token number i lives in slot token_slot(stream, i): it has the type
+ * types[slot] and spans lengths[slot] bytes starting at input + offsets[slot]. The last token of a source is always a
+ * TOKEN_NULL marking the end of the input. Sources are limited to 4 GiB so offsets fit 32 bits.
+ *
+ * A stream either holds all tokens (slot == i), or it is a fixed size window over the most recent tokens, which is
+ * what the streaming lexer fills. size is the total number of tokens pushed either way.
+ */
+typedef struct token_stream_t {
+    const char *input;
+
+    unsigned char *types; // token_type_t
+    uint32_t *offsets;
+    uint32_t *lengths;
+    token_value_t *values;
+    struct line_index_t *lines; // Built on the first call to token_stream_position
+
+    size_t size;
+    size_t capacity;
+    size_t mask; // capacity - 1 for windows, all ones otherwise
+} token_stream_t;
+
+token_stream_t *token_stream_new(const char *input, size_t capacity);
+// capacity has to be a power of two.
+token_stream_t *token_stream_new_window(const char *input, size_t capacity);
+void token_stream_free(token_stream_t *stream);
+
+// Appends a token and returns its slot. The value of the token is left uninitialized.
+size_t token_stream_push(token_stream_t *stream, token_type_t type, size_t offset, size_t length);
+
+/*
+ * Copies the tokens of several streams over the same input into one new stream, in order. The parts must not be
+ * windows and stay owned by the caller.
+ */
+token_stream_t *token_stream_concat(const char *input, token_stream_t **parts, size_t count, size_t extra_capacity);
+
+/*
+ * Returns a new stream over input, with the tokens [start, end) of stream replaced by those of replacement. The offsets
+ * of the tokens behind the replaced ones are moved by offset_delta. Neither stream may be a window.
+ */
+token_stream_t *token_stream_splice(token_stream_t *stream, const char *input, size_t start, size_t end,
+                                    token_stream_t *replacement, long offset_delta);
+
+// Line and column of token i, for diagnostics. The token has to still be in the stream.
+token_pos_t token_stream_position(token_stream_t *stream, size_t i);
+
+#define token_slot(stream, i) ((i) & (stream)->mask)
+#define token_spelling(stream, i) ((stream)->input + (stream)->offsets[token_slot(stream, i)])
+
+const char *operator_spelling(operator_t op);
 
-typedef struct token_operator_t {
-    token_type_t type;
-    token_pos_t token_pos;
-    wchar_t *op;
-} token_operator_t;
+// SUFFIX_NONE if str isn't a suffix.
+number_suffix_t number_suffix_from_spelling(const char *str, size_t length);
 
-token_t *token_new(token_type_t type, token_pos_t token_pos);
-token_identifier_t *token_new_identifier(const wchar_t *start, size_t length, token_pos_t token_pos);
-token_integer_t *token_new_integer(int value, token_pos_t token_pos);
-token_float_t *token_new_float(double value, token_pos_t token_pos);
-token_char_t *token_new_char(wchar_t value, token_pos_t token_pos);
-token_keyword_t *token_new_keyword(keyword_t keyword, token_pos_t token_pos);
-token_operator_t *token_new_operator(const wchar_t *start, size_t length, token_pos_t token_pos);
+// Suffix of the number token i, SUFFIX_NONE if it has none.
+number_suffix_t token_number_suffix(token_stream_t *stream, size_t i);
 
-void DEBUG_token_print(token_t *token);
+// Name of the type a suffix stands for.
+const char *number_suffix_type_name(number_suffix_t suffix);
 
-void token_free(token_t *token);
+void DEBUG_token_print(token_stream_t *stream, size_t i);
 
 #endif //PASTEL_TOKEN_H
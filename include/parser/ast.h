@@ -7,6 +7,7 @@
 
 #include <stddef.h>
 #include "../../src/util/ptr_list.h"
+#include "../lexer/token.h"
 
 typedef enum expr_type_t {
     EXPR_BOOL,
@@ -27,6 +28,7 @@ typedef enum stmt_type_t {
     STMT_EXTERN,
     STMT_ASSIGNMENT,
     STMT_WHILE,
+    STMT_DECLARATION,
 } stmt_type_t;
 
 typedef enum variable_flags_t {
@@ -37,37 +39,46 @@ typedef enum variable_flags_t {
     VAR_IS_POINTER = 0x8,
 } variable_flags_t;
 
+// Slot of a variable that isn't resolved yet, see resolver.h.
+#define SLOT_NONE ((size_t) -1)
+
 typedef struct typed_ast_value_t {
-    wchar_t *name;
-    wchar_t *type;
+    char *name;
+    char *type;
     variable_flags_t flags;
 } typed_ast_value_t;
 
 typedef struct prototype_t {
-    wchar_t *name;
-    wchar_t *return_type;
+    char *name;
+    char *return_type;
     int is_extern;
     ptr_list_t *arguments; // List<typed_ast_value_t *>
 } prototype_t;
 
+// Defined by codegen. The checker annotates the AST with them, see checker.h.
+struct type_t;
+struct function_t;
+
 /* Expression data structs */
 
 typedef struct expr_t expr_t;
 
 typedef struct unary_expr_data_t {
-    wchar_t *op;
+    operator_t op;
     expr_t *value;
 } unary_expr_data_t;
 
 typedef struct binary_expr_data_t {
-    wchar_t *op;
+    operator_t op;
     expr_t *lhs;
     expr_t *rhs;
+    struct type_t *operand_type; // Both operands are converted to it before op applies
 } binary_expr_data_t;
 
 typedef struct call_expr_data_t {
-    wchar_t *callee_name;
+    char *callee_name;
     ptr_list_t *arguments; // List<expr_t *>
+    struct function_t *callee;
 } call_expr_data_t;
 
 typedef struct if_expr_data_t {
@@ -78,58 +89,71 @@ typedef struct if_expr_data_t {
 
 typedef struct cast_expr_data_t {
     expr_t *value;
-    wchar_t *type;
+    char *type;
 } cast_expr_data_t;
 
-/* Expressions */
+/* Expressions, checked_type is the type of the expression's value */
 
 struct expr_t {
     expr_type_t expr_type;
+    struct type_t *checked_type;
     void *data;
 };
 
 typedef struct int_expr_t {
     expr_type_t expr_type;
-    int data;
+    struct type_t *checked_type;
+    char *type; // From the literal's suffix, NULL if it has none
+    int64_t data;
 } int_expr_t;
 
 typedef struct bool_expr_t {
     expr_type_t expr_type;
+    struct type_t *checked_type;
     int data;
 } bool_expr_t;
 
 typedef struct float_expr_t {
     expr_type_t expr_type;
+    struct type_t *checked_type;
+    char *type; // From the literal's suffix, NULL if it has none
     double *data;
 } float_expr_t;
 
 typedef struct variable_expr_t {
     expr_type_t expr_type;
-    wchar_t *name;
+    struct type_t *checked_type;
+    char *name;
+    size_t slot;
 } variable_expr_t;
 
 typedef struct unary_expr_t {
     expr_type_t expr_type;
+    struct type_t *checked_type;
     unary_expr_data_t *data;
 } unary_expr_t;
 
 typedef struct binary_expr_t {
     expr_type_t expr_type;
+    struct type_t *checked_type;
     binary_expr_data_t *data;
 } binary_expr_t;
 
 typedef struct call_expr_t {
     expr_type_t expr_type;
+    struct type_t *checked_type;
     call_expr_data_t *data;
 } call_expr_t;
 
 typedef struct if_expr_t {
     expr_type_t expr_type;
+    struct type_t *checked_type;
     if_expr_data_t *data;
 } if_expr_t;
 
 typedef struct cast_expr_t {
     expr_type_t expr_type;
+    struct type_t *checked_type;
     cast_expr_data_t *data;
 } cast_expr_t;
 
@@ -137,15 +161,24 @@ typedef struct cast_expr_t {
 
 typedef struct function_stmt_data_t {
     prototype_t *prototype;
-    ptr_list_t *variables; // List<typed_ast_value_t *>
-    ptr_list_t *body; // List<stmt_t *>
+    ptr_list_t *variables; // List<typed_ast_value_t *>, NULL while the body isn't parsed
+    ptr_list_t *body; // List<stmt_t *>, NULL while the body isn't parsed
+    size_t body_token; // Token of the body's '{', for parsing skipped bodies later
 } function_stmt_data_t;
 
 typedef struct assignment_stmt_data_t {
-    wchar_t *name;
+    char *name;
+    size_t slot;
     expr_t *value;
 } assignment_stmt_data_t;
 
+typedef struct declaration_stmt_data_t {
+    typed_ast_value_t *variable;
+    size_t index; // Of the variable in its function's variables
+    size_t slot;
+    expr_t *value; // NULL if the variable isn't initialized
+} declaration_stmt_data_t;
+
 typedef struct while_stmt_data_t {
     expr_t *condition;
     ptr_list_t *body; // List<stmt_t *>
@@ -188,7 +221,46 @@ typedef struct while_stmt_t {
     while_stmt_data_t *data;
 } while_stmt_t;
 
+typedef struct declaration_stmt_t {
+    stmt_type_t stmt_type;
+    declaration_stmt_data_t *data;
+} declaration_stmt_t;
+
 void print_stmt(stmt_t *stmt, int indent);
 void print_expr(expr_t *expr, int indent);
 
+#define is_operator_expr(expr) \
+    ((expr)->expr_type == EXPR_UNARY || (expr)->expr_type == EXPR_BINARY || (expr)->expr_type == EXPR_CAST)
+
+/*
+ * Appends the operators of the chain starting at expr and their other operands to order, so that going through it
+ * backwards visits every operand before its operator, left to right. Operator chains can be arbitrarily deep, so
+ * walks over them use this instead of recursion. stack is scratch space, left as it was found.
+ */
+void collect_operator_chain(expr_t *expr, ptr_list_t *order, ptr_list_t *stack);
+
+// Scratch space of walk_operator_chain, reused by every walk. A nested walk works past the entries of the one it's in.
+typedef struct chain_walker_t {
+    ptr_list_t *order; // List<expr_t *>, see collect_operator_chain
+    ptr_list_t *stack;
+} chain_walker_t;
+
+// Visits a node of an operator chain, returns non-zero to stop the walk.
+typedef int (*chain_visitor_t)(void *context, expr_t *expr);
+
+void chain_walker_init(chain_walker_t *walker);
+void chain_walker_free(chain_walker_t *walker);
+
+/*
+ * Visits the operands of the chain starting at expr with visit_operand and then its operators with visit_operator,
+ * every operand before its operator, left to right. Either visitor may be NULL. Returns what the visitor that stopped
+ * the walk returned, or 0.
+ *
+ * Operands are everything but operators, a visitor of one can start a walk of its own for the expressions inside it.
+ * Those only nest as deep as the parser allows, while chains can be arbitrarily deep, which is why they're walked
+ * without recursion.
+ */
+int walk_operator_chain(chain_walker_t *walker, expr_t *expr, chain_visitor_t visit_operand,
+                        chain_visitor_t visit_operator, void *context);
+
 #endif //PASTEL_AST_H
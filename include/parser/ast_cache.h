@@ -0,0 +1,34 @@
+//
+// Created by sarah on 3/25/24.
+//
+
+#ifndef PASTEL_AST_CACHE_H
+#define PASTEL_AST_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "flat_ast.h"
+
+/*
+ * On-disk cache of parsed sources, so a source that didn't change since its last run is neither lexed nor parsed.
+ * Each cache file holds the flat AST of one source and is named after the hash of the source bytes.
+ *
+ * A file is a header followed by the node and list arrays exactly as they are in memory, so loading one is mapping it,
+ * checking every index in the arrays and copying them out. Everything in them refers to nodes, lists and names by
+ * index. The names are stored as null-terminated strings and interned again on load, which is the only fixup needed.
+ */
+
+// The PASTEL_CACHE_DIR environment variable, or .pastel_cache in the working directory if it isn't set.
+const char *ast_cache_dir();
+
+// 64 bit FNV-1a of the source bytes.
+uint64_t ast_cache_hash(const char *data, size_t size);
+
+// Returns NULL if dir has no valid cache file for the source with this hash and size.
+flat_ast_t *ast_cache_load(const char *dir, uint64_t hash, size_t source_size);
+
+// Writes the cache file for the source with this hash and size, creating dir if needed. Returns 1 on error.
+int ast_cache_store(const char *dir, uint64_t hash, size_t source_size, flat_ast_t *ast);
+
+#endif //PASTEL_AST_CACHE_H
@@ -0,0 +1,123 @@
+//
+// Created by sarah on 3/21/24.
+//
+
+#ifndef PASTEL_FLAT_AST_H
+#define PASTEL_FLAT_AST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../../src/util/ptr_list.h"
+#include "../../src/util/arena.h"
+#include "ast.h"
+
+/*
+ * Compact form of the AST: all nodes of a module live in one array and refer to each other by 32 bit index. Child
+ * lists are packed into a second array as a count followed by the child indices, and every distinct name is stored
+ * once in a name table. Nodes are appended children first, so a walk over the node array visits them in post order.
+ */
+
+typedef uint32_t flat_index_t;
+
+#define FLAT_NONE ((flat_index_t) 0xFFFFFFFF)
+
+typedef enum flat_kind_t {
+    FLAT_BOOL,
+    FLAT_INT,
+    FLAT_FLOAT,
+    FLAT_VARIABLE,
+    FLAT_UNARY,
+    FLAT_BINARY,
+    FLAT_CALL,
+    FLAT_IF,
+    FLAT_CAST,
+
+    FLAT_RETURN,
+    FLAT_EXPR,
+    FLAT_FUNCTION,
+    FLAT_EXTERN,
+    FLAT_ASSIGNMENT,
+    FLAT_WHILE,
+    FLAT_DECLARATION,
+
+    FLAT_PROTOTYPE,
+    FLAT_TYPED_VALUE,
+} flat_kind_t;
+
+/*
+ * Operand meaning per kind ("name" is an index into names, "list" into lists, "node" into nodes):
+ *
+ *   BOOL             a = value
+ *   INT              a, b = low and high word of the int64_t, c = suffix type name or FLAT_NONE
+ *   FLOAT            a, b = low and high word of the double, c = suffix type name or FLAT_NONE
+ *   VARIABLE         a = name
+ *   UNARY            a = operator_t, b = operand node
+ *   BINARY           a = operator_t, b = lhs node, c = rhs node
+ *   CALL             a = callee name, b = argument list
+ *   IF               a = condition node, b = then list, c = else list or FLAT_NONE
+ *   CAST             a = value node, b = type name
+ *   RETURN, EXPR     a = expression node
+ *   FUNCTION         a = prototype node, b = variable list, c = body list
+ *   EXTERN           a = prototype node
+ *   ASSIGNMENT       a = name, b = value node
+ *   WHILE            a = condition node, b = body list
+ *   DECLARATION      a = typed value node, b = value node or FLAT_NONE, c = index in the function's variables
+ *   PROTOTYPE        a = name, b = return type name or FLAT_NONE, c = argument list, flags = is_extern
+ *   TYPED_VALUE      a = name, b = type name, flags = variable_flags_t
+ */
+typedef struct flat_node_t {
+    uint8_t kind; // flat_kind_t
+    uint8_t flags;
+    uint16_t reserved;
+    flat_index_t a;
+    flat_index_t b;
+    flat_index_t c;
+} flat_node_t;
+
+typedef struct flat_ast_t {
+    flat_node_t *nodes;
+    flat_index_t node_count;
+    flat_index_t node_capacity;
+
+    flat_index_t *lists;
+    flat_index_t list_size;
+    flat_index_t list_capacity;
+
+    char **names; // Interned
+    flat_index_t name_count;
+    flat_index_t name_capacity;
+    flat_index_t *name_slots; // Open addressing table from name to index, only alive while flattening
+    size_t name_slot_mask;
+    struct flat_scratch_t *scratch; // Stacks for walking operator chains, only alive while flattening or expanding
+
+    flat_index_t root; // List of the top level statements
+} flat_ast_t;
+
+flat_ast_t *flat_ast_new();
+
+// Room for this many nodes, list entries and names before any array has to grow.
+flat_ast_t *flat_ast_new_capacity(flat_index_t nodes, flat_index_t lists, flat_index_t names);
+void flat_ast_free(flat_ast_t *ast);
+
+// Flattens a List<stmt_t *> of top level statements.
+flat_ast_t *flat_ast_from_stmts(ptr_list_t *stmts);
+
+// Rebuilds the pointer AST in arena, for code that hasn't been moved to the flat form yet.
+ptr_list_t *flat_ast_expand(flat_ast_t *ast, arena_t *arena);
+
+// Prints the same tree as print_stmt does for every top level statement.
+void flat_ast_print(flat_ast_t *ast);
+
+// Whether both hold the same tree.
+int flat_ast_equal(flat_ast_t *a, flat_ast_t *b);
+
+// Bytes used by the arrays, not counting unused capacity.
+size_t flat_ast_memory_size(flat_ast_t *ast);
+
+#define flat_ast_node(ast, i) (&(ast)->nodes[i])
+#define flat_ast_name(ast, i) ((ast)->names[i])
+#define flat_ast_list_size(ast, list) ((ast)->lists[list])
+#define flat_ast_list_at(ast, list, i) ((ast)->lists[(list) + 1 + (i)])
+
+#endif //PASTEL_FLAT_AST_H
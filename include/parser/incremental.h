@@ -0,0 +1,54 @@
+//
+// Created by sarah on 3/24/24.
+//
+
+#ifndef PASTEL_INCREMENTAL_H
+#define PASTEL_INCREMENTAL_H
+
+#include <stddef.h>
+
+#include "../../src/util/ptr_list.h"
+#include "../lexer/token.h"
+#include "ast.h"
+
+/*
+ * Front end for a source that is edited and compiled over and over. After an edit, only the top level statements
+ * around the edited text are lexed and parsed again. Statements that come out the same as before keep their old
+ * subtree, and the statements that really changed are reported, so downstream code can leave the others alone.
+ *
+ * A compiler that keeps its module between updates compiles the changed statements again, replacing the functions of
+ * the same name, and deletes the functions named in removed. A changed prototype also affects the functions calling
+ * it, which the parser doesn't track, so those have to be found and compiled again by the compiler itself.
+ * bench/incremental_bench.c checks the statements against full parses.
+ */
+typedef struct incremental_parser_t incremental_parser_t;
+
+// The old_length bytes at offset were replaced by new_length bytes.
+typedef struct source_edit_t {
+    size_t offset;
+    size_t old_length;
+    size_t new_length;
+} source_edit_t;
+
+incremental_parser_t *incremental_parser_new();
+void incremental_parser_free(incremental_parser_t *parser);
+
+/*
+ * Lexes and parses input from scratch. input is used like by lexer_new() and has to stay alive until the next call.
+ * Returns 1 on syntax errors, in which case the statements from before are kept, and the next update starts over.
+ */
+int incremental_parser_parse(incremental_parser_t *parser, const char *input, size_t size);
+
+// Parses input, the previous input with edit applied. Same rules as incremental_parser_parse().
+int incremental_parser_update(incremental_parser_t *parser, const char *input, size_t size, source_edit_t edit);
+
+// List<stmt_t *> of all top level statements.
+ptr_list_t *incremental_parser_stmts(incremental_parser_t *parser);
+
+// List<stmt_t *> of the top level statements that are new or differ since the previous parse.
+ptr_list_t *incremental_parser_changed(incremental_parser_t *parser);
+
+// List<char *> of the names of top level statements that are gone since the previous parse.
+ptr_list_t *incremental_parser_removed(incremental_parser_t *parser);
+
+#endif //PASTEL_INCREMENTAL_H
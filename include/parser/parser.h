@@ -6,13 +6,51 @@
 #define PASTEL_PARSER_H
 
 #include "../../src/util/ptr_list.h"
+#include "../../src/util/arena.h"
+#include "../lexer/lexer.h"
+#include "ast.h"
 
 typedef struct parser_t parser_t;
 
-parser_t *parser_new(ptr_list_t *tokens);
+// The whole AST, including its lists, is allocated from arena and freed together with it. It outlives the parser.
+parser_t *parser_new(token_stream_t *tokens, arena_t *arena);
+
+// Pulls tokens from the lexer as they're needed instead of parsing an already lexed stream.
+parser_t *parser_new_streaming(lexer_t *lexer, arena_t *arena);
 void parser_free(parser_t *parser);
 
 // Returns List<stmt_t *> of the top level statements
 ptr_list_t *parser_parse_all(parser_t *parser);
 
+/*
+ * Parses the top level statements on the pool's threads and returns the same list parser_parse_all() would, with
+ * everything allocated from arena. Input with syntax errors is parsed again sequentially to report them.
+ */
+ptr_list_t *parser_parse_parallel(token_stream_t *tokens, arena_t *arena, thread_pool_t *pool);
+
+// Index of the token the parser is at.
+size_t parser_position(parser_t *parser);
+
+// Moves to token pos, which has to be the start of a top level statement or the end of statements in front of one.
+void parser_seek(parser_t *parser, size_t pos);
+
+// Quiet parsers don't print diagnostics, for callers that handle failures themselves.
+void parser_set_quiet(parser_t *parser, int is_quiet);
+
+/*
+ * Lazy parsers only parse the prototypes of functions and skip their bodies, which are left NULL. The body of such a
+ * function is parsed by parser_parse_body(), so the parser and its tokens have to be kept around until then. Not
+ * supported for streaming parsers.
+ */
+void parser_set_lazy(parser_t *parser, int is_lazy);
+
+// Parses a body skipped by a lazy parser into function. Returns 1 on error, other bodies can still be parsed after it.
+int parser_parse_body(parser_t *parser, function_stmt_t *function);
+
+// Returns 1 once all top level statements have been parsed.
+int parser_at_end(parser_t *parser);
+
+// Parses a single top level statement, so it can be handed on before the rest of the input is even lexed.
+stmt_t *parser_parse_next(parser_t *parser);
+
 #endif //PASTEL_PARSER_H
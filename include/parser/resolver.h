@@ -0,0 +1,21 @@
+//
+// Created by sarah on 3/25/24.
+//
+
+#ifndef PASTEL_RESOLVER_H
+#define PASTEL_RESOLVER_H
+
+#include "ast.h"
+
+/*
+ * Binds every variable use and assignment in the body of a function to a slot, so codegen finds the variable by
+ * index instead of by name. Slots 0 to n - 1 are the n parameters, followed by the function's variables in the
+ * order they are declared in.
+ *
+ * The body of a function, a while or a branch of an if is a scope of its own. A variable is visible from its
+ * declaration to the end of its scope, and a declaration may shadow a variable of an outer scope, but not one of its
+ * own. Returns 1 on error.
+ */
+int resolve_function(function_stmt_t *function);
+
+#endif //PASTEL_RESOLVER_H
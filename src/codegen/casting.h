@@ -7,9 +7,15 @@
 
 #include "utils.h"
 
-typed_value_t *cast_to_int(compiler_t *compiler, typed_value_t *value, type_t *dest_type);
-typed_value_t *cast_to_float(compiler_t *compiler, typed_value_t *value, type_t *dest_type);
-typed_value_t *cast_value(compiler_t *compiler, typed_value_t *value, type_t *dest_type);
-void do_type_coercion(compiler_t *compiler, typed_value_t **lhs_out, typed_value_t **rhs_out);
+// A value that can't be cast has a NULL type, can_cast tells which can.
+typed_value_t cast_to_int(compiler_t *compiler, typed_value_t value, type_t *dest_type);
+typed_value_t cast_to_float(compiler_t *compiler, typed_value_t value, type_t *dest_type);
+typed_value_t cast_value(compiler_t *compiler, typed_value_t value, type_t *dest_type);
+
+// Whether cast_value can convert a value of type from to type to.
+int can_cast(type_t *from, type_t *to);
+
+// Type both operands of a binary expression are converted to, NULL if they can't be.
+type_t *coerce_types(type_t *lhs, type_t *rhs);
 
 #endif //PASTEL_CASTING_H
@@ -0,0 +1,464 @@
+//
+// Created by sarah on 3/25/24.
+//
+
+#include "checker.h"
+
+#include "utils.h"
+#include "casting.h"
+#include "expr/binop.h"
+#include "stmt/function.h"
+#include "parser/resolver.h"
+
+#include <stdio.h>
+#include <stdint.h>
+
+typedef struct checked_slot_t {
+    char *name;
+    type_t *type;
+    variable_flags_t flags;
+} checked_slot_t;
+
+typedef struct checker_t {
+    compiler_t *compiler;
+    function_t *function;
+
+    checked_slot_t *slots; // Indexed by the slots the resolver assigned
+    size_t slot_count;
+
+    chain_walker_t walker;
+} checker_t;
+
+static type_t *check_expr(checker_t *checker, expr_t *expr, int is_stmt);
+static int check_stmt_list(checker_t *checker, ptr_list_t *stmts);
+
+/*
+ * Whether the literal's value fits the integer type. The lexer only lets through literals that fit Int64, or UInt64
+ * with that suffix, so only narrower types need a look.
+ */
+static int int_fits_type(int64_t value, type_t *type) {
+    if (type->size >= 8) return 1;
+
+    int bits = type->size * 8;
+    if ((type->flags & TYPE_SIGNED) != 0) {
+        return value >= -((int64_t) 1 << (bits - 1)) && value < ((int64_t) 1 << (bits - 1));
+    }
+
+    return value >= 0 && value < ((int64_t) 1 << bits);
+}
+
+// Literals without a suffix are Int32, or Int64 if they don't fit. The lexer rejects those that fit neither.
+static type_t *check_int(checker_t *checker, int_expr_t *int_expr) {
+    compiler_t *compiler = checker->compiler;
+    if (int_expr->type == NULL) {
+        if (int_expr->data >= INT32_MIN && int_expr->data <= INT32_MAX) return compiler->int32_type;
+        return compiler->int64_type;
+    }
+
+    type_t *type = find_type(compiler, int_expr->type);
+    if (type == NULL || (type->flags & TYPE_INT) == 0) {
+        fprintf(stderr, "Invalid type %s for integer literal!\n", int_expr->type);
+        return NULL;
+    }
+
+    if (!int_fits_type(int_expr->data, type)) {
+        fprintf(stderr, "Integer literal %lld doesn't fit into %s!\n", (long long) int_expr->data, int_expr->type);
+        return NULL;
+    }
+
+    return type;
+}
+
+static type_t *check_float(checker_t *checker, float_expr_t *float_expr) {
+    if (float_expr->type == NULL) return checker->compiler->float64_type;
+
+    type_t *type = find_type(checker->compiler, float_expr->type);
+    if (type == NULL || (type->flags & TYPE_FLOAT) == 0) {
+        fprintf(stderr, "Invalid type %s for float literal!\n", float_expr->type);
+        return NULL;
+    }
+
+    return type;
+}
+
+static type_t *check_variable(checker_t *checker, variable_expr_t *variable_expr) {
+    if (variable_expr->slot >= checker->slot_count) {
+        fprintf(stderr, "Unknown variable %s!\n", variable_expr->name);
+        return NULL;
+    }
+
+    return checker->slots[variable_expr->slot].type;
+}
+
+static type_t *check_call(checker_t *checker, call_expr_t *call_expr) {
+    call_expr_data_t *data = call_expr->data;
+
+    function_t *callee = find_function_by_name(checker->compiler, data->callee_name);
+    if (callee == NULL) {
+        fprintf(stderr, "Unknown function %s!\n", data->callee_name);
+        return NULL;
+    }
+
+    request_function(checker->compiler, callee);
+
+    ptr_list_t *params = callee->prototype->arguments;
+    if (ptr_list_size(params) != ptr_list_size(data->arguments)) {
+        fprintf(
+                stderr,
+                "Expected %lu arguments but got %lu in call to %s!\n",
+                ptr_list_size(params),
+                ptr_list_size(data->arguments),
+                data->callee_name
+        );
+        return NULL;
+    }
+
+    size_t i;
+    for (i = 0; i < ptr_list_size(data->arguments); i++) {
+        type_t *type = check_expr(checker, (expr_t *) ptr_list_at_unchecked(data->arguments, i), 0);
+        if (type == NULL) return NULL;
+
+        annotated_typed_arg_t *param = (annotated_typed_arg_t *) ptr_list_at_unchecked(params, i);
+        if (type != param->type) {
+            fprintf(
+                    stderr,
+                    "Expected type %s for arg %lu in call to %s but got value of %s!\n",
+                    param->type->name,
+                    i,
+                    callee->prototype->name,
+                    type->name
+            );
+            return NULL;
+        }
+    }
+
+    data->callee = callee;
+    return callee->prototype->return_type;
+}
+
+static int can_if_be_expr(if_expr_t *expr) {
+    ptr_list_t *then_stmts = expr->data->then_stmts;
+    ptr_list_t *else_stmts = expr->data->else_stmts;
+
+    if (then_stmts == NULL) return 0;
+    if (else_stmts == NULL) return 0;
+
+    // Branch is empty
+    if (ptr_list_size(then_stmts) == 0) return 0;
+    if (ptr_list_size(else_stmts) == 0) return 0;
+
+    // Last statement in a branch has to be an expression statement for us to get a value from the branch.
+
+    stmt_t *last_then_stmt = ptr_list_at(then_stmts, ptr_list_size(then_stmts) - 1);
+    if (last_then_stmt->stmt_type != STMT_EXPR) return 0;
+
+    stmt_t *last_else_stmt = ptr_list_at(else_stmts, ptr_list_size(else_stmts) - 1);
+    if (last_else_stmt->stmt_type != STMT_EXPR) return 0;
+
+    return 1;
+}
+
+// Type of the value of a branch, its last statement is an expression statement.
+static type_t *branch_type(ptr_list_t *stmts) {
+    expr_stmt_t *last_stmt = (expr_stmt_t *) ptr_list_at(stmts, ptr_list_size(stmts) - 1);
+    return last_stmt->expr->checked_type;
+}
+
+// An if used as a statement is Void, one used as an expression has the type of its branches.
+static type_t *check_if(checker_t *checker, if_expr_t *if_expr, int is_stmt) {
+    if_expr_data_t *data = if_expr->data;
+
+    // Do sanity check up front
+    if (!is_stmt && !can_if_be_expr(if_expr)) {
+        fprintf(stderr, "An if statement was used as an expression, but it doesn't fit the right form!\n");
+        return NULL;
+    }
+
+    type_t *condition_type = check_expr(checker, data->condition, 0);
+    if (condition_type == NULL) return NULL;
+    if (condition_type != checker->compiler->bool_type) {
+        fprintf(stderr, "If conditions must be boolean!\n");
+        return NULL;
+    }
+
+    if (check_stmt_list(checker, data->then_stmts)) return NULL;
+    if (data->else_stmts != NULL && check_stmt_list(checker, data->else_stmts)) return NULL;
+
+    if (is_stmt) return checker->compiler->void_type;
+
+    type_t *then_type = branch_type(data->then_stmts);
+    if (then_type != branch_type(data->else_stmts)) {
+        fprintf(stderr, "Types must match for both branches and blocks can't be empty when using if as an expression!\n");
+        return NULL;
+    }
+
+    return then_type;
+}
+
+static type_t *check_operand(checker_t *checker, expr_t *expr, int is_stmt) {
+    switch (expr->expr_type) {
+        case EXPR_INT:
+            return check_int(checker, (int_expr_t *) expr);
+        case EXPR_FLOAT:
+            return check_float(checker, (float_expr_t *) expr);
+        case EXPR_BOOL:
+            return checker->compiler->bool_type;
+        case EXPR_VARIABLE:
+            return check_variable(checker, (variable_expr_t *) expr);
+        case EXPR_CALL:
+            return check_call(checker, (call_expr_t *) expr);
+        case EXPR_IF:
+            return check_if(checker, (if_expr_t *) expr, is_stmt);
+        default:
+            return NULL;
+    }
+}
+
+static type_t *check_unary(checker_t *checker, unary_expr_t *unary_expr) {
+    type_t *type = unary_expr->data->value->checked_type;
+
+    if (unary_expr->data->op != OPERATOR_NOT) {
+        fprintf(stderr, "Unknown unary operator '%s'!\n", operator_spelling(unary_expr->data->op));
+        return NULL;
+    }
+
+    if (type != checker->compiler->bool_type) {
+        fprintf(stderr, "Negation unary operator '!' only works on boolean values, not %s.\n", type->name);
+        return NULL;
+    }
+
+    return type;
+}
+
+static type_t *check_binary(checker_t *checker, binary_expr_t *binary_expr) {
+    binary_expr_data_t *data = binary_expr->data;
+    type_t *lhs_type = data->lhs->checked_type;
+    type_t *rhs_type = data->rhs->checked_type;
+
+    type_t *operand_type = coerce_types(lhs_type, rhs_type);
+    if (operand_type == NULL) {
+        fprintf(stderr, "Types in binary don't match! (%s and %s)\n", lhs_type->name, rhs_type->name);
+        return NULL;
+    }
+
+    type_t *type = binary_result_type(checker->compiler, data->op, operand_type);
+    if (type == NULL) {
+        fprintf(stderr, "Unknown binary operator '%s' for type %s!\n", operator_spelling(data->op), operand_type->name);
+        return NULL;
+    }
+
+    data->operand_type = operand_type;
+    return type;
+}
+
+static type_t *check_cast(checker_t *checker, cast_expr_t *cast_expr) {
+    type_t *from = cast_expr->data->value->checked_type;
+
+    type_t *to = find_type(checker->compiler, cast_expr->data->type);
+    if (to == NULL) {
+        fprintf(stderr, "Unknown type %s!\n", cast_expr->data->type);
+        return NULL;
+    }
+
+    if (!can_cast(from, to)) {
+        fprintf(stderr, "Can't cast from %s to %s!\n", from->name, to->name);
+        return NULL;
+    }
+
+    return to;
+}
+
+// The operands of an operator are checked before it, so their checked_type is set.
+static type_t *check_operator(checker_t *checker, expr_t *expr) {
+    switch (expr->expr_type) {
+        case EXPR_UNARY:
+            return check_unary(checker, (unary_expr_t *) expr);
+        case EXPR_BINARY:
+            return check_binary(checker, (binary_expr_t *) expr);
+        case EXPR_CAST:
+            return check_cast(checker, (cast_expr_t *) expr);
+        default:
+            return NULL;
+    }
+}
+
+static int visit_operand(void *checker, expr_t *expr) {
+    expr->checked_type = check_operand((checker_t *) checker, expr, 0);
+    return expr->checked_type == NULL;
+}
+
+static int visit_operator(void *checker, expr_t *expr) {
+    expr->checked_type = check_operator((checker_t *) checker, expr);
+    return expr->checked_type == NULL;
+}
+
+static type_t *check_expr(checker_t *checker, expr_t *expr, int is_stmt) {
+    if (!is_operator_expr(expr)) {
+        expr->checked_type = check_operand(checker, expr, is_stmt);
+        return expr->checked_type;
+    }
+
+    if (walk_operator_chain(&checker->walker, expr, visit_operand, visit_operator, checker)) return NULL;
+    return expr->checked_type;
+}
+
+// Assignments and initialized declarations. Only integers are converted implicitly.
+static int check_store(checker_t *checker, size_t slot, expr_t *value_expr) {
+    type_t *type = check_expr(checker, value_expr, 0);
+    if (type == NULL) return 1;
+
+    if (slot >= checker->slot_count) {
+        fprintf(stderr, "Unresolved variable in assignment!\n");
+        return 1;
+    }
+
+    checked_slot_t *variable = &checker->slots[slot];
+    if (!(variable->flags & VAR_IS_MUTABLE) && (variable->flags & VAR_IS_INITIALIZED)) {
+        fprintf(stderr, "Can't assign to immutable variable %s!\n", variable->name);
+        return 1;
+    }
+
+    if (type != variable->type && ((type->flags & TYPE_INT) == 0 || (variable->type->flags & TYPE_INT) == 0)) {
+        fprintf(stderr, "Can't do implicit type conversion between %s and %s!\n", type->name, variable->type->name);
+        return 1;
+    }
+
+    variable->flags |= VAR_IS_INITIALIZED;
+    return 0;
+}
+
+static int check_while_condition(checker_t *checker, expr_t *condition) {
+    type_t *type = check_expr(checker, condition, 0);
+    if (type == NULL) return 1;
+
+    if (type != checker->compiler->bool_type) {
+        fprintf(stderr, "Expected boolean type for while condition, but got %s!\n", type->name);
+        return 1;
+    }
+
+    return 0;
+}
+
+static int check_return(checker_t *checker, expr_t *value_expr) {
+    type_t *type = check_expr(checker, value_expr, 0);
+    if (type == NULL) return 1;
+
+    annotated_prototype_t *prototype = checker->function->prototype;
+    if (type != prototype->return_type) {
+        fprintf(
+                stderr,
+                "Expected return value of %s in function %s but got %s!\n",
+                prototype->return_type->name,
+                prototype->name,
+                type->name
+        );
+        return 1;
+    }
+
+    return 0;
+}
+
+static int check_stmt(checker_t *checker, stmt_t *stmt) {
+    assignment_stmt_data_t *assignment_data;
+    declaration_stmt_data_t *declaration_data;
+    while_stmt_data_t *while_data;
+
+    switch (stmt->stmt_type) {
+        case STMT_RETURN:
+            return check_return(checker, ((return_stmt_t *) stmt)->value);
+        case STMT_EXPR:
+            return check_expr(checker, ((expr_stmt_t *) stmt)->expr, 1) == NULL;
+        case STMT_ASSIGNMENT:
+            assignment_data = ((assignment_stmt_t *) stmt)->data;
+            return check_store(checker, assignment_data->slot, assignment_data->value);
+        case STMT_DECLARATION:
+            declaration_data = ((declaration_stmt_t *) stmt)->data;
+            return declaration_data->value != NULL && check_store(checker, declaration_data->slot, declaration_data->value);
+        case STMT_WHILE:
+            while_data = ((while_stmt_t *) stmt)->data;
+            if (check_while_condition(checker, while_data->condition)) return 1;
+            return check_stmt_list(checker, while_data->body);
+        case STMT_FUNCTION:
+            printf("Functions are only allowed as top level statements!\n");
+            return 1;
+        case STMT_EXTERN:
+            printf("Extern declarations are only allowed as top level statements!\n");
+            return 1;
+    }
+
+    return 1;
+}
+
+static int check_stmt_list(checker_t *checker, ptr_list_t *stmts) {
+    size_t i;
+    for (i = 0; i < ptr_list_size(stmts); i++) {
+        if (check_stmt(checker, (stmt_t *) ptr_list_at_unchecked(stmts, i))) return 1;
+    }
+
+    return 0;
+}
+
+// Parameters are initialized on entry, so assigning to one is an error like for any other immutable variable.
+static int init_slots(checker_t *checker, function_stmt_t *function_stmt) {
+    ptr_list_t *params = checker->function->prototype->arguments;
+    ptr_list_t *variables = function_stmt->data->variables;
+
+    checker->slot_count = ptr_list_size(params) + ptr_list_size(variables);
+    checker->slots = (checked_slot_t *) malloc(sizeof(checked_slot_t) * (checker->slot_count + 1));
+
+    size_t i;
+    for (i = 0; i < ptr_list_size(params); i++) {
+        annotated_typed_arg_t *param = (annotated_typed_arg_t *) ptr_list_at_unchecked(params, i);
+        checker->slots[i].name = param->name;
+        checker->slots[i].type = param->type;
+        checker->slots[i].flags = VAR_IS_PARAM | VAR_IS_INITIALIZED;
+    }
+
+    checked_slot_t *slot = checker->slots + ptr_list_size(params);
+    for (i = 0; i < ptr_list_size(variables); i++, slot++) {
+        typed_ast_value_t *variable = (typed_ast_value_t *) ptr_list_at_unchecked(variables, i);
+
+        slot->name = variable->name;
+        slot->type = find_type(checker->compiler, variable->type);
+        slot->flags = variable->flags;
+
+        if (slot->type == NULL) {
+            fprintf(stderr, "Unknown type %s\n", variable->type);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int check_function(compiler_t *compiler, function_t *function_obj, function_stmt_t *function_stmt) {
+    if (resolve_function(function_stmt)) return 1;
+
+    checker_t checker;
+    checker.compiler = compiler;
+    checker.function = function_obj;
+    chain_walker_init(&checker.walker);
+
+    int failed = init_slots(&checker, function_stmt);
+    if (!failed) {
+        failed = check_stmt_list(&checker, function_stmt->data->body);
+    }
+
+    if (!failed && function_obj->prototype->return_type != compiler->void_type) {
+        int has_ret = 0;
+        size_t i;
+        for (i = 0; i < ptr_list_size(function_stmt->data->body) && !has_ret; i++) {
+            has_ret = ((stmt_t *) ptr_list_at_unchecked(function_stmt->data->body, i))->stmt_type == STMT_RETURN;
+        }
+
+        if (!has_ret) {
+            fprintf(stderr, "Missing return in non-void function %s!\n", function_obj->prototype->name);
+            failed = 1;
+        }
+    }
+
+    free(checker.slots);
+    chain_walker_free(&checker.walker);
+
+    return failed;
+}
@@ -0,0 +1,21 @@
+//
+// Created by sarah on 3/25/24.
+//
+
+#ifndef PASTEL_CHECKER_H
+#define PASTEL_CHECKER_H
+
+#include "types.h"
+
+/*
+ * Semantic analysis of a function, run after its prototype is declared and before its body is lowered. Resolves the
+ * body's variables, see resolver.h, then annotates the AST in place: every expression gets its checked_type, binary
+ * expressions the operand_type both sides are converted to and calls their callee. Lowering only reads these, so
+ * every error in a body is reported here and no LLVM code is built for a body that doesn't check.
+ *
+ * The annotations point into the compiler's type and function tables, so they are only valid for that compiler.
+ * Returns 1 on error.
+ */
+int check_function(compiler_t *compiler, function_t *function_obj, function_stmt_t *function_stmt);
+
+#endif //PASTEL_CHECKER_H
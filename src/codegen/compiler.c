@@ -5,6 +5,9 @@
 #include "utils.h"
 #include "parser/ast.h"
 #include "stmt/stmt.h"
+#include "stmt/function.h"
+#include "checker.h"
+#include "optimizer.h"
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -13,41 +16,37 @@
 #include <llvm-c/Core.h>
 #include <llvm-c/Transforms/Scalar.h>
 #include <llvm-c/Transforms/InstCombine.h>
-#include <llvm-c/Transforms/Utils.h>
 
 static void init_types(compiler_t *compiler) {
-    compiler->void_type = create_type(L"Void", LLVMVoidTypeInContext(compiler->context), TYPE_ANY, 0);
-    compiler->bool_type = create_type(L"Bool", LLVMInt1TypeInContext(compiler->context), TYPE_ANY, 1);
-
-    compiler->int8_type = create_type(L"Int8", LLVMInt8TypeInContext(compiler->context), TYPE_INT | TYPE_SIGNED, 1);
-    compiler->int16_type = create_type(L"Int16", LLVMInt16TypeInContext(compiler->context), TYPE_INT | TYPE_SIGNED, 2);
-    compiler->int32_type = create_type(L"Int32", LLVMInt32TypeInContext(compiler->context), TYPE_INT | TYPE_SIGNED, 4);
-    compiler->int64_type = create_type(L"Int64", LLVMInt64TypeInContext(compiler->context), TYPE_INT | TYPE_SIGNED, 8);
-
-    compiler->uint8_type = create_type(L"UInt8", LLVMInt8TypeInContext(compiler->context), TYPE_INT | TYPE_UNSIGNED, 1);
-    compiler->uint16_type = create_type(L"UInt16", LLVMInt16TypeInContext(compiler->context), TYPE_INT | TYPE_UNSIGNED, 2);
-    compiler->uint32_type = create_type(L"UInt32", LLVMInt32TypeInContext(compiler->context), TYPE_INT | TYPE_UNSIGNED, 4);
-    compiler->uint64_type = create_type(L"UInt64", LLVMInt64TypeInContext(compiler->context), TYPE_INT | TYPE_UNSIGNED, 8);
-
-    compiler->float32_type = create_type(L"Float32", LLVMFloatTypeInContext(compiler->context), TYPE_FLOAT, 4);
-    compiler->float64_type = create_type(L"Float64", LLVMDoubleTypeInContext(compiler->context), TYPE_FLOAT, 4);
-
-    compiler->types = ptr_list_new();
-    ptr_list_push(compiler->types, compiler->void_type);
-    ptr_list_push(compiler->types, compiler->bool_type);
-
-    ptr_list_push(compiler->types, compiler->int8_type);
-    ptr_list_push(compiler->types, compiler->int16_type);
-    ptr_list_push(compiler->types, compiler->int32_type);
-    ptr_list_push(compiler->types, compiler->int64_type);
-
-    ptr_list_push(compiler->types, compiler->uint8_type);
-    ptr_list_push(compiler->types, compiler->uint16_type);
-    ptr_list_push(compiler->types, compiler->uint32_type);
-    ptr_list_push(compiler->types, compiler->uint64_type);
-
-    ptr_list_push(compiler->types, compiler->float32_type);
-    ptr_list_push(compiler->types, compiler->float64_type);
+    compiler->void_type = create_type(intern_string("Void"), LLVMVoidTypeInContext(compiler->context), TYPE_ANY, 0);
+    compiler->bool_type = create_type(intern_string("Bool"), LLVMInt1TypeInContext(compiler->context), TYPE_ANY, 1);
+
+    compiler->int8_type = create_type(intern_string("Int8"), LLVMInt8TypeInContext(compiler->context), TYPE_INT | TYPE_SIGNED, 1);
+    compiler->int16_type = create_type(intern_string("Int16"), LLVMInt16TypeInContext(compiler->context), TYPE_INT | TYPE_SIGNED, 2);
+    compiler->int32_type = create_type(intern_string("Int32"), LLVMInt32TypeInContext(compiler->context), TYPE_INT | TYPE_SIGNED, 4);
+    compiler->int64_type = create_type(intern_string("Int64"), LLVMInt64TypeInContext(compiler->context), TYPE_INT | TYPE_SIGNED, 8);
+
+    compiler->uint8_type = create_type(intern_string("UInt8"), LLVMInt8TypeInContext(compiler->context), TYPE_INT | TYPE_UNSIGNED, 1);
+    compiler->uint16_type = create_type(intern_string("UInt16"), LLVMInt16TypeInContext(compiler->context), TYPE_INT | TYPE_UNSIGNED, 2);
+    compiler->uint32_type = create_type(intern_string("UInt32"), LLVMInt32TypeInContext(compiler->context), TYPE_INT | TYPE_UNSIGNED, 4);
+    compiler->uint64_type = create_type(intern_string("UInt64"), LLVMInt64TypeInContext(compiler->context), TYPE_INT | TYPE_UNSIGNED, 8);
+
+    compiler->float32_type = create_type(intern_string("Float32"), LLVMFloatTypeInContext(compiler->context), TYPE_FLOAT, 4);
+    compiler->float64_type = create_type(intern_string("Float64"), LLVMDoubleTypeInContext(compiler->context), TYPE_FLOAT, 4);
+
+    type_t *types[] = {
+            compiler->void_type, compiler->bool_type,
+            compiler->int8_type, compiler->int16_type, compiler->int32_type, compiler->int64_type,
+            compiler->uint8_type, compiler->uint16_type, compiler->uint32_type, compiler->uint64_type,
+            compiler->float32_type, compiler->float64_type,
+    };
+
+    compiler->types = ptr_map_new();
+
+    size_t i;
+    for (i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+        ptr_map_put(compiler->types, types[i]->name, types[i]);
+    }
 }
 
 compiler_t *compiler_new(ptr_list_t *stmts, compiler_opt_level_t opt_level) {
@@ -59,7 +58,17 @@ compiler_t *compiler_new(ptr_list_t *stmts, compiler_opt_level_t opt_level) {
 
     compiler->variables = ptr_list_new();
     compiler->functions = ptr_list_new();
+    compiler->functions_by_name = ptr_map_new();
     compiler->top_level_statements = stmts;
+    compiler->worklist = NULL;
+    chain_walker_init(&compiler->walker);
+    compiler->values = ptr_list_new();
+    compiler->arena = arena_new();
+    compiler->ssa_arena = arena_new();
+    compiler->block = NULL;
+    compiler->blocks_by_ref = ptr_map_new();
+    compiler->replaced_phis = ptr_map_new();
+    compiler->removed_phis = ptr_list_new();
 
     init_types(compiler);
 
@@ -73,7 +82,6 @@ compiler_t *compiler_new(ptr_list_t *stmts, compiler_opt_level_t opt_level) {
         LLVMAddReassociatePass(compiler->function_pm);
         LLVMAddGVNPass(compiler->function_pm);
         LLVMAddCFGSimplificationPass(compiler->function_pm);
-        LLVMAddPromoteMemoryToRegisterPass(compiler->function_pm);
         LLVMAddInstructionCombiningPass(compiler->function_pm);
         LLVMAddReassociatePass(compiler->function_pm);
     }
@@ -84,7 +92,7 @@ compiler_t *compiler_new(ptr_list_t *stmts, compiler_opt_level_t opt_level) {
 int compiler_compile(compiler_t *compiler) {
     size_t i;
     for (i = 0; i < ptr_list_size(compiler->top_level_statements); i++) {
-        stmt_t *stmt = (stmt_t *) ptr_list_at(compiler->top_level_statements, i);
+        stmt_t *stmt = (stmt_t *) ptr_list_at_unchecked(compiler->top_level_statements, i);
 
         if (compile_top_level_statement(compiler, stmt) == NULL) {
             return 1;
@@ -94,6 +102,110 @@ int compiler_compile(compiler_t *compiler) {
     return 0;
 }
 
+// Declares every function up front, so that the bodies can be compiled in any order.
+static int declare_top_level_statements(compiler_t *compiler) {
+    size_t i;
+    for (i = 0; i < ptr_list_size(compiler->top_level_statements); i++) {
+        stmt_t *stmt = (stmt_t *) ptr_list_at_unchecked(compiler->top_level_statements, i);
+
+        if (stmt->stmt_type == STMT_EXTERN) {
+            compile_prototype(compiler, ((extern_stmt_t *) stmt)->prototype);
+            continue;
+        }
+
+        if (stmt->stmt_type != STMT_FUNCTION) {
+            fprintf(stderr, "Only functions and extern declarations are allowed as top level statements!\n");
+            return 1;
+        }
+
+        function_stmt_t *function_stmt = (function_stmt_t *) stmt;
+        if (find_function_by_name(compiler, function_stmt->data->prototype->name) != NULL) {
+            fprintf(stderr, "Redefinition of function %s!\n", function_stmt->data->prototype->name);
+            return 1;
+        }
+
+        compile_prototype(compiler, function_stmt->data->prototype)->pending_definition = function_stmt;
+    }
+
+    return 0;
+}
+
+// Drops the declarations of functions that were never called.
+static void remove_unreached_functions(compiler_t *compiler) {
+    ptr_list_t *functions = ptr_list_new_capacity(ptr_list_size(compiler->functions));
+
+    size_t i;
+    for (i = 0; i < ptr_list_size(compiler->functions); i++) {
+        function_t *function = (function_t *) ptr_list_at_unchecked(compiler->functions, i);
+
+        if (function->pending_definition == NULL) {
+            ptr_list_push(functions, function);
+            continue;
+        }
+
+        // The map has no removal, the remaining functions are put back into it below
+        LLVMDeleteFunction(function->function);
+        free(function);
+    }
+
+    ptr_map_clear(compiler->functions_by_name);
+    for (i = 0; i < ptr_list_size(functions); i++) {
+        function_t *function = (function_t *) ptr_list_at_unchecked(functions, i);
+        ptr_map_put(compiler->functions_by_name, function->prototype->name, function);
+    }
+
+    ptr_list_free(compiler->functions);
+    compiler->functions = functions;
+}
+
+int compiler_compile_lazy(compiler_t *compiler, parser_t *parser) {
+    if (declare_top_level_statements(compiler)) return 1;
+
+    function_t *main_function = find_function_by_name(compiler, intern_string("main"));
+    if (main_function == NULL) {
+        fprintf(stderr, "Missing main function!\n");
+        return 1;
+    }
+
+    compiler->worklist = ptr_list_new();
+    request_function(compiler, main_function);
+
+    // Checking a body queues the functions it calls, so the list grows while it's being worked through
+    size_t i;
+    for (i = 0; i < ptr_list_size(compiler->worklist); i++) {
+        function_t *function = (function_t *) ptr_list_at_unchecked(compiler->worklist, i);
+        function_stmt_t *function_stmt = function->pending_definition;
+        function->pending_definition = NULL;
+
+        if (function_stmt->data->body == NULL && parser_parse_body(parser, function_stmt)) {
+            return 1;
+        }
+
+        if (check_function(compiler, function, function_stmt)) {
+            LLVMDeleteFunction(function->function);
+            return 1;
+        }
+
+        optimize_function(compiler, function_stmt);
+
+        if (compile_function_body(compiler, function, function_stmt) == NULL) {
+            return 1;
+        }
+    }
+
+    ptr_list_free(compiler->worklist);
+    compiler->worklist = NULL;
+
+    remove_unreached_functions(compiler);
+    return 0;
+}
+
+int compiler_compile_stmt(compiler_t *compiler, stmt_t *stmt) {
+    ptr_list_push(compiler->top_level_statements, stmt);
+
+    return compile_top_level_statement(compiler, stmt) == NULL;
+}
+
 void compiler_dump_all(compiler_t *compiler, int open_cfg) {
     LLVMDumpModule(compiler->module);
 
@@ -105,9 +217,9 @@ void compiler_dump_all(compiler_t *compiler, int open_cfg) {
 
     size_t i;
     for (i = 0; i < ptr_list_size(compiler->functions); i++) {
-        function_t *function = ptr_list_at(compiler->functions, i);
+        function_t *function = ptr_list_at_unchecked(compiler->functions, i);
         if (function->prototype->is_extern) {
-            fprintf(stderr, "Skipping extern function %ls for CFG visualization\n", function->prototype->name);
+            fprintf(stderr, "Skipping extern function %s for CFG visualization\n", function->prototype->name);
             continue;
         }
 
@@ -116,19 +228,19 @@ void compiler_dump_all(compiler_t *compiler, int open_cfg) {
 }
 
 int compiler_is_main_void(compiler_t *compiler) {
-    return find_function_by_name(compiler, L"main")->prototype->return_type == compiler->void_type;
+    return find_function_by_name(compiler, intern_string("main"))->prototype->return_type == compiler->void_type;
 }
 
 LLVMValueRef compiler_get_main(compiler_t *compiler) {
-    return compiler_get_function(compiler, L"main");
+    return compiler_get_function(compiler, "main");
 }
 
 LLVMModuleRef compiler_get_module(compiler_t *compiler) {
     return compiler->module;
 }
 
-LLVMValueRef compiler_get_function(compiler_t *compiler, wchar_t *name) {
-    function_t *function = find_function_by_name(compiler, name);
+LLVMValueRef compiler_get_function(compiler_t *compiler, const char *name) {
+    function_t *function = find_function_by_name(compiler, intern_string(name));
     if (function == NULL) return NULL;
 
     return function->function;
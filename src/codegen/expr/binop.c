@@ -4,173 +4,116 @@
 
 #include "binop.h"
 
-#include "expr.h"
 #include "../casting.h"
 
 #include <llvm-c/Core.h>
-#include <stdio.h>
 
-typed_value_t *compile_unary_expr(compiler_t *compiler, unary_expr_t *unary_expr) {
-    typed_value_t *value = compile_expr(compiler, unary_expr->data->value, 0);
-    if (value == NULL) return NULL;
-
-    typed_value_t *ret_value = malloc_s(typed_value_t);
-    if (!wcscmp(L"!", unary_expr->data->op)) {
-        if (value->type != compiler->bool_type) {
-            fprintf(stderr, "Negation unary operator '!' only works on boolean values, not %ls.\n", value->type->name);
-            return NULL;
-        }
-
-        ret_value->type = compiler->bool_type;
-        ret_value->value = LLVMBuildNot(compiler->builder, value->value, "not_tmp");
-        return ret_value;
-    }
-
-    free(ret_value);
-    fprintf(stderr, "Unknown unary operator '%ls'!\n", unary_expr->data->op);
-    return NULL;
-}
-
-static typed_value_t *create_arithmetic_int_binop_inst(LLVMBuilderRef builder, type_t *int_type, wchar_t *op, LLVMValueRef lhs, LLVMValueRef rhs) {
-    typed_value_t *value = malloc_s(typed_value_t);
-
-    if (!wcscmp(L"+", op)) {
-        value->type = int_type;
-        value->value = LLVMBuildAdd(builder, lhs, rhs, "add_tmp");
-        return value;
-    }
-
-    if (!wcscmp(L"-", op)) {
-        value->type = int_type;
-        value->value = LLVMBuildSub(builder, lhs, rhs, "sub_tmp");
-        return value;
-    }
-
-    if (!wcscmp(L"*", op)) {
-        value->type = int_type;
-        value->value = LLVMBuildMul(builder, lhs, rhs, "mul_tmp");
-        return value;
-    }
-
-    if (!wcscmp(L"/", op)) {
-        value->type = int_type;
-        value->value = LLVMBuildSDiv(builder, lhs, rhs, "mul_tmp");
-        return value;
-    }
-
-    free(value);
-    return NULL;
-}
-
-static typed_value_t *create_comp_int_binop_inst(compiler_t *compiler, type_t *int_type, wchar_t *op, LLVMValueRef lhs, LLVMValueRef rhs) {
-    typed_value_t *value = malloc_s(typed_value_t);
-
-    int is_signed = (int_type->flags & TYPE_SIGNED) != 0;
-
-    if (!wcscmp(L"==", op)) {
-        value->type = compiler->bool_type;
-        value->value = LLVMBuildICmp(compiler->builder, LLVMIntEQ, lhs, rhs, "eq_tmp");
-        return value;
-    }
-
-    if (!wcscmp(L"!=", op)) {
-        value->type = compiler->bool_type;
-        value->value = LLVMBuildICmp(compiler->builder, LLVMIntNE, lhs, rhs, "ne_tmp");
-        return value;
-    }
-
-    if (!wcscmp(L"<", op)) {
-        value->type = compiler->bool_type;
-        value->value = LLVMBuildICmp(compiler->builder, is_signed ? LLVMIntSLT : LLVMIntULT, lhs, rhs, "lt_tmp");
-        return value;
-    }
-
-    if (!wcscmp(L"<=", op)) {
-        value->type = compiler->bool_type;
-        value->value = LLVMBuildICmp(compiler->builder, is_signed ? LLVMIntSLE : LLVMIntULE, lhs, rhs, "le_tmp");
-        return value;
-    }
-
-    if (!wcscmp(L">", op)) {
-        value->type = compiler->bool_type;
-        value->value = LLVMBuildICmp(compiler->builder, is_signed ? LLVMIntSGT : LLVMIntUGT, lhs, rhs, "gt_tmp");
-        return value;
-    }
-
-    if (!wcscmp(L">=", op)) {
-        value->type = compiler->bool_type;
-        value->value = LLVMBuildICmp(compiler->builder, is_signed ? LLVMIntSGE : LLVMIntUGE, lhs, rhs, "ge_tmp");
-        return value;
-    }
-
-    free(value);
-    return NULL;
+typed_value_t compile_unary_expr(compiler_t *compiler, unary_expr_t *unary_expr, typed_value_t value) {
+    // '!' is the only unary operator the checker accepts
+    return make_typed_value(unary_expr->checked_type, LLVMBuildNot(compiler->builder, value.value, "not_tmp"));
 }
 
-static typed_value_t *create_int_binop_inst(compiler_t *compiler, type_t *int_type, wchar_t *op, LLVMValueRef lhs, LLVMValueRef rhs) {
-    typed_value_t *value = create_arithmetic_int_binop_inst(compiler->builder, int_type, op, lhs, rhs);
-    if (value != NULL) return value;
-
-    value = create_comp_int_binop_inst(compiler, int_type, op, lhs, rhs);
-    if (value != NULL) return value;
-
-    return NULL;
+typedef enum type_class_t {
+    TYPE_CLASS_NONE,
+    TYPE_CLASS_BOOL,
+    TYPE_CLASS_SIGNED_INT,
+    TYPE_CLASS_UNSIGNED_INT,
+    TYPE_CLASS_COUNT,
+} type_class_t;
+
+typedef enum binop_kind_t {
+    BINOP_NONE, // Operator isn't defined for the type class
+    BINOP_ARITHMETIC,
+    BINOP_COMPARISON,
+} binop_kind_t;
+
+typedef struct binop_inst_t {
+    binop_kind_t kind;
+    int opcode; // LLVMOpcode for arithmetic, LLVMIntPredicate for comparisons
+    const char *name;
+} binop_inst_t;
+
+#define ARITHMETIC(opcode, name) { BINOP_ARITHMETIC, opcode, name }
+#define COMPARISON(predicate, name) { BINOP_COMPARISON, predicate, name }
+
+// Instruction to build for every binary operator and type class. Anything not listed is BINOP_NONE.
+static const binop_inst_t binop_insts[OPERATOR_COUNT][TYPE_CLASS_COUNT] = {
+        [OPERATOR_ADD] = {
+                [TYPE_CLASS_SIGNED_INT] = ARITHMETIC(LLVMAdd, "add_tmp"),
+                [TYPE_CLASS_UNSIGNED_INT] = ARITHMETIC(LLVMAdd, "add_tmp"),
+        },
+        [OPERATOR_SUB] = {
+                [TYPE_CLASS_SIGNED_INT] = ARITHMETIC(LLVMSub, "sub_tmp"),
+                [TYPE_CLASS_UNSIGNED_INT] = ARITHMETIC(LLVMSub, "sub_tmp"),
+        },
+        [OPERATOR_MUL] = {
+                [TYPE_CLASS_SIGNED_INT] = ARITHMETIC(LLVMMul, "mul_tmp"),
+                [TYPE_CLASS_UNSIGNED_INT] = ARITHMETIC(LLVMMul, "mul_tmp"),
+        },
+        [OPERATOR_DIV] = {
+                [TYPE_CLASS_SIGNED_INT] = ARITHMETIC(LLVMSDiv, "div_tmp"),
+                [TYPE_CLASS_UNSIGNED_INT] = ARITHMETIC(LLVMUDiv, "div_tmp"),
+        },
+        [OPERATOR_EQ] = {
+                [TYPE_CLASS_BOOL] = COMPARISON(LLVMIntEQ, "eq_tmp"),
+                [TYPE_CLASS_SIGNED_INT] = COMPARISON(LLVMIntEQ, "eq_tmp"),
+                [TYPE_CLASS_UNSIGNED_INT] = COMPARISON(LLVMIntEQ, "eq_tmp"),
+        },
+        [OPERATOR_NE] = {
+                [TYPE_CLASS_BOOL] = COMPARISON(LLVMIntNE, "ne_tmp"),
+                [TYPE_CLASS_SIGNED_INT] = COMPARISON(LLVMIntNE, "ne_tmp"),
+                [TYPE_CLASS_UNSIGNED_INT] = COMPARISON(LLVMIntNE, "ne_tmp"),
+        },
+        [OPERATOR_LT] = {
+                [TYPE_CLASS_SIGNED_INT] = COMPARISON(LLVMIntSLT, "lt_tmp"),
+                [TYPE_CLASS_UNSIGNED_INT] = COMPARISON(LLVMIntULT, "lt_tmp"),
+        },
+        [OPERATOR_LE] = {
+                [TYPE_CLASS_SIGNED_INT] = COMPARISON(LLVMIntSLE, "le_tmp"),
+                [TYPE_CLASS_UNSIGNED_INT] = COMPARISON(LLVMIntULE, "le_tmp"),
+        },
+        [OPERATOR_GT] = {
+                [TYPE_CLASS_SIGNED_INT] = COMPARISON(LLVMIntSGT, "gt_tmp"),
+                [TYPE_CLASS_UNSIGNED_INT] = COMPARISON(LLVMIntUGT, "gt_tmp"),
+        },
+        [OPERATOR_GE] = {
+                [TYPE_CLASS_SIGNED_INT] = COMPARISON(LLVMIntSGE, "ge_tmp"),
+                [TYPE_CLASS_UNSIGNED_INT] = COMPARISON(LLVMIntUGE, "ge_tmp"),
+        },
+};
+
+static type_class_t get_type_class(compiler_t *compiler, type_t *type) {
+    if (type == compiler->bool_type) return TYPE_CLASS_BOOL;
+    if ((type->flags & TYPE_INT) == 0) return TYPE_CLASS_NONE;
+
+    return (type->flags & TYPE_SIGNED) != 0 ? TYPE_CLASS_SIGNED_INT : TYPE_CLASS_UNSIGNED_INT;
 }
 
-static typed_value_t *create_bool_cmp_inst(compiler_t *compiler, wchar_t *op, LLVMValueRef lhs, LLVMValueRef rhs) {
-    typed_value_t *value = malloc_s(typed_value_t);
-    value->type = compiler->bool_type;
-
-    if (!wcscmp(L"==", op)) {
-        value->value = LLVMBuildICmp(compiler->builder, LLVMIntEQ, lhs, rhs, "eq_tmp");
-        return value;
-    }
-
-    if (!wcscmp(L"!=", op)) {
-        value->value = LLVMBuildICmp(compiler->builder, LLVMIntNE, lhs, rhs, "ne_tmp");
-        return value;
+type_t *binary_result_type(compiler_t *compiler, operator_t op, type_t *operand_type) {
+    switch (binop_insts[op][get_type_class(compiler, operand_type)].kind) {
+        case BINOP_ARITHMETIC:
+            return operand_type;
+        case BINOP_COMPARISON:
+            return compiler->bool_type;
+        default:
+            return NULL;
     }
-
-    free(value);
-    return NULL;
 }
 
-typed_value_t *compile_binary_expr(compiler_t *compiler, binary_expr_t *binary_expr) {
-    typed_value_t *lhs = compile_expr(compiler, binary_expr->data->lhs, 0);
-    if (lhs == NULL) return NULL;
-
-    typed_value_t *rhs = compile_expr(compiler, binary_expr->data->rhs, 0);
-    if (rhs == NULL) {
-        free(lhs);
-        return NULL;
-    }
-
-    do_type_coercion(compiler, &lhs, &rhs);
+typed_value_t compile_binary_expr(compiler_t *compiler, binary_expr_t *binary_expr, typed_value_t lhs,
+                                  typed_value_t rhs) {
+    type_t *operand_type = binary_expr->data->operand_type;
+    if (lhs.type != operand_type) lhs = cast_value(compiler, lhs, operand_type);
+    if (rhs.type != operand_type) rhs = cast_value(compiler, rhs, operand_type);
 
-    if (lhs->type != rhs->type) {
-        fprintf(stderr, "Types in binary don't match! (%ls and %ls)\n", lhs->type->name, rhs->type->name);
+    const binop_inst_t *inst = &binop_insts[binary_expr->data->op][get_type_class(compiler, operand_type)];
 
-        free(lhs);
-        free(rhs);
-        return NULL;
+    LLVMValueRef value;
+    if (inst->kind == BINOP_ARITHMETIC) {
+        value = LLVMBuildBinOp(compiler->builder, (LLVMOpcode) inst->opcode, lhs.value, rhs.value, inst->name);
+    } else {
+        value = LLVMBuildICmp(compiler->builder, (LLVMIntPredicate) inst->opcode, lhs.value, rhs.value, inst->name);
     }
 
-    wchar_t *op = binary_expr->data->op;
-
-    typed_value_t *value = NULL;
-    if (lhs->type == compiler->bool_type) {
-        value = create_bool_cmp_inst(compiler, op, lhs->value, rhs->value);
-    } else if ((lhs->type->flags & TYPE_INT) != 0) {
-        value = create_int_binop_inst(compiler, lhs->type, op, lhs->value, rhs->value);
-    }
-
-    if (value == NULL) {
-        fprintf(stderr, "Unknown binary operator '%ls' for type %ls!\n", op, lhs->type->name);
-        return NULL;
-    }
-
-    free(lhs);
-    free(rhs);
-
-    return value;
+    return make_typed_value(binary_expr->checked_type, value);
 }
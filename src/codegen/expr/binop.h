@@ -7,7 +7,13 @@
 
 #include "../utils.h"
 
-typed_value_t *compile_unary_expr(compiler_t *compiler, unary_expr_t *binary_expr);
-typed_value_t *compile_binary_expr(compiler_t *compiler, binary_expr_t *binary_expr);
+// Type of the result of op on operands of operand_type, NULL if op isn't defined for it.
+type_t *binary_result_type(compiler_t *compiler, operator_t op, type_t *operand_type);
+
+// The operands are compiled by compile_expr, which walks operator chains without recursion. Both use the types the
+// checker annotated the expression with.
+typed_value_t compile_unary_expr(compiler_t *compiler, unary_expr_t *unary_expr, typed_value_t value);
+typed_value_t compile_binary_expr(compiler_t *compiler, binary_expr_t *binary_expr, typed_value_t lhs,
+                                  typed_value_t rhs);
 
 #endif //PASTEL_BINOP_H
@@ -7,6 +7,6 @@
 
 #include "../types.h"
 
-typed_value_t *compile_call_expr(compiler_t *compiler, call_expr_t *call_expr);
+typed_value_t compile_call_expr(compiler_t *compiler, call_expr_t *call_expr);
 
 #endif //PASTEL_CALL_H
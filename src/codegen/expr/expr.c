@@ -9,25 +9,70 @@
 #include "if.h"
 #include "call.h"
 
-typed_value_t *compile_expr(compiler_t *compiler, expr_t *expr, int is_stmt) {
+
+static typed_value_t compile_operand(compiler_t *compiler, expr_t *expr, int is_stmt) {
     switch (expr->expr_type) {
         case EXPR_INT:
-            return compile_int_expr(compiler, (int_expr_t *) expr);
+            return compile_int_expr((int_expr_t *) expr);
         case EXPR_FLOAT:
-            return compile_float_expr(compiler, (float_expr_t *) expr);
+            return compile_float_expr((float_expr_t *) expr);
         case EXPR_BOOL:
             return compile_bool_expr(compiler, (bool_expr_t *) expr);
         case EXPR_VARIABLE:
             return compile_variable_expr(compiler, (variable_expr_t *) expr);
-        case EXPR_UNARY:
-            return compile_unary_expr(compiler, (unary_expr_t *) expr);
-        case EXPR_BINARY:
-            return compile_binary_expr(compiler, (binary_expr_t *) expr);
         case EXPR_CALL:
             return compile_call_expr(compiler, (call_expr_t *) expr);
         case EXPR_IF:
             return compile_if_expr(compiler, (if_expr_t *) expr, is_stmt);
+        default:
+            return make_typed_value(NULL, NULL);
+    }
+}
+
+// Takes the value of an operand off the top of compiler->values, its type is the one the checker annotated it with.
+static typed_value_t pop_operand(compiler_t *compiler, expr_t *operand) {
+    return make_typed_value(operand->checked_type, (LLVMValueRef) ptr_list_pop(compiler->values));
+}
+
+// Applies an operator to its compiled operands on top of compiler->values.
+static typed_value_t compile_operator(compiler_t *compiler, expr_t *expr) {
+    binary_expr_data_t *binary_data;
+    typed_value_t lhs;
+    typed_value_t rhs;
+
+    switch (expr->expr_type) {
+        case EXPR_UNARY:
+            lhs = pop_operand(compiler, ((unary_expr_t *) expr)->data->value);
+            return compile_unary_expr(compiler, (unary_expr_t *) expr, lhs);
+        case EXPR_BINARY:
+            binary_data = ((binary_expr_t *) expr)->data;
+            rhs = pop_operand(compiler, binary_data->rhs);
+            lhs = pop_operand(compiler, binary_data->lhs);
+            return compile_binary_expr(compiler, (binary_expr_t *) expr, lhs, rhs);
         case EXPR_CAST:
-            return compile_cast_expr(compiler, (cast_expr_t *) expr);
+            lhs = pop_operand(compiler, ((cast_expr_t *) expr)->data->value);
+            return compile_cast_expr(compiler, (cast_expr_t *) expr, lhs);
+        default:
+            return make_typed_value(NULL, NULL);
     }
 }
+
+static int visit_operand(void *context, expr_t *expr) {
+    compiler_t *compiler = (compiler_t *) context;
+    ptr_list_push(compiler->values, compile_operand(compiler, expr, 0).value);
+    return 0;
+}
+
+static int visit_operator(void *context, expr_t *expr) {
+    compiler_t *compiler = (compiler_t *) context;
+    ptr_list_push(compiler->values, compile_operator(compiler, expr).value);
+    return 0;
+}
+
+typed_value_t compile_expr(compiler_t *compiler, expr_t *expr, int is_stmt) {
+    if (!is_operator_expr(expr)) return compile_operand(compiler, expr, is_stmt);
+
+    // The value of the root is the last one computed
+    walk_operator_chain(&compiler->walker, expr, visit_operand, visit_operator, compiler);
+    return pop_operand(compiler, expr);
+}
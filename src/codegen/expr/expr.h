@@ -7,6 +7,6 @@
 
 #include "../types.h"
 
-typed_value_t *compile_expr(compiler_t *compiler, expr_t *expr, int is_stmt);
+typed_value_t compile_expr(compiler_t *compiler, expr_t *expr, int is_stmt);
 
 #endif //PASTEL_EXPR_H
@@ -6,44 +6,12 @@
 
 #include "expr.h"
 #include "../utils.h"
+#include "../ssa.h"
 #include "../stmt/stmt.h"
 
-#include <stdio.h>
-
 #include <llvm-c/Core.h>
 
-static int can_if_be_expr(if_expr_t *expr) {
-    ptr_list_t *then_stmts = expr->data->then_stmts;
-    ptr_list_t *else_stmts = expr->data->else_stmts;
-
-    if (then_stmts == NULL) return 0;
-    if (else_stmts == NULL) return 0;
-
-    // Branch is empty
-    if (ptr_list_size(then_stmts) == 0) return 0;
-    if (ptr_list_size(else_stmts) == 0) return 0;
-
-    // Last statement in a branch has to be an expression statement for us to get a value from the branch.
-
-    stmt_t *last_then_stmt = ptr_list_at(then_stmts, ptr_list_size(then_stmts) - 1);
-    if (last_then_stmt->stmt_type != STMT_EXPR) return 0;
-
-    stmt_t *last_else_stmt = ptr_list_at(else_stmts, ptr_list_size(else_stmts) - 1);
-    if (last_else_stmt->stmt_type != STMT_EXPR) return 0;
-
-    return 1;
-}
-
-typed_value_t *compile_if_expr(compiler_t *compiler, if_expr_t *if_expr, int is_stmt) {
-    int can_be_expr = can_if_be_expr(if_expr);
-    int is_expr = !is_stmt && can_be_expr;
-
-    // Do sanity check up front
-    if (!is_stmt && !can_be_expr) {
-        fprintf(stderr, "An if statement was used as an expression, but it doesn't fit the right form!\n");
-        return NULL;
-    }
-
+typed_value_t compile_if_expr(compiler_t *compiler, if_expr_t *if_expr, int is_stmt) {
     ptr_list_t *then_stmts = if_expr->data->then_stmts;
     ptr_list_t *else_stmts = if_expr->data->else_stmts;
 
@@ -57,26 +25,28 @@ typed_value_t *compile_if_expr(compiler_t *compiler, if_expr_t *if_expr, int is_
         else_block = LLVMCreateBasicBlockInContext(compiler->context, "else");
     }
 
-    typed_value_t *condition = compile_expr(compiler, if_expr->data->condition, 0);
-    if (condition == NULL) return NULL;
-    if (condition->type != compiler->bool_type) {
-        fprintf(stderr, "If conditions must be boolean!\n");
-        return NULL;
-    }
+    typed_value_t condition = compile_expr(compiler, if_expr->data->condition, 0);
+
+    LLVMBuildCondBr(compiler->builder, condition.value, then_block, else_block);
+
+    // All predecessors of the branches are known, cont gets its own as the branches are lowered
+    ssa_block_t *branch = compiler->block;
+    ssa_block_t *then = ssa_new_block(compiler, then_block);
+    ssa_block_t *cont = ssa_new_block(compiler, cont_block);
 
-    LLVMBuildCondBr(compiler->builder, condition->value, then_block, else_block);
-    LLVMPositionBuilderAtEnd(compiler->builder, then_block);
+    ssa_add_predecessor(then, branch);
+    ssa_seal_block(compiler, then);
+    ssa_enter_block(compiler, then);
 
     size_t i;
-    typed_value_t *then_value = NULL;
+    typed_value_t then_value;
     int then_has_ret = 0;
 
     for (i = 0; i < ptr_list_size(then_stmts); i++) {
-        stmt_t *stmt = (stmt_t *) ptr_list_at(then_stmts, i);
+        stmt_t *stmt = (stmt_t *) ptr_list_at_unchecked(then_stmts, i);
         then_value = compile_stmt(compiler, stmt);
-        if (then_value == NULL) return NULL;
 
-        if (LLVMIsAReturnInst(then_value->value)) {
+        if (stmt->stmt_type == STMT_RETURN) {
             then_has_ret = 1;
             break;
         }
@@ -87,29 +57,30 @@ typed_value_t *compile_if_expr(compiler_t *compiler, if_expr_t *if_expr, int is_
      * statement in the then block is a return and there's no else branch, we'd return a value ref pointing to a
      * return, which in turn messes up code upstream.
      */
-    typed_value_t *if_value = malloc_s(typed_value_t);
-    if_value->type = compiler->void_type;
+    typed_value_t if_value = make_typed_value(compiler->void_type, condition.value);
 
     if (!then_has_ret) {
-        if_value->value = LLVMBuildBr(compiler->builder, cont_block);
-    } else {
-        if_value->value = condition->value;
+        if_value.value = LLVMBuildBr(compiler->builder, cont_block);
+        ssa_add_predecessor(cont, compiler->block);
     }
 
     then_block = LLVMGetInsertBlock(compiler->builder); // We might be in a different block than where we started.
 
-    typed_value_t *else_value = NULL;
+    typed_value_t else_value;
     int else_has_ret = 0;
     if (else_stmts != NULL) {
+        ssa_block_t *otherwise = ssa_new_block(compiler, else_block);
+        ssa_add_predecessor(otherwise, branch);
+        ssa_seal_block(compiler, otherwise);
+
         LLVMAppendExistingBasicBlock(current_function, else_block);
-        LLVMPositionBuilderAtEnd(compiler->builder, else_block);
+        ssa_enter_block(compiler, otherwise);
 
         for (i = 0; i < ptr_list_size(else_stmts); i++) {
-            stmt_t *stmt = (stmt_t *) ptr_list_at(else_stmts, i);
+            stmt_t *stmt = (stmt_t *) ptr_list_at_unchecked(else_stmts, i);
             else_value = compile_stmt(compiler, stmt);
-            if (else_value == NULL) return NULL;
 
-            if (LLVMIsAReturnInst(else_value->value)) {
+            if (stmt->stmt_type == STMT_RETURN) {
                 else_has_ret = 1;
                 break;
             }
@@ -117,9 +88,12 @@ typed_value_t *compile_if_expr(compiler_t *compiler, if_expr_t *if_expr, int is_
 
         if (!else_has_ret) {
             LLVMBuildBr(compiler->builder, cont_block);
+            ssa_add_predecessor(cont, compiler->block);
         }
 
         else_block = LLVMGetInsertBlock(compiler->builder);
+    } else {
+        ssa_add_predecessor(cont, branch);
     }
 
     /*
@@ -129,32 +103,22 @@ typed_value_t *compile_if_expr(compiler_t *compiler, if_expr_t *if_expr, int is_
         return if_value;
     }
 
+    ssa_seal_block(compiler, cont);
+
     LLVMAppendExistingBasicBlock(current_function, cont_block);
-    LLVMPositionBuilderAtEnd(compiler->builder, cont_block);
+    ssa_enter_block(compiler, cont);
 
-    if (!is_expr) {
+    if (is_stmt) {
         // We don't need any PHI node stuff, we can just return the jmp from the then branch.
         return if_value;
     }
 
-    type_t *then_type = NULL;
-    if (then_value != NULL) then_type = then_value->type;
-    type_t *else_type = NULL;
-    if (else_value != NULL) else_type = else_value->type;
-
-    if ((then_type != else_type) || (then_value == NULL) || (else_value == NULL)) {
-        fprintf(stderr, "Types must match for both branches and blocks can't be empty when using if as an expression!\n");
-        return NULL;
-    }
-
-    LLVMValueRef incoming_values[] = { then_value->value, else_value->value };
+    // The checker made sure both branches end in an expression of the if's type
+    LLVMValueRef incoming_values[] = { then_value.value, else_value.value };
     LLVMBasicBlockRef incoming_blocks[] = { then_block,else_block };
-    LLVMValueRef phi = LLVMBuildPhi(compiler->builder, then_value->type->llvm_type, "if_value");
+    LLVMValueRef phi = LLVMBuildPhi(compiler->builder, if_expr->checked_type->llvm_type, "if_value");
 
     LLVMAddIncoming(phi, incoming_values, incoming_blocks, 2);
 
-    if_value->type = then_value->type;
-    if_value->value = phi;
-
-    return if_value;
+    return make_typed_value(if_expr->checked_type, phi);
 }
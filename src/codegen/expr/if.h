@@ -7,6 +7,6 @@
 
 #include "../types.h"
 
-typed_value_t *compile_if_expr(compiler_t *compiler, if_expr_t *if_expr, int is_stmt);
+typed_value_t compile_if_expr(compiler_t *compiler, if_expr_t *if_expr, int is_stmt);
 
 #endif //PASTEL_IF_H
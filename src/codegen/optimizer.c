@@ -0,0 +1,401 @@
+//
+// Created by sarah on 3/25/24.
+//
+
+#include "optimizer.h"
+
+#include "utils.h"
+
+#include <stdint.h>
+
+typedef struct optimizer_t {
+    compiler_t *compiler;
+    arena_t *arena;
+
+    chain_walker_t walker;
+    ptr_list_t *values; // List<expr_t *> of the optimized operands of the operators still to come
+} optimizer_t;
+
+static expr_t *optimize_expr(optimizer_t *optimizer, expr_t *expr);
+static ptr_list_t *optimize_stmt_list(optimizer_t *optimizer, ptr_list_t *stmts, int is_value_branch);
+
+#define new_node(node_type) ((node_type *) arena_alloc(optimizer->arena, sizeof(node_type)))
+
+#define is_literal(expr) \
+    ((expr)->expr_type == EXPR_INT || (expr)->expr_type == EXPR_FLOAT || (expr)->expr_type == EXPR_BOOL)
+#define is_int_type(type) (((type)->flags & TYPE_INT) != 0)
+#define is_signed_type(type) (((type)->flags & TYPE_SIGNED) != 0)
+
+/* Integers are folded as the bits LLVM would hold, in the low bits of a uint64_t and zero above them */
+
+static int bit_width(type_t *type) {
+    return type->size * 8;
+}
+
+static uint64_t truncate_to(type_t *type, uint64_t bits) {
+    if (bit_width(type) >= 64) return bits;
+
+    return bits & ((UINT64_C(1) << bit_width(type)) - 1);
+}
+
+static int64_t sign_extend(type_t *type, uint64_t bits) {
+    if (bit_width(type) >= 64) return (int64_t) bits;
+
+    int shift = 64 - bit_width(type);
+    return ((int64_t) (bits << shift)) >> shift;
+}
+
+// Bits of a literal after converting it to an integer type of at least its own size, like cast_to_int.
+static uint64_t literal_bits(expr_t *expr, type_t *type) {
+    if (expr->expr_type == EXPR_BOOL) return (uint64_t) ((bool_expr_t *) expr)->data;
+
+    return truncate_to(type, truncate_to(expr->checked_type, (uint64_t) ((int_expr_t *) expr)->data));
+}
+
+// Float32 literals are kept as doubles, but LLVM rounds them to float.
+static double float_value(optimizer_t *optimizer, float_expr_t *float_expr) {
+    if (float_expr->checked_type == optimizer->compiler->float32_type) return (float) *float_expr->data;
+
+    return *float_expr->data;
+}
+
+static expr_t *make_int(optimizer_t *optimizer, type_t *type, uint64_t bits) {
+    int_expr_t *int_expr = new_node(int_expr_t);
+    int_expr->expr_type = EXPR_INT;
+    int_expr->checked_type = type;
+    int_expr->type = type->name;
+    int_expr->data = is_signed_type(type) ? sign_extend(type, bits) : (int64_t) bits;
+    return (expr_t *) int_expr;
+}
+
+static expr_t *make_bool(optimizer_t *optimizer, int value) {
+    bool_expr_t *bool_expr = new_node(bool_expr_t);
+    bool_expr->expr_type = EXPR_BOOL;
+    bool_expr->checked_type = optimizer->compiler->bool_type;
+    bool_expr->data = value;
+    return (expr_t *) bool_expr;
+}
+
+static expr_t *make_float(optimizer_t *optimizer, type_t *type, double value) {
+    float_expr_t *float_expr = (float_expr_t *) arena_alloc(optimizer->arena, sizeof(float_expr_t) + sizeof(double));
+    float_expr->expr_type = EXPR_FLOAT;
+    float_expr->checked_type = type;
+    float_expr->type = type->name;
+    float_expr->data = (double *) (float_expr + 1);
+    *float_expr->data = type == optimizer->compiler->float32_type ? (float) value : value;
+    return (expr_t *) float_expr;
+}
+
+// Whether converting value to the integer type gives a defined result.
+static int float_fits(type_t *type, double value) {
+    if (value != value) return 0;
+
+    if (!is_signed_type(type)) {
+        double limit = 2.0 * (double) (UINT64_C(1) << (bit_width(type) - 1));
+        return value > -1.0 && value < limit;
+    }
+
+    double limit = (double) (UINT64_C(1) << (bit_width(type) - 1));
+    return value > -limit - 1.0 && value < limit;
+}
+
+static expr_t *fold_cast_literal(optimizer_t *optimizer, cast_expr_t *cast_expr, expr_t *value) {
+    type_t *from = value->checked_type;
+    type_t *to = cast_expr->checked_type;
+    int is_float32 = to == optimizer->compiler->float32_type;
+
+    if (value->expr_type == EXPR_INT) {
+        uint64_t bits = literal_bits(value, from);
+        if (is_int_type(to)) return make_int(optimizer, to, truncate_to(to, bits));
+
+        if (is_signed_type(from)) {
+            int64_t signed_bits = sign_extend(from, bits);
+            return make_float(optimizer, to, is_float32 ? (float) signed_bits : (double) signed_bits);
+        }
+
+        return make_float(optimizer, to, is_float32 ? (float) bits : (double) bits);
+    }
+
+    if (value->expr_type != EXPR_FLOAT) return (expr_t *) cast_expr;
+
+    double number = float_value(optimizer, (float_expr_t *) value);
+    if (!is_int_type(to)) return make_float(optimizer, to, number);
+    if (!float_fits(to, number)) return (expr_t *) cast_expr;
+
+    if (is_signed_type(to)) return make_int(optimizer, to, truncate_to(to, (uint64_t) (int64_t) number));
+    return make_int(optimizer, to, (uint64_t) number);
+}
+
+/*
+ * An integer cast widens by zero extending and narrows by truncating, see cast_to_int. Two in a row are the same as
+ * one from the first type to the last, unless the middle type cuts bits off that the last one would have kept.
+ */
+static expr_t *fold_cast(optimizer_t *optimizer, cast_expr_t *cast_expr, expr_t *value) {
+    cast_expr->data->value = value;
+
+    if (value->checked_type == cast_expr->checked_type) return value;
+    if (is_literal(value)) return fold_cast_literal(optimizer, cast_expr, value);
+    if (value->expr_type != EXPR_CAST) return (expr_t *) cast_expr;
+
+    expr_t *inner_value = ((cast_expr_t *) value)->data->value;
+    type_t *from = inner_value->checked_type;
+    type_t *middle = value->checked_type;
+    type_t *to = cast_expr->checked_type;
+
+    if (!is_int_type(from) || !is_int_type(middle) || !is_int_type(to)) return (expr_t *) cast_expr;
+    if (middle->size < from->size && to->size > middle->size) return (expr_t *) cast_expr;
+
+    cast_expr->data->value = inner_value;
+    return from == to ? inner_value : (expr_t *) cast_expr;
+}
+
+static expr_t *fold_unary(unary_expr_t *unary_expr, expr_t *value) {
+    unary_expr->data->value = value;
+    if (value->expr_type != EXPR_BOOL) return (expr_t *) unary_expr;
+
+    // '!' is the only unary operator. Nothing else points at the literal, so it's flipped in place
+    ((bool_expr_t *) value)->data = !((bool_expr_t *) value)->data;
+    return value;
+}
+
+static expr_t *fold_binary(optimizer_t *optimizer, binary_expr_t *binary_expr, expr_t *lhs, expr_t *rhs) {
+    binary_expr_data_t *data = binary_expr->data;
+    type_t *type = data->operand_type;
+
+    // Integer literals are converted to the operand type up front, so lowering doesn't have to cast them
+    if (is_int_type(type)) {
+        if (lhs->expr_type == EXPR_INT && lhs->checked_type != type) {
+            lhs = make_int(optimizer, type, literal_bits(lhs, type));
+        }
+
+        if (rhs->expr_type == EXPR_INT && rhs->checked_type != type) {
+            rhs = make_int(optimizer, type, literal_bits(rhs, type));
+        }
+    }
+
+    data->lhs = lhs;
+    data->rhs = rhs;
+
+    if ((lhs->expr_type != EXPR_INT && lhs->expr_type != EXPR_BOOL) || lhs->expr_type != rhs->expr_type) {
+        return (expr_t *) binary_expr;
+    }
+
+    uint64_t a = literal_bits(lhs, type);
+    uint64_t b = literal_bits(rhs, type);
+    int is_signed = is_signed_type(type);
+    int64_t signed_a = sign_extend(type, a);
+    int64_t signed_b = sign_extend(type, b);
+
+    switch (data->op) {
+        case OPERATOR_ADD:
+            return make_int(optimizer, type, truncate_to(type, a + b));
+        case OPERATOR_SUB:
+            return make_int(optimizer, type, truncate_to(type, a - b));
+        case OPERATOR_MUL:
+            return make_int(optimizer, type, truncate_to(type, a * b));
+        case OPERATOR_DIV:
+            // Division by zero and the one signed division that overflows are undefined, so they're left alone
+            if (b == 0) return (expr_t *) binary_expr;
+            if (!is_signed) return make_int(optimizer, type, a / b);
+            if (signed_b == -1 && a == (UINT64_C(1) << (bit_width(type) - 1))) return (expr_t *) binary_expr;
+
+            return make_int(optimizer, type, truncate_to(type, (uint64_t) (signed_a / signed_b)));
+        case OPERATOR_EQ:
+            return make_bool(optimizer, a == b);
+        case OPERATOR_NE:
+            return make_bool(optimizer, a != b);
+        case OPERATOR_LT:
+            return make_bool(optimizer, is_signed ? signed_a < signed_b : a < b);
+        case OPERATOR_LE:
+            return make_bool(optimizer, is_signed ? signed_a <= signed_b : a <= b);
+        case OPERATOR_GT:
+            return make_bool(optimizer, is_signed ? signed_a > signed_b : a > b);
+        case OPERATOR_GE:
+            return make_bool(optimizer, is_signed ? signed_a >= signed_b : a >= b);
+        default:
+            return (expr_t *) binary_expr;
+    }
+}
+
+// Folds an operator whose optimized operands are on top of optimizer->values.
+static expr_t *fold_operator(optimizer_t *optimizer, expr_t *expr) {
+    expr_t *lhs;
+    expr_t *rhs;
+
+    switch (expr->expr_type) {
+        case EXPR_UNARY:
+            return fold_unary((unary_expr_t *) expr, (expr_t *) ptr_list_pop(optimizer->values));
+        case EXPR_BINARY:
+            rhs = (expr_t *) ptr_list_pop(optimizer->values);
+            lhs = (expr_t *) ptr_list_pop(optimizer->values);
+            return fold_binary(optimizer, (binary_expr_t *) expr, lhs, rhs);
+        case EXPR_CAST:
+            return fold_cast(optimizer, (cast_expr_t *) expr, (expr_t *) ptr_list_pop(optimizer->values));
+        default:
+            return expr;
+    }
+}
+
+// An if used as a value with a literal condition is the value of the branch it takes, if that's all the branch does.
+static expr_t *optimize_if(optimizer_t *optimizer, if_expr_t *if_expr) {
+    if_expr_data_t *data = if_expr->data;
+
+    data->condition = optimize_expr(optimizer, data->condition);
+    data->then_stmts = optimize_stmt_list(optimizer, data->then_stmts, 1);
+    if (data->else_stmts != NULL) {
+        data->else_stmts = optimize_stmt_list(optimizer, data->else_stmts, 1);
+    }
+
+    if (data->condition->expr_type != EXPR_BOOL) return (expr_t *) if_expr;
+
+    ptr_list_t *taken = ((bool_expr_t *) data->condition)->data ? data->then_stmts : data->else_stmts;
+    if (taken == NULL || ptr_list_size(taken) != 1) return (expr_t *) if_expr;
+
+    stmt_t *stmt = (stmt_t *) ptr_list_at_unchecked(taken, 0);
+    if (stmt->stmt_type != STMT_EXPR) return (expr_t *) if_expr;
+
+    expr_t *value = ((expr_stmt_t *) stmt)->expr;
+    return value->checked_type == if_expr->checked_type ? value : (expr_t *) if_expr;
+}
+
+static expr_t *optimize_operand(optimizer_t *optimizer, expr_t *expr) {
+    ptr_list_t *arguments;
+    size_t i;
+
+    switch (expr->expr_type) {
+        case EXPR_CALL:
+            arguments = ((call_expr_t *) expr)->data->arguments;
+            for (i = 0; i < ptr_list_size(arguments); i++) {
+                ptr_list_at_unchecked(arguments, i) = optimize_expr(optimizer, ptr_list_at_unchecked(arguments, i));
+            }
+            return expr;
+        case EXPR_IF:
+            return optimize_if(optimizer, (if_expr_t *) expr);
+        default:
+            return expr;
+    }
+}
+
+static int visit_operand(void *context, expr_t *expr) {
+    optimizer_t *optimizer = (optimizer_t *) context;
+    ptr_list_push(optimizer->values, optimize_operand(optimizer, expr));
+    return 0;
+}
+
+static int visit_operator(void *context, expr_t *expr) {
+    optimizer_t *optimizer = (optimizer_t *) context;
+    ptr_list_push(optimizer->values, fold_operator(optimizer, expr));
+    return 0;
+}
+
+// Returns what replaces expr, which is expr itself if nothing could be folded.
+static expr_t *optimize_expr(optimizer_t *optimizer, expr_t *expr) {
+    if (!is_operator_expr(expr)) return optimize_operand(optimizer, expr);
+
+    walk_operator_chain(&optimizer->walker, expr, visit_operand, visit_operator, optimizer);
+    return (expr_t *) ptr_list_pop(optimizer->values);
+}
+
+static void optimize_stmt(optimizer_t *optimizer, stmt_t *stmt) {
+    return_stmt_t *return_stmt;
+    expr_stmt_t *expr_stmt;
+    assignment_stmt_data_t *assignment_data;
+    declaration_stmt_data_t *declaration_data;
+    while_stmt_data_t *while_data;
+
+    switch (stmt->stmt_type) {
+        case STMT_RETURN:
+            return_stmt = (return_stmt_t *) stmt;
+            return_stmt->value = optimize_expr(optimizer, return_stmt->value);
+            break;
+        case STMT_EXPR:
+            expr_stmt = (expr_stmt_t *) stmt;
+            expr_stmt->expr = optimize_expr(optimizer, expr_stmt->expr);
+            break;
+        case STMT_ASSIGNMENT:
+            assignment_data = ((assignment_stmt_t *) stmt)->data;
+            assignment_data->value = optimize_expr(optimizer, assignment_data->value);
+            break;
+        case STMT_DECLARATION:
+            declaration_data = ((declaration_stmt_t *) stmt)->data;
+            if (declaration_data->value != NULL) {
+                declaration_data->value = optimize_expr(optimizer, declaration_data->value);
+            }
+            break;
+        case STMT_WHILE:
+            while_data = ((while_stmt_t *) stmt)->data;
+            while_data->condition = optimize_expr(optimizer, while_data->condition);
+            while_data->body = optimize_stmt_list(optimizer, while_data->body, 0);
+            break;
+        default:
+            break;
+    }
+}
+
+/*
+ * Whether an optimized statement is replaced, by the statements in replacement or by nothing if that's NULL. The
+ * variables of a branch that's spliced into the statements around it are resolved already, so leaving its scope
+ * changes nothing.
+ */
+static int is_pruned(stmt_t *stmt, ptr_list_t **replacement) {
+    expr_t *condition;
+    *replacement = NULL;
+
+    if (stmt->stmt_type == STMT_WHILE) {
+        condition = ((while_stmt_t *) stmt)->data->condition;
+        return condition->expr_type == EXPR_BOOL && !((bool_expr_t *) condition)->data;
+    }
+
+    if (stmt->stmt_type != STMT_EXPR || ((expr_stmt_t *) stmt)->expr->expr_type != EXPR_IF) return 0;
+
+    if_expr_data_t *if_data = ((if_expr_t *) ((expr_stmt_t *) stmt)->expr)->data;
+    if (if_data->condition->expr_type != EXPR_BOOL) return 0;
+
+    *replacement = ((bool_expr_t *) if_data->condition)->data ? if_data->then_stmts : if_data->else_stmts;
+    return 1;
+}
+
+/*
+ * Returns the optimized statements, which are stmts itself unless one was pruned. The last statement of a branch
+ * that gives an if its value stays where it is, so the branch keeps its type.
+ */
+static ptr_list_t *optimize_stmt_list(optimizer_t *optimizer, ptr_list_t *stmts, int is_value_branch) {
+    ptr_list_t *result = stmts;
+    size_t count = ptr_list_size(stmts);
+
+    size_t i;
+    for (i = 0; i < count; i++) {
+        stmt_t *stmt = (stmt_t *) ptr_list_at_unchecked(stmts, i);
+        optimize_stmt(optimizer, stmt);
+
+        ptr_list_t *replacement;
+        if ((is_value_branch && i + 1 == count) || !is_pruned(stmt, &replacement)) {
+            if (result != stmts) ptr_list_push(result, stmt);
+            continue;
+        }
+
+        size_t j;
+        if (result == stmts) {
+            result = ptr_list_new_arena(optimizer->arena, count);
+            for (j = 0; j < i; j++) ptr_list_push(result, ptr_list_at_unchecked(stmts, j));
+        }
+
+        if (replacement == NULL) continue;
+        for (j = 0; j < ptr_list_size(replacement); j++) ptr_list_push(result, ptr_list_at_unchecked(replacement, j));
+    }
+
+    return result;
+}
+
+void optimize_function(compiler_t *compiler, function_stmt_t *function_stmt) {
+    optimizer_t optimizer;
+    optimizer.compiler = compiler;
+    optimizer.arena = compiler->arena;
+    chain_walker_init(&optimizer.walker);
+    optimizer.values = ptr_list_new();
+
+    function_stmt->data->body = optimize_stmt_list(&optimizer, function_stmt->data->body, 0);
+
+    chain_walker_free(&optimizer.walker);
+    ptr_list_free(optimizer.values);
+}
@@ -0,0 +1,23 @@
+//
+// Created by sarah on 3/25/24.
+//
+
+#ifndef PASTEL_OPTIMIZER_H
+#define PASTEL_OPTIMIZER_H
+
+#include "types.h"
+
+/*
+ * Simplifies the body of a function that check_function accepted, before it's lowered:
+ *
+ * - Operators and casts on literals are replaced by the literal they evaluate to, with the same result lowering would
+ *   compute. Divisions by zero and casts of floats that don't fit are left to run.
+ * - Integer casts of integer casts are merged where that doesn't change the value, and casts to the type a value
+ *   already has are dropped.
+ * - Ifs with a literal condition are replaced by the branch they take, whiles whose condition is false are removed.
+ *
+ * The AST is changed in place, new nodes and lists come from compiler->arena.
+ */
+void optimize_function(compiler_t *compiler, function_stmt_t *function_stmt);
+
+#endif //PASTEL_OPTIMIZER_H
@@ -0,0 +1,217 @@
+//
+// Created by sarah on 3/25/24.
+//
+
+#include "ssa.h"
+
+#include "utils.h"
+
+#include <llvm-c/Core.h>
+
+// Maps with more entries than this are replaced instead of cleared after a function, see clear_map
+#define MAX_REUSED_MAP_CAPACITY 256
+
+static LLVMValueRef read_variable(compiler_t *compiler, ssa_block_t *block, size_t slot);
+
+void ssa_begin_function(compiler_t *compiler, LLVMBasicBlockRef entry) {
+    ssa_block_t *block = ssa_new_block(compiler, entry);
+    ssa_seal_block(compiler, block);
+    ssa_enter_block(compiler, block);
+}
+
+// Clearing touches the whole table, so one that a big function grew would slow down every function after it.
+static void clear_map(ptr_map_t **map) {
+    if ((*map)->mask + 1 > MAX_REUSED_MAP_CAPACITY) {
+        ptr_map_free(*map);
+        *map = ptr_map_new();
+        return;
+    }
+
+    ptr_map_clear(*map);
+}
+
+void ssa_end_function(compiler_t *compiler) {
+    /*
+     * A replaced phi can still be used by code that got hold of it before, it's a valid instruction whose operands are
+     * all the same value. Only the unused ones can go.
+     */
+    size_t i;
+    for (i = 0; i < ptr_list_size(compiler->removed_phis); i++) {
+        LLVMValueRef phi = (LLVMValueRef) ptr_list_at_unchecked(compiler->removed_phis, i);
+        if (LLVMGetFirstUse(phi) == NULL) LLVMInstructionEraseFromParent(phi);
+    }
+
+    ptr_list_clear(compiler->removed_phis);
+    clear_map(&compiler->replaced_phis);
+    clear_map(&compiler->blocks_by_ref);
+
+    arena_reset(compiler->ssa_arena);
+    compiler->block = NULL;
+}
+
+ssa_block_t *ssa_new_block(compiler_t *compiler, LLVMBasicBlockRef block) {
+    size_t slot_count = ptr_list_size(compiler->variables);
+
+    ssa_block_t *ssa_block = (ssa_block_t *) arena_alloc(compiler->ssa_arena, sizeof(ssa_block_t));
+    ssa_block->block = block;
+    ssa_block->predecessors = ptr_list_new_arena(compiler->ssa_arena, 2);
+    ssa_block->definitions = (LLVMValueRef *) arena_alloc(compiler->ssa_arena, sizeof(LLVMValueRef) * slot_count);
+    ssa_block->incomplete_phis = (LLVMValueRef *) arena_alloc(compiler->ssa_arena, sizeof(LLVMValueRef) * slot_count);
+    ssa_block->is_sealed = 0;
+
+    ptr_map_put(compiler->blocks_by_ref, block, ssa_block);
+
+    return ssa_block;
+}
+
+void ssa_add_predecessor(ssa_block_t *block, ssa_block_t *predecessor) {
+    ptr_list_push(block->predecessors, predecessor);
+}
+
+void ssa_enter_block(compiler_t *compiler, ssa_block_t *block) {
+    compiler->block = block;
+    LLVMPositionBuilderAtEnd(compiler->builder, block->block);
+}
+
+// Follows replaced phis to the value that took their place.
+static LLVMValueRef resolve(compiler_t *compiler, LLVMValueRef value) {
+    LLVMValueRef replacement;
+    while ((replacement = (LLVMValueRef) ptr_map_get(compiler->replaced_phis, value)) != NULL) {
+        value = replacement;
+    }
+
+    return value;
+}
+
+// Phis go before everything else in the block, the builder goes back to the end of the current one afterwards.
+static LLVMValueRef new_phi(compiler_t *compiler, ssa_block_t *block, size_t slot) {
+    variable_t *variable = find_variable(compiler, slot);
+
+    LLVMValueRef first = LLVMGetFirstInstruction(block->block);
+    if (first != NULL) {
+        LLVMPositionBuilderBefore(compiler->builder, first);
+    } else {
+        LLVMPositionBuilderAtEnd(compiler->builder, block->block);
+    }
+
+    LLVMValueRef phi = LLVMBuildPhi(compiler->builder, variable->type->llvm_type, variable->name);
+    LLVMPositionBuilderAtEnd(compiler->builder, compiler->block->block);
+
+    return phi;
+}
+
+// Phis that are still being filled in, or waiting for their block to be sealed, can't be judged yet.
+static int is_complete_phi(compiler_t *compiler, LLVMValueRef phi) {
+    if (ptr_map_get(compiler->replaced_phis, phi) != NULL) return 0;
+
+    ssa_block_t *block = (ssa_block_t *) ptr_map_get(compiler->blocks_by_ref, LLVMGetInstructionParent(phi));
+
+    return block != NULL && block->is_sealed && LLVMCountIncoming(phi) == ptr_list_size(block->predecessors);
+}
+
+/*
+ * A phi whose operands are all the same value, or the phi itself, is replaced by that value. That can make the phis
+ * using it trivial as well, so those are tried next. Returns what the phi stands for now.
+ */
+static LLVMValueRef try_remove_trivial_phi(compiler_t *compiler, LLVMValueRef phi) {
+    LLVMValueRef same = NULL;
+
+    unsigned i;
+    for (i = 0; i < LLVMCountIncoming(phi); i++) {
+        LLVMValueRef operand = LLVMGetIncomingValue(phi, i);
+        if (operand == same || operand == phi) continue;
+        if (same != NULL) return phi;
+
+        same = operand;
+    }
+
+    // Only reachable from the entry block without an assignment, like a load from an alloca that was never stored to
+    if (same == NULL) {
+        same = LLVMGetUndef(LLVMTypeOf(phi));
+    }
+
+    // The phis using this one, collected before the uses are rewired
+    size_t base = ptr_list_size(compiler->values);
+
+    LLVMUseRef use;
+    for (use = LLVMGetFirstUse(phi); use != NULL; use = LLVMGetNextUse(use)) {
+        LLVMValueRef user = LLVMGetUser(use);
+        if (user != phi && LLVMIsAPHINode(user) != NULL) ptr_list_push(compiler->values, user);
+    }
+
+    LLVMReplaceAllUsesWith(phi, same);
+    ptr_map_put(compiler->replaced_phis, phi, same);
+    ptr_list_push(compiler->removed_phis, phi);
+
+    size_t j;
+    for (j = base; j < ptr_list_size(compiler->values); j++) {
+        LLVMValueRef user = (LLVMValueRef) ptr_list_at_unchecked(compiler->values, j);
+        if (is_complete_phi(compiler, user)) try_remove_trivial_phi(compiler, user);
+    }
+
+    ptr_list_truncate(compiler->values, base);
+
+    return same;
+}
+
+static LLVMValueRef add_phi_operands(compiler_t *compiler, ssa_block_t *block, size_t slot, LLVMValueRef phi) {
+    size_t i;
+    for (i = 0; i < ptr_list_size(block->predecessors); i++) {
+        ssa_block_t *predecessor = (ssa_block_t *) ptr_list_at_unchecked(block->predecessors, i);
+
+        LLVMValueRef value = read_variable(compiler, predecessor, slot);
+        LLVMAddIncoming(phi, &value, &predecessor->block, 1);
+    }
+
+    return try_remove_trivial_phi(compiler, phi);
+}
+
+static LLVMValueRef read_variable_recursive(compiler_t *compiler, ssa_block_t *block, size_t slot) {
+    LLVMValueRef value;
+    size_t predecessor_count = ptr_list_size(block->predecessors);
+
+    if (!block->is_sealed) {
+        value = new_phi(compiler, block, slot);
+        block->incomplete_phis[slot] = value;
+    } else if (predecessor_count == 0) {
+        value = LLVMGetUndef(find_variable(compiler, slot)->type->llvm_type);
+    } else if (predecessor_count == 1) {
+        value = read_variable(compiler, (ssa_block_t *) ptr_list_at_unchecked(block->predecessors, 0), slot);
+    } else {
+        // Recorded before the predecessors are read, so a loop that leads back here finds it and stops
+        value = new_phi(compiler, block, slot);
+        block->definitions[slot] = value;
+        value = add_phi_operands(compiler, block, slot, value);
+    }
+
+    block->definitions[slot] = value;
+    return value;
+}
+
+static LLVMValueRef read_variable(compiler_t *compiler, ssa_block_t *block, size_t slot) {
+    LLVMValueRef value = block->definitions[slot];
+    if (value != NULL) return resolve(compiler, value);
+
+    return read_variable_recursive(compiler, block, slot);
+}
+
+void ssa_seal_block(compiler_t *compiler, ssa_block_t *block) {
+    // Sealed first, the phis filled in below count as complete as soon as they have all their operands
+    block->is_sealed = 1;
+
+    size_t slot;
+    for (slot = 0; slot < ptr_list_size(compiler->variables); slot++) {
+        if (block->incomplete_phis[slot] == NULL) continue;
+
+        add_phi_operands(compiler, block, slot, block->incomplete_phis[slot]);
+        block->incomplete_phis[slot] = NULL;
+    }
+}
+
+void ssa_write_variable(compiler_t *compiler, size_t slot, LLVMValueRef value) {
+    compiler->block->definitions[slot] = value;
+}
+
+LLVMValueRef ssa_read_variable(compiler_t *compiler, size_t slot) {
+    return read_variable(compiler, compiler->block, slot);
+}
@@ -0,0 +1,42 @@
+//
+// Created by sarah on 3/25/24.
+//
+
+#ifndef PASTEL_SSA_H
+#define PASTEL_SSA_H
+
+#include "types.h"
+
+/*
+ * Builds SSA form for local variables while lowering, so they live in registers without allocas, loads and stores.
+ * Follows Braun et al., "Simple and Efficient Construction of Static Single Assignment Form":
+ *
+ * - Every block remembers the value each variable slot was last assigned in it.
+ * - Reading a variable the block doesn't know looks it up in its predecessors. A block with several of them gets a phi.
+ * - A block that can still gain predecessors, a loop header while its body is lowered, isn't sealed yet. Reads in it
+ *   add phis without operands, which are filled in when it's sealed.
+ * - Phis that only ever see one value are replaced by it.
+ *
+ * Lowering goes through ssa_enter_block instead of positioning the builder itself, so compiler->block is the block
+ * that's being appended to.
+ */
+
+// Sets up the entry block, sealed and entered, for the variables in compiler->variables.
+void ssa_begin_function(compiler_t *compiler, LLVMBasicBlockRef entry);
+
+// Erases the phis that were replaced and frees the blocks. Call before verifying the function.
+void ssa_end_function(compiler_t *compiler);
+
+ssa_block_t *ssa_new_block(compiler_t *compiler, LLVMBasicBlockRef block);
+void ssa_add_predecessor(ssa_block_t *block, ssa_block_t *predecessor);
+
+// Call once all predecessors of the block have been added.
+void ssa_seal_block(compiler_t *compiler, ssa_block_t *block);
+
+// Positions the builder at the end of the block.
+void ssa_enter_block(compiler_t *compiler, ssa_block_t *block);
+
+void ssa_write_variable(compiler_t *compiler, size_t slot, LLVMValueRef value);
+LLVMValueRef ssa_read_variable(compiler_t *compiler, size_t slot);
+
+#endif //PASTEL_SSA_H
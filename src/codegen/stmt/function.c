@@ -6,6 +6,9 @@
 
 #include "stmt.h"
 #include "../utils.h"
+#include "../checker.h"
+#include "../optimizer.h"
+#include "../ssa.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -17,23 +20,25 @@ function_t *compile_prototype(compiler_t *compiler, prototype_t *p) {
     annotated_prototype_t *prototype = annotate_prototype(compiler, p);
     LLVMTypeRef function_type = get_function_type(prototype);
 
-    LLVMValueRef function = LLVMAddFunction(compiler->module, to_mbs(prototype->name), function_type);
+    LLVMValueRef function = LLVMAddFunction(compiler->module, prototype->name, function_type);
     LLVMSetLinkage(function, LLVMExternalLinkage);
 
     function_t *function_obj = (function_t *) malloc(sizeof(function_t));
     function_obj->prototype = prototype;
     function_obj->type = function_type;
     function_obj->function = function;
+    function_obj->pending_definition = NULL;
+    function_obj->is_queued = 0;
 
     ptr_list_push(compiler->functions, function_obj);
+    ptr_map_put(compiler->functions_by_name, prototype->name, function_obj);
 
     size_t i;
     for (i = 0; i < ptr_list_size(prototype->arguments); i++) {
-        annotated_typed_arg_t *arg = (annotated_typed_arg_t *) ptr_list_at(prototype->arguments, i);
+        annotated_typed_arg_t *arg = (annotated_typed_arg_t *) ptr_list_at_unchecked(prototype->arguments, i);
 
         LLVMValueRef param = LLVMGetParam(function, i);
-        char *mbs_str = to_mbs(arg->name);
-        LLVMSetValueName2(param, mbs_str, strlen(mbs_str));
+        LLVMSetValueName2(param, arg->name, strlen(arg->name));
     }
 
     return function_obj;
@@ -41,28 +46,38 @@ function_t *compile_prototype(compiler_t *compiler, prototype_t *p) {
 
 function_t *compile_function(compiler_t *compiler, function_stmt_t *function_stmt) {
     if (find_function_by_name(compiler, function_stmt->data->prototype->name) != NULL) {
-        fprintf(stderr, "Redefinition of function %ls!\n", function_stmt->data->prototype->name);
+        fprintf(stderr, "Redefinition of function %s!\n", function_stmt->data->prototype->name);
         return NULL;
     }
 
     function_t *function_obj = compile_prototype(compiler, function_stmt->data->prototype);
-    LLVMValueRef function = function_obj->function;
+    if (check_function(compiler, function_obj, function_stmt)) {
+        LLVMDeleteFunction(function_obj->function);
+        return NULL;
+    }
 
-    LLVMBasicBlockRef bb = LLVMAppendBasicBlockInContext(compiler->context, function, "entry");
-    LLVMPositionBuilderAtEnd(compiler->builder, bb);
+    optimize_function(compiler, function_stmt);
+    return compile_function_body(compiler, function_obj, function_stmt);
+}
 
-    // Reset variable list
+void request_function(compiler_t *compiler, function_t *function_obj) {
+    if (function_obj->pending_definition == NULL || function_obj->is_queued) return;
 
-    size_t i;
-    for (i = 0; i < ptr_list_size(compiler->variables); i++) {
-        free(ptr_list_at(compiler->variables, i));
-    }
+    function_obj->is_queued = 1;
+    ptr_list_push(compiler->worklist, function_obj);
+}
 
-    ptr_list_free(compiler->variables);
-    compiler->variables = ptr_list_new();
+function_t *compile_function_body(compiler_t *compiler, function_t *function_obj, function_stmt_t *function_stmt) {
+    LLVMValueRef function = function_obj->function;
+
+    // Reset variable list
 
-    // Add function parameters
+    clear_variables(compiler);
 
+    // Add function parameters and then local variables, in the order of the slots the resolver assigned. Their types
+    // were looked up by the checker already.
+
+    size_t i;
     for (i = 0; i < LLVMCountParams(function); i++) {
         annotated_typed_arg_t *arg = ((annotated_typed_arg_t *) ptr_list_at(function_obj->prototype->arguments, i));
 
@@ -74,35 +89,26 @@ function_t *compile_function(compiler_t *compiler, function_stmt_t *function_stm
         ptr_list_push(compiler->variables, variable);
     }
 
-    // Add stack variables
-
     for (i = 0; i < ptr_list_size(function_stmt->data->variables); i++) {
-        typed_ast_value_t *ast_var = (typed_ast_value_t *) ptr_list_at(function_stmt->data->variables, i);
+        typed_ast_value_t *ast_var = (typed_ast_value_t *) ptr_list_at_unchecked(function_stmt->data->variables, i);
 
         type_t *type = find_type(compiler, ast_var->type);
-        if (type == NULL) {
-            fprintf(stderr, "Unknown type %ls\n", ast_var->type);
-            return NULL;
-        }
-
         variable_t *var = malloc_s(variable_t);
         var->name = ast_var->name;
-        var->value = LLVMBuildAlloca(compiler->builder, type->llvm_type, to_mbs(ast_var->name));
+        var->value = NULL;
         var->type = type;
         var->flags = ast_var->flags;
         ptr_list_push(compiler->variables, var);
     }
 
-    // Compile body
+    // Compile body, locals don't get any storage, their values are kept in SSA form as they're assigned
+
+    ssa_begin_function(compiler, LLVMAppendBasicBlockInContext(compiler->context, function, "entry"));
 
     int has_ret = 0;
     for (i = 0; i < ptr_list_size(function_stmt->data->body); i++) {
-        stmt_t *stmt = (stmt_t *) ptr_list_at(function_stmt->data->body, i);
-        typed_value_t *value = compile_stmt(compiler, stmt);
-        if (value == NULL) {
-            LLVMDeleteFunction(function);
-            return NULL;
-        }
+        stmt_t *stmt = (stmt_t *) ptr_list_at_unchecked(function_stmt->data->body, i);
+        compile_stmt(compiler, stmt);
 
         if (stmt->stmt_type == STMT_RETURN) {
             has_ret = 1;
@@ -110,16 +116,13 @@ function_t *compile_function(compiler_t *compiler, function_stmt_t *function_stm
         }
     }
 
+    // The checker made sure only void functions can get here without a return
     if (!has_ret) {
-        if (function_obj->prototype->return_type != compiler->void_type) {
-            fprintf(stderr, "Missing return in non-void function %ls!\n", function_obj->prototype->name);
-            LLVMDeleteFunction(function);
-            return NULL;
-        }
-
         LLVMBuildRetVoid(compiler->builder);
     }
 
+    ssa_end_function(compiler);
+
     if (LLVMVerifyFunction(function, LLVMPrintMessageAction)) {
         LLVMDumpValue(function);
         LLVMDeleteFunction(function);
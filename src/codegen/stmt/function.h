@@ -10,4 +10,10 @@
 function_t *compile_prototype(compiler_t *compiler, prototype_t *p);
 function_t *compile_function(compiler_t *compiler, function_stmt_t *function_stmt);
 
+// Lowers the body of an already declared function, which check_function accepted.
+function_t *compile_function_body(compiler_t *compiler, function_t *function_obj, function_stmt_t *function_stmt);
+
+// Queues a lazily compiled function for compilation, once it turns out to be called.
+void request_function(compiler_t *compiler, function_t *function_obj);
+
 #endif //PASTEL_FUNCTION_H
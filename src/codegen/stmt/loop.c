@@ -7,53 +7,61 @@
 #include "stmt.h"
 #include "../expr/expr.h"
 #include "../utils.h"
-
-#include <stdio.h>
+#include "../ssa.h"
 
 #include <llvm-c/Core.h>
 
-typed_value_t *compile_while(compiler_t *compiler, while_stmt_data_t *data) {
+typed_value_t compile_while(compiler_t *compiler, while_stmt_data_t *data) {
     LLVMValueRef current_function = LLVMGetBasicBlockParent(LLVMGetInsertBlock(compiler->builder));
 
     LLVMBasicBlockRef cond_block = LLVMAppendBasicBlockInContext(compiler->context, current_function, "loop_cond");
     LLVMBasicBlockRef loop_body = LLVMCreateBasicBlockInContext(compiler->context, "loop_body");
     LLVMBasicBlockRef cont_block = LLVMCreateBasicBlockInContext(compiler->context, "loop_cont");
 
+    // The condition is also reached from the end of the body, so it's sealed only once that's lowered
+    ssa_block_t *cond = ssa_new_block(compiler, cond_block);
+    ssa_add_predecessor(cond, compiler->block);
+
     LLVMBuildBr(compiler->builder, cond_block);
-    LLVMPositionBuilderAtEnd(compiler->builder, cond_block);
+    ssa_enter_block(compiler, cond);
 
-    typed_value_t *condition = compile_expr(compiler, data->condition, 0);
-    if (condition == NULL) return NULL;
-    if (condition->type != compiler->bool_type) {
-        fprintf(stderr, "Expected boolean type for while condition, but got %ls!\n", condition->type->name);
-        return NULL;
-    }
+    typed_value_t condition = compile_expr(compiler, data->condition, 0);
+    LLVMValueRef branch = LLVMBuildCondBr(compiler->builder, condition.value, loop_body, cont_block);
 
-    typed_value_t *ret = malloc_s(typed_value_t);
-    ret->type = compiler->void_type;
-    ret->value = LLVMBuildCondBr(compiler->builder, condition->value, loop_body, cont_block);
+    // The condition may have left cond_block, the branch is in the block it ended in
+    ssa_block_t *body = ssa_new_block(compiler, loop_body);
+    ssa_add_predecessor(body, compiler->block);
+    ssa_seal_block(compiler, body);
+
+    ssa_block_t *cont = ssa_new_block(compiler, cont_block);
+    ssa_add_predecessor(cont, compiler->block);
+    ssa_seal_block(compiler, cont);
 
     LLVMAppendExistingBasicBlock(current_function, loop_body);
-    LLVMPositionBuilderAtEnd(compiler->builder, loop_body);
+    ssa_enter_block(compiler, body);
 
+    int has_ret = 0;
     size_t i;
     for (i = 0; i < ptr_list_size(data->body); i++) {
-        stmt_t *stmt = (stmt_t *) ptr_list_at(data->body, i);
-        typed_value_t *value = compile_stmt(compiler, stmt);
-        if (value == NULL) return NULL;
+        stmt_t *stmt = (stmt_t *) ptr_list_at_unchecked(data->body, i);
+        compile_stmt(compiler, stmt);
 
         if (stmt->stmt_type == STMT_RETURN) {
-            free(ret);
-            ret = value;
+            has_ret = 1;
             break;
         }
     }
 
-    if (!LLVMIsAReturnInst(ret->value)) {
+    // A body that returns doesn't loop, but the condition can still be false and exit to cont_block
+    if (!has_ret) {
         LLVMBuildBr(compiler->builder, cond_block);
-        LLVMAppendExistingBasicBlock(current_function, cont_block);
-        LLVMPositionBuilderAtEnd(compiler->builder, cont_block);
+        ssa_add_predecessor(cond, compiler->block);
     }
 
-    return ret;
+    ssa_seal_block(compiler, cond);
+
+    LLVMAppendExistingBasicBlock(current_function, cont_block);
+    ssa_enter_block(compiler, cont);
+
+    return make_typed_value(compiler->void_type, branch);
 }
@@ -7,6 +7,6 @@
 
 #include "../types.h"
 
-typed_value_t *compile_while(compiler_t *compiler, while_stmt_data_t *data);
+typed_value_t compile_while(compiler_t *compiler, while_stmt_data_t *data);
 
 #endif //PASTEL_LOOP_H
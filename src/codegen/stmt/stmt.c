@@ -11,7 +11,7 @@
 
 #include <stdio.h>
 
-typed_value_t *compile_stmt(compiler_t *compiler, stmt_t *stmt) {
+typed_value_t compile_stmt(compiler_t *compiler, stmt_t *stmt) {
     switch (stmt->stmt_type) {
         case STMT_RETURN:
             return compile_return(compiler, ((return_stmt_t *) stmt)->value);
@@ -19,15 +19,17 @@ typed_value_t *compile_stmt(compiler_t *compiler, stmt_t *stmt) {
             return compile_expr(compiler, ((expr_stmt_t *) stmt)->expr, 1);
         case STMT_ASSIGNMENT:
             return compile_assignment(compiler, ((assignment_stmt_t *) stmt)->data);
+        case STMT_DECLARATION:
+            return compile_declaration(compiler, ((declaration_stmt_t *) stmt)->data);
         case STMT_WHILE:
             return compile_while(compiler, ((while_stmt_t *) stmt)->data);
         case STMT_FUNCTION:
-            wprintf(L"Functions are only allowed as top level statements!\n");
-            return NULL;
         case STMT_EXTERN:
-            wprintf(L"Extern declarations are only allowed as top level statements!\n");
-            return NULL;
+            // Rejected by the checker
+            break;
     }
+
+    return make_typed_value(NULL, NULL);
 }
 
 function_t *compile_top_level_statement(compiler_t *compiler, stmt_t *stmt) {
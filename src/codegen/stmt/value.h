@@ -7,7 +7,8 @@
 
 #include "../types.h"
 
-typed_value_t *compile_return(compiler_t *compiler, expr_t *value_expr);
-typed_value_t *compile_assignment(compiler_t *compiler, assignment_stmt_data_t *data);
+typed_value_t compile_return(compiler_t *compiler, expr_t *value_expr);
+typed_value_t compile_assignment(compiler_t *compiler, assignment_stmt_data_t *data);
+typed_value_t compile_declaration(compiler_t *compiler, declaration_stmt_data_t *data);
 
 #endif //PASTEL_VALUE_H
@@ -7,8 +7,7 @@
 
 #include "codegen/compiler.h"
 #include "parser/ast.h"
-
-#include <wchar.h>
+#include "../util/ptr_map.h"
 
 #include <llvm-c/Types.h>
 
@@ -28,32 +27,49 @@ typedef struct type_metadata_t {
 } type_metadata_t;
 
 struct type_t {
-    wchar_t *name;
+    char *name;
     LLVMTypeRef llvm_type;
     type_flags_t flags;
     int size; // Size in bytes
     type_metadata_t *metadata;
 };
 
+// Passed and returned by value, lowering an expression allocates nothing but the LLVM instructions.
 typedef struct typed_value_t {
     type_t *type;
     LLVMValueRef value;
 } typed_value_t;
 
+static inline typed_value_t make_typed_value(type_t *type, LLVMValueRef value) {
+    typed_value_t typed_value;
+    typed_value.type = type;
+    typed_value.value = value;
+    return typed_value;
+}
+
 typedef struct variable_t {
-    wchar_t *name;
+    char *name;
     type_t *type;
-    LLVMValueRef value;
+    LLVMValueRef value; // Only for parameters, the values of locals are tracked per block, see ssa.h
     variable_flags_t flags;
 } variable_t;
 
+// A basic block of the function being compiled, with what building SSA form needs to know about it. See ssa.h.
+typedef struct ssa_block_t {
+    LLVMBasicBlockRef block;
+    ptr_list_t *predecessors; // List<ssa_block_t *>
+    LLVMValueRef *definitions; // By slot, the value each variable has at the end of the block so far, or NULL
+    LLVMValueRef *incomplete_phis; // By slot, phis added before the block was sealed, their operands are still missing
+    int is_sealed; // All predecessors have been added
+} ssa_block_t;
+
 typedef struct annotated_typed_arg_t {
-    wchar_t *name;
+    char *name;
     type_t *type;
 } annotated_typed_arg_t;
 
 typedef struct annotated_prototype_t {
-    wchar_t *name;
+    char *name;
     type_t *return_type;
     ptr_list_t *arguments; // List<annotated_typed_arg_t *>
     int is_extern;
@@ -63,6 +79,10 @@ typedef struct function_t {
     annotated_prototype_t  *prototype;
     LLVMTypeRef type;
     LLVMValueRef function;
+
+    // When compiling lazily, the definition of a function that is declared but whose body isn't compiled yet
+    function_stmt_t *pending_definition;
+    int is_queued;
 } function_t;
 
 struct compiler_t {
@@ -70,10 +90,26 @@ struct compiler_t {
     LLVMContextRef context;
     LLVMBuilderRef builder;
 
-    ptr_list_t *variables;
-    ptr_list_t *functions;
+    ptr_list_t *variables; // List<variable_t *> of the function being compiled, indexed by slot, see resolver.h
+    ptr_list_t *functions; // List<function_t *>, owns and orders them
+    ptr_map_t *functions_by_name;
     ptr_list_t *top_level_statements;
-    ptr_list_t *types;
+    ptr_map_t *types; // Map<char *, type_t *>
+
+    ptr_list_t *worklist; // List<function_t *> of functions to compile when compiling lazily, otherwise NULL
+
+    // Scratch space of compile_expr, reused by every expression
+    chain_walker_t walker;
+    ptr_list_t *values; // List<LLVMValueRef> of the operands and call arguments compiled so far, see also ssa.c
+
+    arena_t *arena; // AST nodes and lists the optimizer adds, see optimizer.h
+
+    // SSA construction state of the function being compiled, see ssa.h
+    arena_t *ssa_arena; // Its blocks, reset when the function is done
+    ssa_block_t *block; // The block the builder appends to
+    ptr_map_t *blocks_by_ref; // Map<LLVMBasicBlockRef, ssa_block_t *>
+    ptr_map_t *replaced_phis; // Map<LLVMValueRef, LLVMValueRef> from trivial phis to the value that replaced them
+    ptr_list_t *removed_phis; // List<LLVMValueRef> of trivial phis, erased when the function is done if unused
 
     type_t *void_type;
     type_t *bool_type;
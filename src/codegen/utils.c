@@ -9,16 +9,7 @@
 
 #include <llvm-c/Core.h>
 
-static char wcstombs_buffer[512];
-char *to_mbs(const wchar_t *str) {
-    if (wcstombs(wcstombs_buffer, str, 512) == 512) {
-        wcstombs_buffer[511] = 0;
-    }
-
-    return wcstombs_buffer;
-}
-
-type_t *create_type(wchar_t *name, LLVMTypeRef llvm_type, type_flags_t flags, int size) {
+type_t *create_type(char *name, LLVMTypeRef llvm_type, type_flags_t flags, int size) {
     type_t *type = malloc_s(type_t);
     type->name = name;
     type->llvm_type = llvm_type;
@@ -34,38 +25,29 @@ type_metadata_t *create_type_metadata(type_t *inner_type) {
     return metadata;
 }
 
-type_t *find_type(compiler_t *compiler, const wchar_t *name) {
+type_t *find_type(compiler_t *compiler, const char *name) {
     if (name == NULL) return compiler->void_type;
 
-    size_t i;
-    for (i = 0; i < ptr_list_size(compiler->types); i++) {
-        type_t *type = (type_t *) ptr_list_at(compiler->types, i);
-        if (!wcscmp(name, type->name)) return type;
-    }
-
-    return NULL;
+    return (type_t *) ptr_map_get(compiler->types, name);
 }
 
-variable_t *find_variable(compiler_t *compiler, const wchar_t *name) {
-    if (name == NULL) return NULL;
+variable_t *find_variable(compiler_t *compiler, size_t slot) {
+    return (variable_t *) ptr_list_at(compiler->variables, slot);
+}
 
+void clear_variables(compiler_t *compiler) {
     size_t i;
     for (i = 0; i < ptr_list_size(compiler->variables); i++) {
-        variable_t *variable = (variable_t *) ptr_list_at(compiler->variables, i);
-        if (!wcscmp(name, variable->name)) return variable;
+        free(ptr_list_at_unchecked(compiler->variables, i));
     }
 
-    return NULL;
+    ptr_list_clear(compiler->variables);
 }
 
-function_t *find_function_by_name(compiler_t *compiler, const wchar_t *name) {
-    size_t i;
-    for (i = 0; i < ptr_list_size(compiler->functions); i++) {
-        function_t *function = (function_t *) ptr_list_at(compiler->functions, i);
-        if (!wcscmp(name, function->prototype->name)) return function;
-    }
+function_t *find_function_by_name(compiler_t *compiler, const char *name) {
+    if (name == NULL) return NULL;
 
-    return NULL;
+    return (function_t *) ptr_map_get(compiler->functions_by_name, name);
 }
 
 annotated_prototype_t *annotate_prototype(compiler_t *compiler, prototype_t *prototype) {
@@ -81,7 +63,7 @@ annotated_prototype_t *annotate_prototype(compiler_t *compiler, prototype_t *pro
         type_t *arg_type = find_type(compiler, typed_arg->type);
 
         if (arg_type == NULL) {
-            fprintf(stderr, "Unknown type %ls\n", typed_arg->type);
+            fprintf(stderr, "Unknown type %s\n", typed_arg->type);
             return NULL;
         }
 
@@ -94,7 +76,7 @@ annotated_prototype_t *annotate_prototype(compiler_t *compiler, prototype_t *pro
 
     annotated_prototype->return_type = find_type(compiler, prototype->return_type);
     if (annotated_prototype->return_type == NULL) {
-        fprintf(stderr, "Unknown type %ls\n", prototype->return_type);
+        fprintf(stderr, "Unknown type %s\n", prototype->return_type);
         return NULL;
     }
 
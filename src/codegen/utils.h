@@ -7,16 +7,20 @@
 
 #include "types.h"
 #include "../util/util.h"
+#include "../util/intern.h"
 
 #include <stdlib.h>
-#include <wchar.h>
 
-char *to_mbs(const wchar_t *str);
+// All names have to be interned, lookups hash and compare them by pointer.
+type_t *create_type(char *name, LLVMTypeRef llvm_type, type_flags_t flags, int size);
+type_t *find_type(compiler_t *compiler, const char *name);
+function_t *find_function_by_name(compiler_t *compiler, const char *name);
 
-type_t *create_type(wchar_t *name, LLVMTypeRef llvm_type, type_flags_t flags, int size);
-type_t *find_type(compiler_t *compiler, const wchar_t *name);
-variable_t *find_variable(compiler_t *compiler, const wchar_t *name);
-function_t *find_function_by_name(compiler_t *compiler, const wchar_t *name);
+// Variables of the function being compiled, by the slot the resolver assigned. NULL for SLOT_NONE.
+variable_t *find_variable(compiler_t *compiler, size_t slot);
+
+// Frees the variables of the last function, before the next one adds its own.
+void clear_variables(compiler_t *compiler);
 
 annotated_prototype_t *annotate_prototype(compiler_t *compiler, prototype_t *prototype);
 LLVMTypeRef get_function_type(annotated_prototype_t *prototype);
@@ -4,218 +4,363 @@
 
 #include "lexer/lexer.h"
 #include "lexer/token.h"
+#include "scan.h"
+#include "../util/intern.h"
+#include "../util/ptr_list.h"
+#include "../util/thread_pool.h"
 
 #include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
 #include <stdbool.h>
-#include <wchar.h>
-#include <wctype.h>
+#include <string.h>
 
 struct lexer_t {
-    const wchar_t *input;
+    const char *input;
     size_t size;
     size_t position;
-    token_pos_t current_token_pos;
-    ptr_list_t *lexed_tokens;
+    token_stream_t *tokens;
+    int is_streaming;
     int done;
 };
 
-typedef struct keyword_type_t {
-    const wchar_t *str;
-    keyword_t value;
-} keyword_type_t;
-
-static keyword_type_t keywords[] = {
-        { L"func", KEYWORD_FUNCTION },
-        { L"if", KEYWORD_IF },
-        { L"else", KEYWORD_ELSE },
-        { L"for", KEYWORD_FOR },
-        { L"let", KEYWORD_LET },
-        { L"var", KEYWORD_VAR },
-        { L"true", KEYWORD_TRUE },
-        { L"false", KEYWORD_FALSE },
-        { L"return", KEYWORD_RETURN },
-        { L"extern", KEYWORD_EXTERN },
-        { L"while", KEYWORD_WHILE },
+typedef struct word_type_t {
+    const char *str;
+    size_t length;
+    token_type_t token_type; // TOKEN_KEYWORD or TOKEN_OPERATOR
+    int value; // keyword_t or operator_t
+} word_type_t;
+
+// Keywords and word operators.
+static word_type_t words[] = {
+        { "func", 4, TOKEN_KEYWORD, KEYWORD_FUNCTION },
+        { "if", 2, TOKEN_KEYWORD, KEYWORD_IF },
+        { "else", 4, TOKEN_KEYWORD, KEYWORD_ELSE },
+        { "for", 3, TOKEN_KEYWORD, KEYWORD_FOR },
+        { "let", 3, TOKEN_KEYWORD, KEYWORD_LET },
+        { "var", 3, TOKEN_KEYWORD, KEYWORD_VAR },
+        { "true", 4, TOKEN_KEYWORD, KEYWORD_TRUE },
+        { "false", 5, TOKEN_KEYWORD, KEYWORD_FALSE },
+        { "return", 6, TOKEN_KEYWORD, KEYWORD_RETURN },
+        { "extern", 6, TOKEN_KEYWORD, KEYWORD_EXTERN },
+        { "while", 5, TOKEN_KEYWORD, KEYWORD_WHILE },
+        { "to", 2, TOKEN_OPERATOR, OPERATOR_CAST },
 };
 
-static size_t keyword_count = sizeof(keywords) / sizeof(keyword_type_t);
-
-static wchar_t *operators[] = {
-        L"==",
-        L"!=",
-        L"<",
-        L"<=",
-        L">",
-        L">=",
-        L"+",
-        L"-",
-        L"*",
-        L"/",
-        L"to",
-        L"!",
+#define WORD_HASH_SIZE 32
+#define word_hash(start, length) \
+    (((length) + (unsigned char) (start)[0] + (unsigned char) (start)[(length) - 1]) & (WORD_HASH_SIZE - 1))
+
+/*
+ * Perfect hash over words[]: word_slots[word_hash(word)] is the index of the only entry that can match, or -1.
+ * If you add a word, regenerate this and make sure nothing collides.
+ */
+static const signed char word_slots[WORD_HASH_SIZE] = {
+        -1, 10, -1, 4, -1, 11, 8, -1, -1, -1, -1, 5, -1, 0, 2, -1,
+        7, 1, -1, -1, -1, -1, -1, -1, -1, 9, -1, 3, -1, 6, -1, -1,
 };
 
-static size_t operator_count = sizeof(operators) / sizeof(wchar_t *);
+#define CHAR_BLANK 0x01
+#define CHAR_END_OF_STATEMENT 0x02
+#define CHAR_ALPHA 0x04
+#define CHAR_DIGIT 0x08
+#define CHAR_IDENTIFIER 0x10
+
+static const unsigned char char_classes[256] = {
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x00, 0x00, 0x02, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14,
+        0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x00, 0x00, 0x00, 0x00, 0x10,
+        0x00, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14,
+        0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+
+#define has_class(c, class) ((char_classes[(unsigned char) (c)] & (class)) != 0)
+
+/*
+ * Symbolic operators are recognized by a DFA. Every state except OP_STATE_NONE accepts, so lexing an operator just
+ * follows transitions until there is none and emits what it has. Characters are first mapped to one of the
+ * operator classes below, everything else is class 0 and never has a transition. The operator a state accepts is
+ * state - 1, see operator_t.
+ */
+typedef enum operator_state_t {
+    OP_STATE_NONE,
+    OP_STATE_ASSIGN,
+    OP_STATE_NOT,
+    OP_STATE_LT,
+    OP_STATE_GT,
+    OP_STATE_PLUS,
+    OP_STATE_MINUS,
+    OP_STATE_STAR,
+    OP_STATE_SLASH,
+    OP_STATE_EQ,
+    OP_STATE_NE,
+    OP_STATE_LE,
+    OP_STATE_GE,
+    OP_STATE_COUNT,
+} operator_state_t;
+
+#define OP_CLASS_COUNT 9
+
+// 1 to 8 are '=', '!', '<', '>', '+', '-', '*' and '/'.
+static const unsigned char operator_classes[256] = {
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 7, 5, 0, 6, 0, 8,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 3, 1, 4, 0,
+};
+
+static const unsigned char operator_transitions[OP_STATE_COUNT][OP_CLASS_COUNT] = {
+        //               =             !             <            >            +             -              *             /
+        { OP_STATE_NONE, OP_STATE_ASSIGN, OP_STATE_NOT, OP_STATE_LT, OP_STATE_GT, OP_STATE_PLUS, OP_STATE_MINUS, OP_STATE_STAR, OP_STATE_SLASH },
+        { OP_STATE_NONE, OP_STATE_EQ }, // =
+        { OP_STATE_NONE, OP_STATE_NE }, // !
+        { OP_STATE_NONE, OP_STATE_LE }, // <
+        { OP_STATE_NONE, OP_STATE_GE }, // >
+};
 
 #define is_eof() (lexer->size == lexer->position)
 #define current_char() (lexer->input[lexer->position])
 #define next_char() (lexer->input[lexer->position + 1])
-#define advance()   do { \
-                        lexer->current_token_pos.column++; \
-                        if (current_char() == '\n') { \
-                            lexer->current_token_pos.column = 0; \
-                            lexer->current_token_pos.line++; \
-                        } \
-                        lexer->position++; \
-                    } while (0)
+#define advance() (lexer->position++)
+#define advance_by(n) (lexer->position += (n))
 
 static void skip_whitespace(lexer_t *lexer) {
-    while (true) {
-        if (is_eof()) return;
-
-        wchar_t c = current_char();
-        if (!iswblank(c)) return;
-
-        advance();
-    }
+    advance_by(scan_blank(&current_char()));
 }
 
 static void skip_until_newline(lexer_t *lexer) {
     while (true) {
+        advance_by(scan_line(&current_char()));
         if (is_eof()) return;
 
-        wchar_t ch = current_char();
-        if (ch == L'\r') {
+        char ch = current_char();
+        if (ch == '\r') {
             advance();
 
             ch = current_char();
-            if (ch == L'\n') advance();
+            if (ch == '\n') advance();
 
             return;
         }
 
-        if (ch == L'\n') {
+        if (ch == '\n') {
             advance();
             return;
         }
 
+        // A null byte inside of the comment, keep going.
         advance();
     }
 }
 
-static token_operator_t *get_operator(const wchar_t *start, size_t length, token_pos_t token_pos) {
-    size_t i;
-    for (i = 0; i < operator_count; i++) {
-        if (!wcsncmp(operators[i], start, length)) {
-            return token_new_operator(start, length, token_pos);
-        }
+// Pushes the token for a keyword or word operator, returns 0 if the identifier isn't one.
+static int lex_word(lexer_t *lexer, size_t offset, size_t length) {
+    const char *start = lexer->input + offset;
+
+    int slot = word_slots[word_hash(start, length)];
+    if (slot < 0) return 0;
+
+    word_type_t *word = &words[slot];
+    if (word->length != length || memcmp(word->str, start, length) != 0) return 0;
+
+    size_t i = token_stream_push(lexer->tokens, word->token_type, offset, length);
+    if (word->token_type == TOKEN_KEYWORD) {
+        lexer->tokens->values[i].keyword = (keyword_t) word->value;
+    } else {
+        lexer->tokens->values[i].op = (operator_t) word->value;
     }
 
-    return NULL;
+    return 1;
 }
 
-#define max(a, b) (a > b ? a : b)
+static void lex_identifier(lexer_t *lexer) {
+    size_t offset = lexer->position;
+    size_t length = scan_identifier(&current_char());
+    advance_by(length);
 
-static token_keyword_t *get_keyword(const wchar_t *start, size_t length, token_pos_t token_pos) {
-    size_t i;
-    for (i = 0; i < keyword_count; i++) {
-        keyword_type_t *type = &keywords[i];
-
-        if (!wcsncmp(type->str, start, max(length, wcslen(type->str)))) {
-            return token_new_keyword(type->value, token_pos);
-        }
-    }
+    if (lex_word(lexer, offset, length)) return;
 
-    return NULL;
+    size_t i = token_stream_push(lexer->tokens, TOKEN_IDENTIFIER, offset, length);
+    lexer->tokens->values[i].name = intern_bytes(lexer->input + offset, length);
 }
 
-static token_t *lex_identifier(lexer_t *lexer) {
-    const wchar_t *start = &current_char();
-    size_t length = 0;
+// Every power of ten up to 1e22 is exact as a double.
+static const double exact_powers_of_ten[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
 
-    do {
-        length++;
-        advance();
-    } while (iswalnum(current_char()) || current_char() == L'_');
+#define MAX_EXACT_POWER_OF_TEN 22
+#define MAX_EXACT_MANTISSA ((uint64_t) 1 << 53)
+
+// Digits of a number literal, as scanned in a single pass.
+typedef struct number_literal_t {
+    uint64_t mantissa;
+    int exponent; // Power of ten the mantissa is scaled by
+    int is_negative;
+    int is_float;
+    int is_truncated; // Some digits didn't fit into the mantissa
+} number_literal_t;
+
+static int push_digit(number_literal_t *literal, char c) {
+    uint64_t digit = (uint64_t) (c - '0');
+    if (literal->mantissa > (UINT64_MAX - digit) / 10) {
+        literal->is_truncated = true;
+        return 0;
+    }
 
-    token_pos_t pos = lexer->current_token_pos;
-    pos.column -= length;
+    literal->mantissa = literal->mantissa * 10 + digit;
+    return 1;
+}
 
-    token_keyword_t *keyword_token = get_keyword(start, length, pos);
-    if (keyword_token != NULL) {
-        return (token_t *) keyword_token;
+/*
+ * A mantissa and power of ten that are both exact doubles give a correctly rounded result with a single multiply or
+ * divide (Clinger's fast path). That covers nearly every literal in real code, everything else goes to strtod.
+ */
+static double number_literal_to_double(number_literal_t *literal, const char *start) {
+    if (literal->is_truncated || literal->mantissa > MAX_EXACT_MANTISSA
+        || literal->exponent < -MAX_EXACT_POWER_OF_TEN || literal->exponent > MAX_EXACT_POWER_OF_TEN) {
+        return strtod(start, NULL);
     }
 
-    token_operator_t *operator_token = get_operator(start, length, pos);
-    if (operator_token != NULL) {
-        return (token_t *) operator_token;
+    double value = (double) literal->mantissa;
+    if (literal->exponent < 0) {
+        value /= exact_powers_of_ten[-literal->exponent];
+    } else {
+        value *= exact_powers_of_ten[literal->exponent];
     }
 
-    return (token_t *) token_new_identifier(start, length, pos);
+    return literal->is_negative ? -value : value;
 }
 
-static token_t *lex_number(lexer_t *lexer) {
-    token_pos_t pos = lexer->current_token_pos;
-    const wchar_t *start = lexer->input + lexer->position;
-    wchar_t *end;
-    int int_value = (int) wcstol(start, &end, 10);
+// Consumes e, e+ or e- followed by digits. A lone e is left alone, it starts an identifier.
+static void lex_exponent(lexer_t *lexer, number_literal_t *literal) {
+    size_t sign_length = (next_char() == '+' || next_char() == '-') ? 1 : 0;
+    if (!has_class(lexer->input[lexer->position + 1 + sign_length], CHAR_DIGIT)) return;
 
-    size_t offset = end - start;
-    lexer->position += offset;
+    int is_negative = next_char() == '-';
+    advance_by(1 + sign_length);
 
-    if (current_char() != L'.') {
-        lexer->current_token_pos.column += offset;
-        return (token_t *) token_new_integer(int_value, pos);
+    int exponent = 0;
+    while (has_class(current_char(), CHAR_DIGIT)) {
+        // Anything this large over- or underflows anyway, strtod sorts it out
+        if (exponent < 100000) exponent = exponent * 10 + (current_char() - '0');
+        advance();
     }
 
-    lexer->position -= offset; // Rewind to the start of the number
-    double double_value = wcstod(start, &end);
+    literal->exponent += is_negative ? -exponent : exponent;
+    literal->is_float = true;
+}
+
+/*
+ * Consumes a type suffix if there is one that fits the literal and returns it, SUFFIX_NONE otherwise. Integers with a
+ * float suffix become floats.
+ */
+static number_suffix_t lex_number_suffix(lexer_t *lexer, number_literal_t *literal) {
+    if (!has_class(current_char(), CHAR_ALPHA)) return SUFFIX_NONE;
 
-    offset = end - start;
-    lexer->position += offset;
-    lexer->current_token_pos.column += offset;
+    size_t length = scan_identifier(&current_char());
+    number_suffix_t suffix = number_suffix_from_spelling(&current_char(), length);
+    if (suffix == SUFFIX_NONE || (literal->is_float && !is_float_suffix(suffix))) return SUFFIX_NONE;
 
-    return (token_t *) token_new_float(double_value, pos);
+    if (is_float_suffix(suffix)) literal->is_float = true;
+    advance_by(length);
+    return suffix;
 }
 
-static int is_operator_starting(lexer_t *lexer) {
-    size_t i;
-    for (i = 0; i < operator_count; i++) {
-        if (current_char() == *operators[i]) return 1;
-    }
+/*
+ * Integer literals have to fit Int64, or UInt64 with the u64 suffix, so the value of a token is never ambiguous. The
+ * checker tests narrower suffixes against their type.
+ */
+static int is_valid_integer(number_literal_t *literal, number_suffix_t suffix) {
+    if (literal->is_truncated) return 0;
+    if (suffix == SUFFIX_U64) return !literal->is_negative || literal->mantissa == 0;
 
-    return 0;
+    return literal->mantissa <= (literal->is_negative ? (uint64_t) INT64_MAX + 1 : (uint64_t) INT64_MAX);
 }
 
-static token_t *lex_operator(lexer_t *lexer) {
-    const wchar_t *start = &current_char();
-    size_t length = 1;
+static void lex_number(lexer_t *lexer) {
+    size_t offset = lexer->position;
+    number_literal_t literal = { 0, 0, false, false, false };
 
-    while (true) {
-        bool found = false;
-        size_t i;
-
-        for (i = 0; i < operator_count; i++) {
-            if (!wcsncmp(start, operators[i], length)) {
-                advance();
-                length++;
-                found = true;
-                break;
-            }
+    if (current_char() == '-') {
+        literal.is_negative = true;
+        advance();
+    }
+
+    while (has_class(current_char(), CHAR_DIGIT)) {
+        // Digits that don't fit only scale the value from here on
+        if (literal.is_truncated || !push_digit(&literal, current_char())) literal.exponent++;
+        advance();
+    }
+
+    if (current_char() == '.') {
+        literal.is_float = true;
+        advance();
+
+        while (has_class(current_char(), CHAR_DIGIT)) {
+            if (!literal.is_truncated && push_digit(&literal, current_char())) literal.exponent--;
+            advance();
         }
+    }
 
-        if (!found) break;
+    if (current_char() == 'e' || current_char() == 'E') {
+        lex_exponent(lexer, &literal);
     }
 
-    length--;
+    number_suffix_t suffix = lex_number_suffix(lexer, &literal);
+
+    size_t length = lexer->position - offset;
 
-    return (token_t *) token_new_operator(start, length, lexer->current_token_pos);
+    if (literal.is_float) {
+        size_t i = token_stream_push(lexer->tokens, TOKEN_FLOAT, offset, length);
+        lexer->tokens->values[i].floating = number_literal_to_double(&literal, lexer->input + offset);
+        return;
+    }
+
+    if (!is_valid_integer(&literal, suffix)) {
+        token_stream_push(lexer->tokens, TOKEN_INVALID_INTEGER, offset, length);
+        return;
+    }
+
+    size_t i = token_stream_push(lexer->tokens, TOKEN_INTEGER, offset, length);
+    lexer->tokens->values[i].integer = (int64_t) (literal.is_negative ? 0 - literal.mantissa : literal.mantissa);
 }
 
-static int is_end_of_statement(lexer_t *lexer) {
-    wchar_t c = current_char();
+static int is_operator_starting(lexer_t *lexer) {
+    return operator_classes[(unsigned char) current_char()] != 0;
+}
+
+static void lex_operator(lexer_t *lexer) {
+    size_t offset = lexer->position;
+    operator_state_t state = OP_STATE_NONE;
+
+    while (true) {
+        operator_state_t next = operator_transitions[state][operator_classes[(unsigned char) current_char()]];
+        if (next == OP_STATE_NONE) break;
 
-    return (c == L'\r' || c == L'\n' || c == L';');
+        state = next;
+        advance();
+    }
+
+    size_t length = lexer->position - offset;
+    size_t i = token_stream_push(lexer->tokens, TOKEN_OPERATOR, offset, length);
+    lexer->tokens->values[i].op = (operator_t) (state - 1);
+}
+
+static int is_end_of_statement(lexer_t *lexer) {
+    return has_class(current_char(), CHAR_END_OF_STATEMENT);
 }
 
 static void skip_consecutive_end_of_statements(lexer_t *lexer) {
@@ -229,65 +374,212 @@ static void lex_next(lexer_t *lexer) {
     if (is_eof()) return;
 
     // Comments
-    if ((current_char() == L'/') && (next_char() == L'/')) {
+    if ((current_char() == '/') && (next_char() == '/')) {
         skip_until_newline(lexer);
         return;
     }
 
     if (is_end_of_statement(lexer)) {
+        size_t offset = lexer->position;
         skip_consecutive_end_of_statements(lexer);
-        token_t *token = token_new(TOKEN_END_OF_STATEMENT, lexer->current_token_pos);
-        ptr_list_push(lexer->lexed_tokens, token);
+        token_stream_push(lexer->tokens, TOKEN_END_OF_STATEMENT, offset, lexer->position - offset);
         return;
     }
 
-    if (iswalpha(current_char())) {
-        token_t *token = lex_identifier(lexer);
-        ptr_list_push(lexer->lexed_tokens, token);
+    if (has_class(current_char(), CHAR_ALPHA)) {
+        lex_identifier(lexer);
         return;
     }
 
-    if (iswdigit(current_char()) || ((current_char() == L'-') && (iswdigit(next_char())))) {
-        token_t *token = lex_number(lexer);
-        ptr_list_push(lexer->lexed_tokens, token);
+    if (has_class(current_char(), CHAR_DIGIT) || ((current_char() == '-') && has_class(next_char(), CHAR_DIGIT))) {
+        lex_number(lexer);
         return;
     }
 
     if (is_operator_starting(lexer)) {
-        token_t *token = lex_operator(lexer);
-        ptr_list_push(lexer->lexed_tokens, token);
+        lex_operator(lexer);
         return;
     }
 
-    token_t *token = (token_t *) token_new_char(current_char(), lexer->current_token_pos);
-    ptr_list_push(lexer->lexed_tokens, token);
+    size_t i = token_stream_push(lexer->tokens, TOKEN_CHAR, lexer->position, 1);
+    lexer->tokens->values[i].character = (unsigned char) current_char();
     advance();
 }
 
-lexer_t *lexer_new(const wchar_t *input, size_t size) {
+static lexer_t *create_lexer(const char *input, size_t size, token_stream_t *tokens, int is_streaming) {
+    scan_init();
+
     lexer_t *lexer = (lexer_t *) malloc(sizeof(lexer_t));
 
     lexer->input = input;
     lexer->size = size;
     lexer->position = 0;
-    lexer->lexed_tokens = ptr_list_new();
+    lexer->tokens = tokens;
+    lexer->is_streaming = is_streaming;
     lexer->done = false;
-    lexer->current_token_pos.line = 1;
-    lexer->current_token_pos.column = 1;
 
     return lexer;
 }
 
+// Token offsets are 32 bits.
+static int is_size_supported(size_t size) {
+    if (size <= UINT32_MAX) return 1;
+
+    fprintf(stderr, "Sources larger than 4 GiB aren't supported!\n");
+    return 0;
+}
+
+lexer_t *lexer_new(const char *input, size_t size) {
+    if (!is_size_supported(size)) return NULL;
+
+    // Rough guess so that the stream rarely has to grow, typical sources have a token every few bytes.
+    return create_lexer(input, size, token_stream_new(input, size / 4 + 16), false);
+}
+
+lexer_t *lexer_new_streaming(const char *input, size_t size) {
+    if (!is_size_supported(size)) return NULL;
+
+    return create_lexer(input, size, token_stream_new_window(input, LEXER_WINDOW_SIZE), true);
+}
+
+void lexer_free(lexer_t *lexer) {
+    if (lexer->is_streaming) {
+        token_stream_free(lexer->tokens);
+    }
+
+    free(lexer);
+}
+
 void lexer_lex_all(lexer_t *lexer) {
     while (!is_eof()) {
         lex_next(lexer);
     }
 
+    token_stream_push(lexer->tokens, TOKEN_NULL, lexer->position, 0);
     lexer->done = true;
 }
 
-ptr_list_t *lexer_get_tokens(lexer_t *lexer) {
-    if (!lexer->done) return NULL;
+/*
+ * Parallel lexing splits the input into chunks that each start a line with a top level func or extern. No token or
+ * comment spans a newline, so lexing the chunks on their own gives exactly the tokens of the whole input.
+ */
+
+#define PARALLEL_MIN_CHUNK_SIZE (64 * 1024)
+#define PARALLEL_CHUNKS_PER_THREAD 4 // Evens out chunks that happen to be slower
+
+typedef struct lex_chunk_t {
+    const char *input;
+    size_t start;
+    size_t end;
+    token_stream_t *tokens;
+} lex_chunk_t;
+
+static int starts_with_word(const char *p, const char *word, size_t length) {
+    return strncmp(p, word, length) == 0 && !has_class(p[length], CHAR_IDENTIFIER);
+}
+
+static int is_top_level_start(const char *p) {
+    return starts_with_word(p, "func", 4) || starts_with_word(p, "extern", 6);
+}
+
+// First split point at or after offset, or size if there is none.
+static size_t find_split(const char *input, size_t size, size_t offset) {
+    while (offset < size) {
+        const char *newline = (const char *) memchr(input + offset, '\n', size - offset);
+        if (newline == NULL) return size;
+
+        offset = newline - input + 1;
+        if (is_top_level_start(input + offset)) return offset;
+    }
+
+    return size;
+}
+
+token_stream_t *lexer_lex_range(const char *input, size_t start, size_t end) {
+    if (!is_size_supported(end)) return NULL;
+
+    size_t capacity = (end - start) / 4 + 16;
+
+    // The lexer sees the whole input but stops at the end of the range, so token offsets need no fixing up
+    lexer_t *lexer = create_lexer(input, end, token_stream_new(input, capacity), false);
+    lexer->position = start;
+
+    while (!is_eof()) {
+        lex_next(lexer);
+    }
+
+    token_stream_t *tokens = lexer->tokens;
+    free(lexer);
+
+    return tokens;
+}
+
+static void lex_chunk(void *arg) {
+    lex_chunk_t *chunk = (lex_chunk_t *) arg;
+    chunk->tokens = lexer_lex_range(chunk->input, chunk->start, chunk->end);
+}
+
+token_stream_t *lexer_lex_parallel(const char *input, size_t size, thread_pool_t *pool) {
+    if (!is_size_supported(size)) return NULL;
+
+    scan_init(); // Before the workers race to do it
+
+    size_t chunk_target = size / (thread_pool_size(pool) * PARALLEL_CHUNKS_PER_THREAD) + 1;
+    if (chunk_target < PARALLEL_MIN_CHUNK_SIZE) chunk_target = PARALLEL_MIN_CHUNK_SIZE;
+
+    ptr_list_t *chunks = ptr_list_new();
+    size_t start = 0;
+    while (start < size) {
+        lex_chunk_t *chunk = (lex_chunk_t *) malloc(sizeof(lex_chunk_t));
+        chunk->input = input;
+        chunk->start = start;
+        chunk->end = start + chunk_target >= size ? size : find_split(input, size, start + chunk_target);
+        chunk->tokens = NULL;
+
+        ptr_list_push(chunks, chunk);
+        thread_pool_submit(pool, lex_chunk, chunk);
+        start = chunk->end;
+    }
+
+    thread_pool_wait(pool);
+
+    size_t count = ptr_list_size(chunks);
+    token_stream_t **parts = (token_stream_t **) malloc((count + 1) * sizeof(token_stream_t *));
+
+    size_t i;
+    for (i = 0; i < count; i++) {
+        parts[i] = ((lex_chunk_t *) ptr_list_at_unchecked(chunks, i))->tokens;
+    }
+
+    token_stream_t *tokens = token_stream_concat(input, parts, count, 1);
+    token_stream_push(tokens, TOKEN_NULL, size, 0);
+
+    for (i = 0; i < count; i++) {
+        token_stream_free(parts[i]);
+        free(ptr_list_at_unchecked(chunks, i));
+    }
+    free(parts);
+    ptr_list_free(chunks);
+
+    return tokens;
+}
+
+void lexer_next_token(lexer_t *lexer) {
+    if (lexer->done) return;
+
+    size_t size = lexer->tokens->size;
+    while (!is_eof() && lexer->tokens->size == size) {
+        lex_next(lexer);
+    }
+
+    if (lexer->tokens->size == size) {
+        token_stream_push(lexer->tokens, TOKEN_NULL, lexer->position, 0);
+        lexer->done = true;
+    }
+}
+
+token_stream_t *lexer_get_tokens(lexer_t *lexer) {
+    if (!lexer->done && !lexer->is_streaming) return NULL;
 
-    return lexer->lexed_tokens;
+    return lexer->tokens;
 }
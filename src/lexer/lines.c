@@ -0,0 +1,93 @@
+//
+// Created by sarah on 3/22/24.
+//
+
+#include "lines.h"
+#include "scan.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#define INITIAL_CAPACITY 256
+
+struct line_index_t {
+    const char *input;
+    uint32_t *starts;
+    size_t count;
+    size_t capacity;
+    size_t scanned; // Every newline before this offset is in starts
+};
+
+line_index_t *line_index_new(const char *input) {
+    scan_init();
+
+    line_index_t *index = (line_index_t *) malloc(sizeof(line_index_t));
+    index->input = input;
+    index->starts = (uint32_t *) malloc(INITIAL_CAPACITY * sizeof(uint32_t));
+    index->starts[0] = 0;
+    index->count = 1;
+    index->capacity = INITIAL_CAPACITY;
+    index->scanned = 0;
+
+    return index;
+}
+
+void line_index_free(line_index_t *index) {
+    free(index->starts);
+    free(index);
+}
+
+static void push_line_start(line_index_t *index, size_t offset) {
+    if (index->count == index->capacity) {
+        index->capacity *= 2;
+
+        uint32_t *new_starts = (uint32_t *) realloc(index->starts, index->capacity * sizeof(uint32_t));
+        if (new_starts == NULL) {
+            fprintf(stderr, "Failed to grow line index!\n");
+            exit(1);
+        }
+
+        index->starts = new_starts;
+    }
+
+    index->starts[index->count++] = (uint32_t) offset;
+}
+
+// Uses the vectorized comment scanner to jump from one line break candidate to the next.
+static void scan_until(line_index_t *index, size_t offset) {
+    size_t position = index->scanned;
+
+    while (position <= offset) {
+        position += scan_line(index->input + position);
+
+        char ch = index->input[position++];
+        if (ch == '\n') {
+            push_line_start(index, position);
+        }
+    }
+
+    index->scanned = position;
+}
+
+token_pos_t line_index_position(line_index_t *index, uint32_t offset) {
+    if (offset >= index->scanned) {
+        scan_until(index, offset);
+    }
+
+    // Last line starting at or before offset
+    size_t low = 0;
+    size_t high = index->count;
+    while (high - low > 1) {
+        size_t middle = low + (high - low) / 2;
+        if (index->starts[middle] <= offset) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+
+    token_pos_t pos;
+    pos.line = low + 1;
+    pos.column = offset - index->starts[low] + 1;
+    return pos;
+}
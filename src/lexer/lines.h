@@ -0,0 +1,25 @@
+//
+// Created by sarah on 3/22/24.
+//
+
+#ifndef PASTEL_LINES_H
+#define PASTEL_LINES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lexer/token.h"
+
+/*
+ * Offsets of the line starts in a null-terminated source. The table only covers the source up to the furthest offset
+ * asked for so far and is extended on demand, since it is only needed to report diagnostics.
+ */
+typedef struct line_index_t line_index_t;
+
+line_index_t *line_index_new(const char *input);
+void line_index_free(line_index_t *index);
+
+// 1 based line and column of the byte at offset.
+token_pos_t line_index_position(line_index_t *index, uint32_t offset);
+
+#endif //PASTEL_LINES_H
@@ -0,0 +1,198 @@
+//
+// Created by sarah on 3/18/24.
+//
+
+#include "scan.h"
+
+#include <stdint.h>
+
+typedef size_t (*scan_function_t)(const char *p);
+
+static scan_function_t blank_impl = NULL;
+static scan_function_t identifier_impl = NULL;
+static scan_function_t line_impl = NULL;
+
+/* Scalar fallback */
+
+#define is_blank(c) ((c) == ' ' || (c) == '\t')
+#define is_identifier(c) ( \
+        ((c) >= 'a' && (c) <= 'z') || ((c) >= 'A' && (c) <= 'Z') || ((c) >= '0' && (c) <= '9') || (c) == '_')
+#define is_line_end(c) ((c) == '\n' || (c) == '\r' || (c) == 0)
+
+static size_t scan_blank_scalar(const char *p) {
+    const char *start = p;
+    while (is_blank(*p)) p++;
+    return p - start;
+}
+
+static size_t scan_identifier_scalar(const char *p) {
+    const char *start = p;
+    while (is_identifier(*p)) p++;
+    return p - start;
+}
+
+static size_t scan_line_scalar(const char *p) {
+    const char *start = p;
+    while (!is_line_end(*p)) p++;
+    return p - start;
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_KERNELS
+
+#include <immintrin.h>
+
+/*
+ * Each kernel classifies a whole vector at once, producing a bit mask of the bytes that end the run. The first block
+ * is loaded from the aligned address below p, so the bits for the bytes before p are cleared. After that it's just
+ * aligned loads until a block has a stop byte in it.
+ */
+#define SCAN_LOOP(width, vector_t, load, stop_mask) \
+    do { \
+        uintptr_t misalignment = (uintptr_t) p & ((width) - 1); \
+        const vector_t *block = (const vector_t *) (p - misalignment); \
+        uint32_t mask = stop_mask(load(block)) & (uint32_t) (0xFFFFFFFFu << misalignment); \
+        while (mask == 0) { \
+            block++; \
+            mask = stop_mask(load(block)); \
+        } \
+        return (const char *) block + __builtin_ctz(mask) - p; \
+    } while (0)
+
+/* SSE2 */
+
+__attribute__((target("sse2")))
+static inline __m128i in_range_sse2(__m128i v, char low, char high) {
+    return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8((char) (low - 1))),
+                         _mm_cmplt_epi8(v, _mm_set1_epi8((char) (high + 1))));
+}
+
+__attribute__((target("sse2")))
+static inline uint32_t blank_stops_sse2(__m128i v) {
+    __m128i blank = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+    return ~_mm_movemask_epi8(blank) & 0xFFFF;
+}
+
+__attribute__((target("sse2")))
+static inline uint32_t identifier_stops_sse2(__m128i v) {
+    __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    __m128i identifier = _mm_or_si128(
+            _mm_or_si128(in_range_sse2(lower, 'a', 'z'), in_range_sse2(v, '0', '9')),
+            _mm_cmpeq_epi8(v, _mm_set1_epi8('_'))
+    );
+    return ~_mm_movemask_epi8(identifier) & 0xFFFF;
+}
+
+__attribute__((target("sse2")))
+static inline uint32_t line_stops_sse2(__m128i v) {
+    __m128i end = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))),
+            _mm_cmpeq_epi8(v, _mm_setzero_si128())
+    );
+    return _mm_movemask_epi8(end);
+}
+
+__attribute__((target("sse2")))
+static size_t scan_blank_sse2(const char *p) {
+    SCAN_LOOP(16, __m128i, _mm_load_si128, blank_stops_sse2);
+}
+
+__attribute__((target("sse2")))
+static size_t scan_identifier_sse2(const char *p) {
+    SCAN_LOOP(16, __m128i, _mm_load_si128, identifier_stops_sse2);
+}
+
+__attribute__((target("sse2")))
+static size_t scan_line_sse2(const char *p) {
+    SCAN_LOOP(16, __m128i, _mm_load_si128, line_stops_sse2);
+}
+
+/* AVX2 */
+
+__attribute__((target("avx2")))
+static inline __m256i in_range_avx2(__m256i v, char low, char high) {
+    return _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8((char) (low - 1))),
+                            _mm256_cmpgt_epi8(_mm256_set1_epi8((char) (high + 1)), v));
+}
+
+__attribute__((target("avx2")))
+static inline uint32_t blank_stops_avx2(__m256i v) {
+    __m256i blank = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                                    _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')));
+    return ~(uint32_t) _mm256_movemask_epi8(blank);
+}
+
+__attribute__((target("avx2")))
+static inline uint32_t identifier_stops_avx2(__m256i v) {
+    __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    __m256i identifier = _mm256_or_si256(
+            _mm256_or_si256(in_range_avx2(lower, 'a', 'z'), in_range_avx2(v, '0', '9')),
+            _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_'))
+    );
+    return ~(uint32_t) _mm256_movemask_epi8(identifier);
+}
+
+__attribute__((target("avx2")))
+static inline uint32_t line_stops_avx2(__m256i v) {
+    __m256i end = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')),
+                            _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))),
+            _mm256_cmpeq_epi8(v, _mm256_setzero_si256())
+    );
+    return (uint32_t) _mm256_movemask_epi8(end);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_blank_avx2(const char *p) {
+    SCAN_LOOP(32, __m256i, _mm256_load_si256, blank_stops_avx2);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_identifier_avx2(const char *p) {
+    SCAN_LOOP(32, __m256i, _mm256_load_si256, identifier_stops_avx2);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_line_avx2(const char *p) {
+    SCAN_LOOP(32, __m256i, _mm256_load_si256, line_stops_avx2);
+}
+
+#endif
+
+void scan_init(void) {
+    if (blank_impl != NULL) return;
+
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2")) {
+        identifier_impl = scan_identifier_avx2;
+        line_impl = scan_line_avx2;
+        blank_impl = scan_blank_avx2;
+        return;
+    }
+
+    if (__builtin_cpu_supports("sse2")) {
+        identifier_impl = scan_identifier_sse2;
+        line_impl = scan_line_sse2;
+        blank_impl = scan_blank_sse2;
+        return;
+    }
+#endif
+
+    identifier_impl = scan_identifier_scalar;
+    line_impl = scan_line_scalar;
+    blank_impl = scan_blank_scalar;
+}
+
+size_t scan_blank(const char *p) {
+    return blank_impl(p);
+}
+
+size_t scan_identifier(const char *p) {
+    return identifier_impl(p);
+}
+
+size_t scan_line(const char *p) {
+    return line_impl(p);
+}
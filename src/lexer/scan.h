@@ -0,0 +1,29 @@
+//
+// Created by sarah on 3/18/24.
+//
+
+#ifndef PASTEL_SCAN_H
+#define PASTEL_SCAN_H
+
+#include <stddef.h>
+
+/*
+ * Vectorized scanning kernels for the lexer. All of them take a pointer into null-terminated input and return the
+ * length of the run starting there. None of the runs can contain a newline or a null byte, so they never go past the
+ * end of the input. The SIMD versions only do aligned loads, which can read past the terminator but never into the
+ * next page.
+ */
+
+// Picks the fastest implementation the CPU supports. Has to be called before any of the scan functions.
+void scan_init(void);
+
+// Length of the run of spaces and tabs.
+size_t scan_blank(const char *p);
+
+// Length of the run of identifier characters ([A-Za-z0-9_]).
+size_t scan_identifier(const char *p);
+
+// Length until the next '\r', '\n' or null byte, for skipping the body of a comment.
+size_t scan_line(const char *p);
+
+#endif //PASTEL_SCAN_H
@@ -2,131 +2,255 @@
 // Created by sarah on 3/7/24.
 //
 
-#include <malloc.h>
-#include <wchar.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "lexer/token.h"
+#include "lines.h"
 
-token_t *token_new(token_type_t type, token_pos_t token_pos) {
-    token_t *token = (token_t *) malloc(sizeof(token_t));
+token_stream_t *token_stream_new(const char *input, size_t capacity) {
+    token_stream_t *stream = (token_stream_t *) malloc(sizeof(token_stream_t));
 
-    token->type = type;
-    token->token_pos = token_pos;
+    if (capacity == 0) capacity = 1;
 
-    return token;
-}
+    stream->input = input;
+    stream->types = (unsigned char *) malloc(capacity * sizeof(unsigned char));
+    stream->offsets = (uint32_t *) malloc(capacity * sizeof(uint32_t));
+    stream->lengths = (uint32_t *) malloc(capacity * sizeof(uint32_t));
+    stream->values = (token_value_t *) malloc(capacity * sizeof(token_value_t));
+    stream->lines = NULL;
+    stream->size = 0;
+    stream->capacity = capacity;
+    stream->mask = (size_t) -1;
 
-static token_t *new_string_token(token_type_t type, const wchar_t *start, size_t length, token_pos_t token_pos) {
-    token_t *token = token_new(type, token_pos);
+    return stream;
+}
 
-    token->data = malloc((length + 1) * sizeof(wchar_t));
-    wcsncpy((wchar_t *) token->data, start, length);
-    ((wchar_t *) token->data)[length] = 0;
+token_stream_t *token_stream_new_window(const char *input, size_t capacity) {
+    token_stream_t *stream = token_stream_new(input, capacity);
+    stream->mask = capacity - 1;
 
-    return token;
+    return stream;
 }
 
-token_identifier_t *token_new_identifier(const wchar_t *start, size_t length, token_pos_t token_pos) {
-    return (token_identifier_t *) new_string_token(TOKEN_IDENTIFIER, start, length, token_pos);
+void token_stream_free(token_stream_t *stream) {
+    free(stream->types);
+    free(stream->offsets);
+    free(stream->lengths);
+    free(stream->values);
+    if (stream->lines != NULL) line_index_free(stream->lines);
+    free(stream);
 }
 
-token_integer_t *token_new_integer(int value, token_pos_t token_pos) {
-    token_integer_t *token = (token_integer_t *) token_new(TOKEN_INTEGER, token_pos);
+#define grow_array(array, type, capacity) do { \
+                                              type *new_array = (type *) realloc(array, (capacity) * sizeof(type)); \
+                                              if (new_array == NULL) { \
+                                                  fprintf(stderr, "Failed to grow token stream!\n"); \
+                                                  exit(1); \
+                                              } \
+                                              array = new_array; \
+                                          } while (0)
 
-    token->value = value;
+static void ensure_capacity(token_stream_t *stream) {
+    if (stream->size < stream->capacity) return;
+    if (stream->mask != (size_t) -1) return; // Windows wrap around instead
 
-    return token;
+    stream->capacity *= 2;
+    grow_array(stream->types, unsigned char, stream->capacity);
+    grow_array(stream->offsets, uint32_t, stream->capacity);
+    grow_array(stream->lengths, uint32_t, stream->capacity);
+    grow_array(stream->values, token_value_t, stream->capacity);
 }
 
-token_float_t *token_new_float(double value, token_pos_t token_pos) {
-    token_float_t *token = (token_float_t *) token_new(TOKEN_FLOAT, token_pos);
+size_t token_stream_push(token_stream_t *stream, token_type_t type, size_t offset, size_t length) {
+    ensure_capacity(stream);
+
+    size_t slot = token_slot(stream, stream->size);
+    stream->size++;
+
+    stream->types[slot] = (unsigned char) type;
+    stream->offsets[slot] = (uint32_t) offset;
+    stream->lengths[slot] = (uint32_t) length;
 
-    token->value = (double *) malloc(sizeof(double));
-    *(token->value) = value;
+    return slot;
+}
 
-    return token;
+// Copies count tokens from slot from of src to slot to of dest, which has to have the room for them.
+static void copy_tokens(token_stream_t *dest, size_t to, token_stream_t *src, size_t from, size_t count) {
+    memcpy(dest->types + to, src->types + from, count * sizeof(unsigned char));
+    memcpy(dest->offsets + to, src->offsets + from, count * sizeof(uint32_t));
+    memcpy(dest->lengths + to, src->lengths + from, count * sizeof(uint32_t));
+    memcpy(dest->values + to, src->values + from, count * sizeof(token_value_t));
 }
 
-token_char_t *token_new_char(wchar_t value, token_pos_t token_pos) {
-    token_char_t *token = (token_char_t *) token_new(TOKEN_CHAR, token_pos);
+token_stream_t *token_stream_concat(const char *input, token_stream_t **parts, size_t count, size_t extra_capacity) {
+    size_t total = 0;
+    size_t i;
+    for (i = 0; i < count; i++) {
+        total += parts[i]->size;
+    }
+
+    token_stream_t *stream = token_stream_new(input, total + extra_capacity);
 
-    token->value = value;
+    for (i = 0; i < count; i++) {
+        copy_tokens(stream, stream->size, parts[i], 0, parts[i]->size);
+        stream->size += parts[i]->size;
+    }
 
-    return token;
+    return stream;
 }
 
-token_keyword_t *token_new_keyword(keyword_t keyword, token_pos_t token_pos) {
-    token_keyword_t *token = (token_keyword_t *) token_new(TOKEN_KEYWORD, token_pos);
+token_stream_t *token_stream_splice(token_stream_t *stream, const char *input, size_t start, size_t end,
+                                    token_stream_t *replacement, long offset_delta) {
+    size_t tail = stream->size - end;
+    token_stream_t *result = token_stream_new(input, start + replacement->size + tail);
 
-    token->keyword = keyword;
+    copy_tokens(result, 0, stream, 0, start);
+    copy_tokens(result, start, replacement, 0, replacement->size);
+    result->size = start + replacement->size;
+
+    // The tail moves along with the text behind the edit
+    copy_tokens(result, result->size, stream, end, tail);
+
+    size_t i;
+    for (i = 0; i < tail; i++) {
+        result->offsets[result->size + i] = (uint32_t) ((long) result->offsets[result->size + i] + offset_delta);
+    }
+    result->size += tail;
+
+    return result;
+}
+
+token_pos_t token_stream_position(token_stream_t *stream, size_t i) {
+    if (stream->lines == NULL) {
+        stream->lines = line_index_new(stream->input);
+    }
 
-    return token;
+    return line_index_position(stream->lines, stream->offsets[token_slot(stream, i)]);
 }
 
-token_operator_t *token_new_operator(const wchar_t *start, size_t length, token_pos_t token_pos) {
-    return (token_operator_t *) new_string_token(TOKEN_OPERATOR, start, length, token_pos);
+static const char *operator_spellings[OPERATOR_COUNT] = {
+        "=", "!", "<", ">", "+", "-", "*", "/", "==", "!=", "<=", ">=", "to",
+};
+
+const char *operator_spelling(operator_t op) {
+    return operator_spellings[op];
 }
 
-void token_free(token_t *token) {
-    if (token->type == TOKEN_IDENTIFIER) {
-        wchar_t *identifier = ((token_identifier_t *) token)->value;
-        free(identifier);
+typedef struct number_suffix_spelling_t {
+    const char *str;
+    size_t length;
+    const char *type_name;
+} number_suffix_spelling_t;
+
+static const number_suffix_spelling_t number_suffix_spellings[SUFFIX_COUNT] = {
+        { "", 0, NULL },
+        { "i8", 2, "Int8" },
+        { "i16", 3, "Int16" },
+        { "i32", 3, "Int32" },
+        { "i64", 3, "Int64" },
+        { "u8", 2, "UInt8" },
+        { "u16", 3, "UInt16" },
+        { "u32", 3, "UInt32" },
+        { "u64", 3, "UInt64" },
+        { "f32", 3, "Float32" },
+        { "f64", 3, "Float64" },
+};
+
+number_suffix_t number_suffix_from_spelling(const char *str, size_t length) {
+    if (length < 2 || length > 3) return SUFFIX_NONE;
+
+    size_t i;
+    for (i = 1; i < SUFFIX_COUNT; i++) {
+        const number_suffix_spelling_t *suffix = &number_suffix_spellings[i];
+        if (suffix->length == length && memcmp(suffix->str, str, length) == 0) return (number_suffix_t) i;
     }
 
-    free(token);
+    return SUFFIX_NONE;
 }
 
-static const wchar_t *DEBUG_keyword_str(keyword_t keyword) {
+number_suffix_t token_number_suffix(token_stream_t *stream, size_t i) {
+    const char *spelling = token_spelling(stream, i);
+    size_t length = stream->lengths[token_slot(stream, i)];
+
+    // A suffix is the only place a number can have an i, u or f, and it's always a letter followed by digits.
+    size_t start = length;
+    while (start > 0 && spelling[start - 1] >= '0' && spelling[start - 1] <= '9') start--;
+    if (start == 0) return SUFFIX_NONE;
+
+    char letter = spelling[start - 1];
+    if (letter != 'i' && letter != 'u' && letter != 'f') return SUFFIX_NONE;
+
+    return number_suffix_from_spelling(spelling + start - 1, length - start + 1);
+}
+
+const char *number_suffix_type_name(number_suffix_t suffix) {
+    return number_suffix_spellings[suffix].type_name;
+}
+
+static const char *DEBUG_keyword_str(keyword_t keyword) {
     switch (keyword) {
         case KEYWORD_FUNCTION:
-            return L"function";
+            return "function";
         case KEYWORD_IF:
-            return L"if";
+            return "if";
         case KEYWORD_ELSE:
-            return L"else";
+            return "else";
         case KEYWORD_FOR:
-            return L"for";
+            return "for";
         case KEYWORD_LET:
-            return L"let";
+            return "let";
         case KEYWORD_VAR:
-            return L"var";
+            return "var";
         case KEYWORD_TRUE:
-            return L"true";
+            return "true";
         case KEYWORD_FALSE:
-            return L"false";
+            return "false";
         case KEYWORD_RETURN:
-            return L"return";
+            return "return";
         case KEYWORD_EXTERN:
-            return L"extern";
+            return "extern";
         case KEYWORD_WHILE:
-            return L"while";
+            return "while";
     }
+
+    return "unknown";
 }
 
-void DEBUG_token_print(token_t *token) {
-    switch (token->type) {
+void DEBUG_token_print(token_stream_t *stream, size_t i) {
+    size_t slot = token_slot(stream, i);
+    token_value_t *value = &stream->values[slot];
+
+    switch ((token_type_t) stream->types[slot]) {
         case TOKEN_NULL:
-            wprintf(L"Null lexer\n");
+            printf("Null lexer\n");
             break;
         case TOKEN_IDENTIFIER:
-            wprintf(L"Identifier: [%ls]\n", ((token_identifier_t *) token)->value);
+            printf("Identifier: [%s]\n", value->name);
             break;
         case TOKEN_INTEGER:
-            wprintf(L"Integer: [%d]\n", ((token_integer_t *) token)->value);
+            printf("Integer: [%lld]\n", (long long) value->integer);
+            break;
+        case TOKEN_FLOAT:
+            printf("Float: [%lf]\n", value->floating);
             break;
         case TOKEN_CHAR:
-            wprintf(L"Char: [%c]\n", ((token_char_t *) token)->value);
+            printf("Char: [%c]\n", value->character);
             break;
         case TOKEN_KEYWORD:
-            wprintf(L"Keyword: [%ls]\n", DEBUG_keyword_str(((token_keyword_t *) token)->keyword));
+            printf("Keyword: [%s]\n", DEBUG_keyword_str(value->keyword));
             break;
         case TOKEN_OPERATOR:
-            wprintf(L"Operator: [%ls]\n", ((token_operator_t *) token)->op);
+            printf("Operator: [%s]\n", operator_spelling(value->op));
             break;
         case TOKEN_END_OF_STATEMENT:
-            wprintf(L"End of statement\n");
+            printf("End of statement\n");
+            break;
+        case TOKEN_INVALID_INTEGER:
+            printf("Invalid integer: [%.*s]\n", (int) stream->lengths[slot], token_spelling(stream, i));
             break;
         default:
-            wprintf(L"Unknown token type!\n");
+            printf("Unknown token type!\n");
             break;
     }
 }
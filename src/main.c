@@ -1,66 +1,43 @@
-#include <wchar.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <llvm-c/Target.h>
 #include <llvm-c/ExecutionEngine.h>
 #include <llvm-c/Support.h>
 
 #include "lexer/token.h"
 #include "util/ptr_list.h"
+#include "util/source.h"
+#include "util/arena.h"
+#include "util/thread_pool.h"
 #include "lexer/lexer.h"
 #include "parser/parser.h"
 #include "parser/ast.h"
+#include "parser/flat_ast.h"
+#include "parser/ast_cache.h"
 #include "codegen/compiler.h"
 
-wchar_t *read_all(const char *path, size_t *size) {
-    FILE *file = fopen(path, "r");
-    size_t fsize = 0;
-
-    wchar_t *buffer = (wchar_t *) malloc(1);
-    wchar_t line_buffer[512];
-
-    while (fgetws(line_buffer, 512, file)) {
-        size_t line_length = wcslen(line_buffer);
-
-        wchar_t *new_buffer = (wchar_t *) realloc(buffer, (fsize + line_length + 1) * sizeof(wchar_t));
-        if (new_buffer == NULL) {
-            fprintf(stderr, "Out of memory!\n");
-            free(buffer);
-            return NULL;
-        }
-
-        buffer = new_buffer;
-        wcscpy(buffer + fsize, line_buffer);
-        fsize += line_length;
-    }
-
-    *size = fsize;
-
-    fclose(file);
-    return buffer;
-}
-
 int foo(int a) {
-    wprintf(L"%d\n", a);
+    printf("%d\n", a);
     return a;
 }
 
 void print_n(int v) {
-    wprintf(L"%d\n", v);
+    printf("%d\n", v);
 }
 
 void print_d(double d) {
-    wprintf(L"%lf\n", d);
+    printf("%lf\n", d);
 }
 
 void dump_ast(ptr_list_t *top_level_stmts) {
     size_t i;
     for (i = 0; i < ptr_list_size(top_level_stmts); i++) {
-        stmt_t *stmt = (stmt_t *) ptr_list_at(top_level_stmts, i);
+        stmt_t *stmt = (stmt_t *) ptr_list_at_unchecked(top_level_stmts, i);
         print_stmt(stmt, 0);
     }
 
-    wprintf(L"\n");
+    printf("\n");
 }
 
 int run_jit(compiler_t *compiler) {
@@ -95,28 +72,279 @@ int run_jit(compiler_t *compiler) {
     int result = LLVMRunFunctionAsMain(jit, compiler_get_main(compiler), 0, NULL, NULL);
 
     if (!compiler_is_main_void(compiler)) {
-        wprintf(L"Result: %d\n", result);
+        printf("Result: %d\n", result);
     }
 
     return result;
 }
 
-int main() {
-    size_t size;
-    wchar_t *test = read_all("test/test.pstl", &size);
+typedef struct options_t {
+    const char *path;
+    int streaming;
+    int flat_ast;
+    int lazy;
+    size_t threads; // 0 for one per CPU
+    const char *cache_dir; // NULL if the AST cache is off
+} options_t;
+
+static int parse_options(int argc, char **argv, options_t *options) {
+    options->path = "test/test.pstl";
+    options->streaming = 0;
+    options->flat_ast = 0;
+    options->lazy = 0;
+    options->threads = 1;
+    options->cache_dir = ast_cache_dir();
+
+    int i;
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--stream")) {
+            options->streaming = 1;
+            continue;
+        }
+
+        if (!strcmp(argv[i], "--flat")) {
+            options->flat_ast = 1;
+            continue;
+        }
+
+        if (!strcmp(argv[i], "--lazy")) {
+            options->lazy = 1;
+            continue;
+        }
+
+        if (!strcmp(argv[i], "--no-cache")) {
+            options->cache_dir = NULL;
+            continue;
+        }
+
+        if (!strcmp(argv[i], "--threads")) {
+            if (i + 1 == argc) {
+                fprintf(stderr, "Expected a thread count after --threads\n");
+                return 0;
+            }
+
+            options->threads = (size_t) strtoul(argv[++i], NULL, 10);
+            continue;
+        }
+
+        if (argv[i][0] == '-') {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 0;
+        }
+
+        options->path = argv[i];
+    }
+
+    return 1;
+}
+
+static compiler_t *compile_stmts(ptr_list_t *top_level_stmts) {
+    compiler_t *compiler = compiler_new(top_level_stmts, OPT_ALL);
+    if (compiler_compile(compiler)) {
+        return NULL;
+    }
+
+    return compiler;
+}
+
+static token_stream_t *lex_source(source_t *source, thread_pool_t *pool) {
+    if (pool != NULL) {
+        return lexer_lex_parallel(source_data(source), source_size(source), pool);
+    }
+
+    lexer_t *lexer = lexer_new(source_data(source), source_size(source));
+    if (lexer == NULL) return NULL;
 
-    lexer_t *lexer = lexer_new(test, size);
     lexer_lex_all(lexer);
 
-    ptr_list_t *tokens = lexer_get_tokens(lexer);
+    token_stream_t *tokens = lexer_get_tokens(lexer);
+    lexer_free(lexer);
 
-    parser_t *parser = parser_new(tokens);
-    ptr_list_t *top_level_stmts = parser_parse_all(parser);
+    return tokens;
+}
+
+// Lexes and parses on the pool's threads, or sequentially if pool is NULL.
+static ptr_list_t *parse_source(source_t *source, arena_t *ast_arena, thread_pool_t *pool) {
+    token_stream_t *tokens = lex_source(source, pool);
+    if (tokens == NULL) return NULL;
+
+    ptr_list_t *top_level_stmts;
+    if (pool != NULL) {
+        top_level_stmts = parser_parse_parallel(tokens, ast_arena, pool);
+    } else {
+        parser_t *parser = parser_new(tokens, ast_arena);
+        top_level_stmts = parser_parse_all(parser);
+        parser_free(parser);
+    }
+
+    token_stream_free(tokens);
+
+    return top_level_stmts;
+}
+
+// The cached flat AST of the source, NULL if cache_dir is NULL or has no cache file for this source.
+static flat_ast_t *load_cached_ast(source_t *source, const char *cache_dir, uint64_t *hash) {
+    if (cache_dir == NULL) return NULL;
+
+    *hash = ast_cache_hash(source_data(source), source_size(source));
+    return ast_cache_load(cache_dir, *hash, source_size(source));
+}
+
+// Lexes and parses the source, unless the cache has its AST from an earlier run.
+static ptr_list_t *load_source(source_t *source, arena_t *ast_arena, thread_pool_t *pool, const char *cache_dir) {
+    uint64_t hash;
+    flat_ast_t *ast = load_cached_ast(source, cache_dir, &hash);
+    if (ast != NULL) {
+        ptr_list_t *top_level_stmts = flat_ast_expand(ast, ast_arena);
+        flat_ast_free(ast);
+
+        return top_level_stmts;
+    }
+
+    ptr_list_t *top_level_stmts = parse_source(source, ast_arena, pool);
+    if (top_level_stmts != NULL && cache_dir != NULL) {
+        ast = flat_ast_from_stmts(top_level_stmts);
+        ast_cache_store(cache_dir, hash, source_size(source), ast);
+        flat_ast_free(ast);
+    }
+
+    return top_level_stmts;
+}
+
+compiler_t *compile_all(source_t *source, arena_t *ast_arena, thread_pool_t *pool, const char *cache_dir) {
+    ptr_list_t *top_level_stmts = load_source(source, ast_arena, pool, cache_dir);
+    if (top_level_stmts == NULL) {
+        return NULL;
+    }
 
     dump_ast(top_level_stmts);
 
+    return compile_stmts(top_level_stmts);
+}
+
+/*
+ * Keeps the AST in its flat form between parsing and code generation. The pointer AST is only rebuilt for the
+ * compiler, from the flat one. The flat form is also what the AST cache stores, so a cached source is never expanded
+ * twice.
+ */
+compiler_t *compile_flat(source_t *source, arena_t *ast_arena, thread_pool_t *pool, const char *cache_dir) {
+    uint64_t hash;
+    flat_ast_t *ast = load_cached_ast(source, cache_dir, &hash);
+
+    if (ast == NULL) {
+        arena_t *parse_arena = arena_new();
+        ptr_list_t *parsed_stmts = parse_source(source, parse_arena, pool);
+        if (parsed_stmts == NULL) {
+            return NULL;
+        }
+
+        ast = flat_ast_from_stmts(parsed_stmts);
+        arena_free(parse_arena);
+
+        if (cache_dir != NULL) {
+            ast_cache_store(cache_dir, hash, source_size(source), ast);
+        }
+    }
+
+    flat_ast_print(ast);
+    printf("\n");
+
+    ptr_list_t *top_level_stmts = flat_ast_expand(ast, ast_arena);
+    flat_ast_free(ast);
+
+    return compile_stmts(top_level_stmts);
+}
+
+/*
+ * Parses only the prototypes up front. Function bodies are parsed once code generation reaches them from main, so
+ * functions that are never called cost little more than skipping over their tokens.
+ */
+compiler_t *compile_lazy(source_t *source, arena_t *ast_arena, thread_pool_t *pool) {
+    token_stream_t *tokens = lex_source(source, pool);
+    if (tokens == NULL) return NULL;
+
+    parser_t *parser = parser_new(tokens, ast_arena);
+    parser_set_lazy(parser, 1);
+
+    ptr_list_t *top_level_stmts = parser_parse_all(parser);
+    if (top_level_stmts == NULL) {
+        return NULL;
+    }
+
     compiler_t *compiler = compiler_new(top_level_stmts, OPT_ALL);
-    if (compiler_compile(compiler)) {
+    int failed = compiler_compile_lazy(compiler, parser);
+
+    parser_free(parser);
+    token_stream_free(tokens);
+
+    if (failed) {
+        return NULL;
+    }
+
+    dump_ast(top_level_stmts);
+
+    return compiler;
+}
+
+/*
+ * Lexes, parses and compiles one top level statement at a time, so only a small window of tokens is ever alive and
+ * code generation starts as soon as the first function is parsed.
+ */
+compiler_t *compile_streaming(source_t *source, arena_t *ast_arena) {
+    lexer_t *lexer = lexer_new_streaming(source_data(source), source_size(source));
+    if (lexer == NULL) return NULL;
+
+    parser_t *parser = parser_new_streaming(lexer, ast_arena);
+    compiler_t *compiler = compiler_new(ptr_list_new(), OPT_ALL);
+
+    while (!parser_at_end(parser)) {
+        stmt_t *stmt = parser_parse_next(parser);
+        if (stmt == NULL) return NULL;
+
+        print_stmt(stmt, 0);
+
+        if (compiler_compile_stmt(compiler, stmt)) {
+            return NULL;
+        }
+    }
+
+    printf("\n");
+
+    parser_free(parser);
+    lexer_free(lexer);
+
+    return compiler;
+}
+
+int main(int argc, char **argv) {
+    options_t options;
+    if (!parse_options(argc, argv, &options)) {
+        return 1;
+    }
+
+    source_t *source = source_open(options.path);
+    if (source == NULL) {
+        return 1;
+    }
+
+    // The compiler keeps pointing into the AST, so it is freed last
+    arena_t *ast_arena = arena_new();
+    thread_pool_t *pool = options.threads != 1 ? thread_pool_new(options.threads) : NULL;
+
+    compiler_t *compiler;
+    if (options.streaming) {
+        compiler = compile_streaming(source, ast_arena);
+    } else if (options.lazy) {
+        compiler = compile_lazy(source, ast_arena, pool);
+    } else if (options.flat_ast) {
+        compiler = compile_flat(source, ast_arena, pool, options.cache_dir);
+    } else {
+        compiler = compile_all(source, ast_arena, pool, options.cache_dir);
+    }
+
+    if (pool != NULL) thread_pool_free(pool);
+
+    if (compiler == NULL) {
         return 1;
     }
 
@@ -124,8 +352,8 @@ int main() {
 
     run_jit(compiler);
 
-    ptr_list_free(top_level_stmts);
-    ptr_list_free(tokens);
+    arena_free(ast_arena);
+    source_close(source);
 
     return 0;
 }
@@ -4,30 +4,39 @@
 
 #include "parser/ast.h"
 
-#include <wchar.h>
+#include <stdio.h>
+#include <stdlib.h>
 
 void print_indent(int indent) {
     int i;
     for (i = 0; i < indent; i++) {
-        wprintf(L"%lc", L' ');
+        printf("%c", ' ');
     }
 }
 
+// Ends the line of a number literal, naming its type if it has a suffix.
+static void print_number_type(const char *type) {
+    if (type != NULL) {
+        printf(" (%s)", type);
+    }
+    printf("\n");
+}
+
 void print_prototype(prototype_t *prototype, int indent) {
     print_indent(indent);
-    wprintf(L"Name: %ls\n", prototype->name);
+    printf("Name: %s\n", prototype->name);
     print_indent(indent);
-    wprintf(L"Return type: %ls\n", prototype->return_type);
+    printf("Return type: %s\n", prototype->return_type);
     print_indent(indent);
-    wprintf(L"Is extern: %ls\n", prototype->is_extern ? L"yes" : L"no");
+    printf("Is extern: %s\n", prototype->is_extern ? "yes" : "no");
     print_indent(indent);
-    wprintf(L"Arguments: (%lu)\n", ptr_list_size(prototype->arguments));
+    printf("Arguments: (%lu)\n", ptr_list_size(prototype->arguments));
 
     size_t i;
     for (i = 0; i < ptr_list_size(prototype->arguments); i++) {
         typed_ast_value_t *arg = (typed_ast_value_t *) ptr_list_get(prototype->arguments);
         print_indent(indent + 2);
-        wprintf(L"%ls (%ls)\n", arg->name, arg->type);
+        printf("%s (%s)\n", arg->name, arg->type);
     }
 }
 
@@ -36,70 +45,85 @@ void print_stmt(stmt_t *stmt, int indent) {
     function_stmt_data_t *func_data;
     assignment_stmt_data_t *ass_data; // hehe
     while_stmt_data_t *while_data;
+    declaration_stmt_data_t *declaration_data;
 
     print_indent(indent);
 
     switch (stmt->stmt_type) {
         case STMT_RETURN:
-            wprintf(L"Return\n");
+            printf("Return\n");
             print_expr(((return_stmt_t *) stmt)->value, indent + 2);
             break;
         case STMT_EXPR:
-            wprintf(L"Expr\n");
+            printf("Expr\n");
             print_expr(((expr_stmt_t *) stmt)->expr, indent + 2);
             break;
         case STMT_FUNCTION:
             func_data = ((function_stmt_t *) stmt)->data;
-            wprintf(L"Function\n");
+            printf("Function\n");
 
             print_indent(indent + 2);
-            wprintf(L"Prototype:\n");
+            printf("Prototype:\n");
             print_prototype(func_data->prototype, indent + 4);
 
+            if (func_data->body == NULL) {
+                print_indent(indent + 2);
+                printf("Body: (not parsed)\n");
+                break;
+            }
+
             print_indent(indent + 2);
-            wprintf(L"Variables: (%lu)\n", ptr_list_size(func_data->variables));
+            printf("Variables: (%lu)\n", ptr_list_size(func_data->variables));
             for (i = 0; i < ptr_list_size(func_data->variables); i++) {
-                typed_ast_value_t *var = (typed_ast_value_t *) ptr_list_at(func_data->variables, i);
+                typed_ast_value_t *var = (typed_ast_value_t *) ptr_list_at_unchecked(func_data->variables, i);
                 print_indent(indent + 4);
-                wprintf(L"%ls (%ls)\n", var->name, var->type);
+                printf("%s (%s)\n", var->name, var->type);
             }
 
             print_indent(indent + 2);
-            wprintf(L"Body:\n");
+            printf("Body:\n");
             for (i = 0; i < ptr_list_size(func_data->body); i++) {
-                stmt_t *body_stmt = (stmt_t *) ptr_list_at(func_data->body, i);
+                stmt_t *body_stmt = (stmt_t *) ptr_list_at_unchecked(func_data->body, i);
                 print_stmt(body_stmt, indent + 4);
             }
 
             break;
         case STMT_EXTERN:
-            wprintf(L"Extern\n");
+            printf("Extern\n");
             print_prototype(((extern_stmt_t *) stmt)->prototype, indent + 2);
             break;
         case STMT_ASSIGNMENT:
             ass_data = ((assignment_stmt_t *) stmt)->data;
-            wprintf(L"Assignment to %ls\n", ass_data->name);
+            printf("Assignment to %s\n", ass_data->name);
             print_expr(ass_data->value, indent + 2);
             break;
         case STMT_WHILE:
             while_data = ((while_stmt_t *) stmt)->data;
-            wprintf(L"While\n");
+            printf("While\n");
 
             print_indent(indent + 2);
-            wprintf(L"Condition:\n");
+            printf("Condition:\n");
             print_expr(while_data->condition, indent + 4);
 
             print_indent(indent + 2);
-            wprintf(L"Body:\n");
+            printf("Body:\n");
             for (i = 0; i < ptr_list_size(while_data->body); i++) {
-                stmt_t *body_stmt = (stmt_t *) ptr_list_at(while_data->body, i);
+                stmt_t *body_stmt = (stmt_t *) ptr_list_at_unchecked(while_data->body, i);
                 print_stmt(body_stmt, indent + 4);
             }
             break;
+        case STMT_DECLARATION:
+            declaration_data = ((declaration_stmt_t *) stmt)->data;
+            printf("Declaration of %s (%s)\n", declaration_data->variable->name, declaration_data->variable->type);
+            if (declaration_data->value != NULL) {
+                print_expr(declaration_data->value, indent + 2);
+            }
+            break;
     }
 }
 
-void print_expr(expr_t *expr, int indent) {
+// Prints the line of expr itself. The operands of unary, binary and cast expressions are left to print_expr.
+static void print_expr_node(expr_t *expr, int indent) {
     size_t i;
     unary_expr_data_t *unary_expr_data;
     binary_expr_data_t *binary_expr_data;
@@ -111,56 +135,55 @@ void print_expr(expr_t *expr, int indent) {
 
     switch (expr->expr_type) {
         case EXPR_BOOL:
-            wprintf(L"Bool: %ls\n", ((bool_expr_t *) expr)->data ? L"true" : L"false");
+            printf("Bool: %s\n", ((bool_expr_t *) expr)->data ? "true" : "false");
             break;
         case EXPR_INT:
-            wprintf(L"Int: %d\n", ((int_expr_t *) expr)->data);
+            printf("Int: %lld", (long long) ((int_expr_t *) expr)->data);
+            print_number_type(((int_expr_t *) expr)->type);
             break;
         case EXPR_FLOAT:
-            wprintf(L"Float: %d\n", *((float_expr_t *) expr)->data);
+            printf("Float: %lf", *((float_expr_t *) expr)->data);
+            print_number_type(((float_expr_t *) expr)->type);
             break;
         case EXPR_VARIABLE:
-            wprintf(L"Variable: %ls\n", ((variable_expr_t *) expr)->name);
+            printf("Variable: %s\n", ((variable_expr_t *) expr)->name);
             break;
         case EXPR_UNARY:
             unary_expr_data = ((unary_expr_t *) expr)->data;
-            wprintf(L"Unary expression: %ls\n", unary_expr_data->op);
-            print_expr(unary_expr_data->value, indent + 2);
+            printf("Unary expression: %s\n", operator_spelling(unary_expr_data->op));
             break;
         case EXPR_BINARY:
             binary_expr_data = ((binary_expr_t *) expr)->data;
-            wprintf(L"Binary expression: %ls\n", binary_expr_data->op);
-            print_expr(binary_expr_data->lhs, indent + 2);
-            print_expr(binary_expr_data->rhs, indent + 2);
+            printf("Binary expression: %s\n", operator_spelling(binary_expr_data->op));
             break;
         case EXPR_CALL:
             call_expr_data = ((call_expr_t *) expr)->data;
-            wprintf(L"Call: %ls\n", call_expr_data->callee_name);
+            printf("Call: %s\n", call_expr_data->callee_name);
             for (i = 0; i < ptr_list_size(call_expr_data->arguments); i++) {
-                expr_t *arg = (expr_t *) ptr_list_at(call_expr_data->arguments, i);
+                expr_t *arg = (expr_t *) ptr_list_at_unchecked(call_expr_data->arguments, i);
                 print_expr(arg, indent + 2);
             }
             break;
         case EXPR_IF:
             if_expr_data = ((if_expr_t *) expr)->data;
-            wprintf(L"If\n");
+            printf("If\n");
 
             print_indent(indent + 2);
-            wprintf(L"Condition:\n");;
+            printf("Condition:\n");;
             print_expr(if_expr_data->condition, indent + 4);
 
             print_indent(indent + 2);
-            wprintf(L"Then: (Statements: %lu)\n", ptr_list_size(if_expr_data->then_stmts));
+            printf("Then: (Statements: %lu)\n", ptr_list_size(if_expr_data->then_stmts));
             for (i = 0; i < ptr_list_size(if_expr_data->then_stmts); i++) {
-                stmt_t *stmt= (stmt_t *) ptr_list_at(if_expr_data->then_stmts, i);
+                stmt_t *stmt= (stmt_t *) ptr_list_at_unchecked(if_expr_data->then_stmts, i);
                 print_stmt(stmt, indent + 4);
             }
 
             if (if_expr_data->else_stmts != NULL) {
                 print_indent(indent + 2);
-                wprintf(L"Else: (Statements: %lu)\n", ptr_list_size(if_expr_data->else_stmts));
+                printf("Else: (Statements: %lu)\n", ptr_list_size(if_expr_data->else_stmts));
                 for (i = 0; i < ptr_list_size(if_expr_data->else_stmts); i++) {
-                    stmt_t *stmt = (stmt_t *) ptr_list_at(if_expr_data->else_stmts, i);
+                    stmt_t *stmt = (stmt_t *) ptr_list_at_unchecked(if_expr_data->else_stmts, i);
                     print_stmt(stmt, indent + 4);
                 }
             }
@@ -168,8 +191,114 @@ void print_expr(expr_t *expr, int indent) {
             break;
         case EXPR_CAST:
             cast_expr_data = ((cast_expr_t *) expr)->data;
-            wprintf(L"Cast to %ls\n", cast_expr_data->type);
-            print_expr(cast_expr_data->value, indent + 2);
+            printf("Cast to %s\n", cast_expr_data->type);
             break;
     }
 }
+
+typedef struct print_frame_t {
+    expr_t *expr;
+    int indent;
+} print_frame_t;
+
+typedef struct print_stack_t {
+    print_frame_t *frames;
+    size_t size;
+    size_t capacity;
+} print_stack_t;
+
+static void push_frame(print_stack_t *stack, expr_t *expr, int indent) {
+    if (stack->size == stack->capacity) {
+        stack->capacity = stack->capacity == 0 ? 16 : stack->capacity * 2;
+        stack->frames = (print_frame_t *) realloc(stack->frames, stack->capacity * sizeof(print_frame_t));
+    }
+
+    stack->frames[stack->size].expr = expr;
+    stack->frames[stack->size].indent = indent;
+    stack->size++;
+}
+
+// Operator chains can be arbitrarily deep, so they are walked with an explicit stack instead of recursion.
+void print_expr(expr_t *expr, int indent) {
+    print_stack_t stack = { NULL, 0, 0 };
+    push_frame(&stack, expr, indent);
+
+    while (stack.size > 0) {
+        print_frame_t frame = stack.frames[--stack.size];
+        int child_indent = frame.indent + 2;
+
+        print_expr_node(frame.expr, frame.indent);
+
+        // Pushed in reverse, so the left hand side is printed first
+        switch (frame.expr->expr_type) {
+            case EXPR_UNARY:
+                push_frame(&stack, ((unary_expr_t *) frame.expr)->data->value, child_indent);
+                break;
+            case EXPR_BINARY:
+                push_frame(&stack, ((binary_expr_t *) frame.expr)->data->rhs, child_indent);
+                push_frame(&stack, ((binary_expr_t *) frame.expr)->data->lhs, child_indent);
+                break;
+            case EXPR_CAST:
+                push_frame(&stack, ((cast_expr_t *) frame.expr)->data->value, child_indent);
+                break;
+            default:
+                break;
+        }
+    }
+
+    free(stack.frames);
+}
+
+void collect_operator_chain(expr_t *expr, ptr_list_t *order, ptr_list_t *stack) {
+    size_t base = ptr_list_size(stack);
+    ptr_list_push(stack, expr);
+
+    while (ptr_list_size(stack) > base) {
+        expr_t *node = (expr_t *) ptr_list_pop(stack);
+        ptr_list_push(order, node);
+
+        // The right hand side is pushed last, so it ends up in front of the left one in order
+        switch (node->expr_type) {
+            case EXPR_UNARY:
+                ptr_list_push(stack, ((unary_expr_t *) node)->data->value);
+                break;
+            case EXPR_BINARY:
+                ptr_list_push(stack, ((binary_expr_t *) node)->data->lhs);
+                ptr_list_push(stack, ((binary_expr_t *) node)->data->rhs);
+                break;
+            case EXPR_CAST:
+                ptr_list_push(stack, ((cast_expr_t *) node)->data->value);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+void chain_walker_init(chain_walker_t *walker) {
+    walker->order = ptr_list_new();
+    walker->stack = ptr_list_new();
+}
+
+void chain_walker_free(chain_walker_t *walker) {
+    ptr_list_free(walker->order);
+    ptr_list_free(walker->stack);
+}
+
+int walk_operator_chain(chain_walker_t *walker, expr_t *expr, chain_visitor_t visit_operand,
+                        chain_visitor_t visit_operator, void *context) {
+    size_t base = ptr_list_size(walker->order);
+    collect_operator_chain(expr, walker->order, walker->stack);
+
+    int result = 0;
+    size_t i = ptr_list_size(walker->order);
+    while (i-- > base && result == 0) {
+        expr_t *node = (expr_t *) ptr_list_at_unchecked(walker->order, i);
+        chain_visitor_t visit = is_operator_expr(node) ? visit_operator : visit_operand;
+
+        if (visit != NULL) result = visit(context, node);
+    }
+
+    ptr_list_truncate(walker->order, base);
+    return result;
+}
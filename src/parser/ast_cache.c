@@ -0,0 +1,336 @@
+//
+// Created by sarah on 3/25/24.
+//
+
+#include "parser/ast_cache.h"
+#include "../util/intern.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define AST_CACHE_MAGIC "PASTAST"
+
+// Bump whenever the flat AST or this format changes, so old cache files are ignored.
+#define AST_CACHE_VERSION 3
+
+#define DEFAULT_CACHE_DIR ".pastel_cache"
+
+/*
+ * Everything is stored in the byte order of the machine that wrote the file. A file from a machine with the other one
+ * won't match the version and is treated like a missing one.
+ */
+typedef struct ast_cache_header_t {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t source_hash;
+    uint64_t source_size;
+    uint32_t node_count;
+    uint32_t list_size;
+    uint32_t name_count;
+    flat_index_t root;
+    uint64_t names_size; // In bytes, including the terminators
+} ast_cache_header_t;
+
+const char *ast_cache_dir() {
+    const char *dir = getenv("PASTEL_CACHE_DIR");
+    if (dir == NULL || dir[0] == '\0') return DEFAULT_CACHE_DIR;
+
+    return dir;
+}
+
+uint64_t ast_cache_hash(const char *data, size_t size) {
+    uint64_t hash = UINT64_C(14695981039346656037);
+
+    size_t i;
+    for (i = 0; i < size; i++) {
+        hash ^= (unsigned char) data[i];
+        hash *= UINT64_C(1099511628211);
+    }
+
+    return hash;
+}
+
+// Caller frees the path.
+static char *cache_path(const char *dir, uint64_t hash, const char *suffix) {
+    size_t size = strlen(dir) + strlen(suffix) + 32;
+    char *path = (char *) malloc(size);
+    snprintf(path, size, "%s/%016llx%s", dir, (unsigned long long) hash, suffix);
+
+    return path;
+}
+
+/* Checks of the node and list arrays of a cache file, against the layout described in flat_ast.h */
+
+typedef struct cache_arrays_t {
+    const flat_node_t *nodes;
+    const flat_index_t *lists;
+    flat_index_t node_count;
+    flat_index_t list_size;
+    flat_index_t name_count;
+} cache_arrays_t;
+
+// What a node operand or list entry has to be
+typedef enum operand_kind_t {
+    OPERAND_EXPR,
+    OPERAND_STMT, // Statements in a block
+    OPERAND_TOP_LEVEL,
+    OPERAND_PROTOTYPE,
+    OPERAND_TYPED_VALUE,
+} operand_kind_t;
+
+static int kind_fits(uint8_t kind, operand_kind_t operand_kind) {
+    switch (operand_kind) {
+        case OPERAND_EXPR:
+            return kind <= FLAT_CAST;
+        case OPERAND_STMT:
+            return kind == FLAT_RETURN || kind == FLAT_EXPR || kind == FLAT_ASSIGNMENT || kind == FLAT_WHILE ||
+                   kind == FLAT_DECLARATION;
+        case OPERAND_TOP_LEVEL:
+            return kind == FLAT_FUNCTION || kind == FLAT_EXTERN;
+        case OPERAND_PROTOTYPE:
+            return kind == FLAT_PROTOTYPE;
+        case OPERAND_TYPED_VALUE:
+            return kind == FLAT_TYPED_VALUE;
+        default:
+            return 0;
+    }
+}
+
+/*
+ * Nodes are stored in post order, so every node a node refers to comes before it. Checking that also rules out
+ * cycles, which is what lets the expansion walk the nodes without checking for them.
+ */
+static int is_valid_node(const cache_arrays_t *arrays, flat_index_t node, flat_index_t user, operand_kind_t kind) {
+    return node < user && kind_fits(arrays->nodes[node].kind, kind);
+}
+
+static int is_valid_name(const cache_arrays_t *arrays, flat_index_t name, int is_optional) {
+    return name < arrays->name_count || (is_optional && name == FLAT_NONE);
+}
+
+static int is_valid_list(const cache_arrays_t *arrays, flat_index_t list, flat_index_t user, operand_kind_t kind) {
+    if (list >= arrays->list_size) return 0;
+    if ((uint64_t) list + 1 + arrays->lists[list] > arrays->list_size) return 0;
+
+    flat_index_t i;
+    for (i = 0; i < arrays->lists[list]; i++) {
+        if (!is_valid_node(arrays, arrays->lists[list + 1 + i], user, kind)) return 0;
+    }
+
+    return 1;
+}
+
+static int is_valid_flat_node(const cache_arrays_t *arrays, flat_index_t index) {
+    const flat_node_t *node = &arrays->nodes[index];
+
+    switch ((flat_kind_t) node->kind) {
+        case FLAT_BOOL:
+            return 1;
+        case FLAT_INT:
+        case FLAT_FLOAT:
+            return is_valid_name(arrays, node->c, 1);
+        case FLAT_VARIABLE:
+            return is_valid_name(arrays, node->a, 0);
+        case FLAT_UNARY:
+            return node->a < OPERATOR_COUNT && is_valid_node(arrays, node->b, index, OPERAND_EXPR);
+        case FLAT_BINARY:
+            return node->a < OPERATOR_COUNT && is_valid_node(arrays, node->b, index, OPERAND_EXPR) &&
+                   is_valid_node(arrays, node->c, index, OPERAND_EXPR);
+        case FLAT_CALL:
+            return is_valid_name(arrays, node->a, 0) && is_valid_list(arrays, node->b, index, OPERAND_EXPR);
+        case FLAT_IF:
+            return is_valid_node(arrays, node->a, index, OPERAND_EXPR) &&
+                   is_valid_list(arrays, node->b, index, OPERAND_STMT) &&
+                   (node->c == FLAT_NONE || is_valid_list(arrays, node->c, index, OPERAND_STMT));
+        case FLAT_CAST:
+            return is_valid_node(arrays, node->a, index, OPERAND_EXPR) && is_valid_name(arrays, node->b, 0);
+        case FLAT_RETURN:
+        case FLAT_EXPR:
+            return is_valid_node(arrays, node->a, index, OPERAND_EXPR);
+        case FLAT_FUNCTION:
+            return is_valid_node(arrays, node->a, index, OPERAND_PROTOTYPE) &&
+                   is_valid_list(arrays, node->b, index, OPERAND_TYPED_VALUE) &&
+                   is_valid_list(arrays, node->c, index, OPERAND_STMT);
+        case FLAT_EXTERN:
+            return is_valid_node(arrays, node->a, index, OPERAND_PROTOTYPE);
+        case FLAT_ASSIGNMENT:
+            return is_valid_name(arrays, node->a, 0) && is_valid_node(arrays, node->b, index, OPERAND_EXPR);
+        case FLAT_WHILE:
+            return is_valid_node(arrays, node->a, index, OPERAND_EXPR) &&
+                   is_valid_list(arrays, node->b, index, OPERAND_STMT);
+        case FLAT_DECLARATION:
+            return is_valid_node(arrays, node->a, index, OPERAND_TYPED_VALUE) &&
+                   (node->b == FLAT_NONE || is_valid_node(arrays, node->b, index, OPERAND_EXPR));
+        case FLAT_PROTOTYPE:
+            return is_valid_name(arrays, node->a, 0) && is_valid_name(arrays, node->b, 1) &&
+                   is_valid_list(arrays, node->c, index, OPERAND_TYPED_VALUE);
+        case FLAT_TYPED_VALUE:
+            return is_valid_name(arrays, node->a, 0) && is_valid_name(arrays, node->b, 0);
+        default:
+            return 0;
+    }
+}
+
+static int is_valid_flat_ast(const cache_arrays_t *arrays, flat_index_t root) {
+    flat_index_t i;
+    for (i = 0; i < arrays->node_count; i++) {
+        if (!is_valid_flat_node(arrays, i)) return 0;
+    }
+
+    return is_valid_list(arrays, root, arrays->node_count, OPERAND_TOP_LEVEL);
+}
+
+/*
+ * Builds the AST from a mapped cache file. Every index inside the arrays is checked as well, so a damaged or edited
+ * file is treated like a missing one instead of crashing the expansion.
+ */
+static flat_ast_t *read_ast(const char *data, size_t size, uint64_t hash, size_t source_size) {
+    if (size < sizeof(ast_cache_header_t)) return NULL;
+
+    const ast_cache_header_t *header = (const ast_cache_header_t *) data;
+    if (memcmp(header->magic, AST_CACHE_MAGIC, sizeof(header->magic)) != 0) return NULL;
+    if (header->version != AST_CACHE_VERSION) return NULL;
+    if (header->source_hash != hash || header->source_size != (uint64_t) source_size) return NULL;
+
+    size_t nodes_size = header->node_count * sizeof(flat_node_t);
+    size_t lists_size = header->list_size * sizeof(flat_index_t);
+    size_t names_size = header->names_size;
+    if (sizeof(ast_cache_header_t) + nodes_size + lists_size + names_size != size) return NULL;
+
+    const flat_node_t *nodes = (const flat_node_t *) (data + sizeof(ast_cache_header_t));
+    const flat_index_t *lists = (const flat_index_t *) ((const char *) nodes + nodes_size);
+    const char *names = (const char *) lists + lists_size;
+
+    if (header->names_size > 0 && names[header->names_size - 1] != '\0') return NULL;
+
+    cache_arrays_t arrays;
+    arrays.nodes = nodes;
+    arrays.lists = lists;
+    arrays.node_count = header->node_count;
+    arrays.list_size = header->list_size;
+    arrays.name_count = header->name_count;
+    if (!is_valid_flat_ast(&arrays, header->root)) return NULL;
+
+    flat_ast_t *ast = flat_ast_new_capacity(header->node_count, header->list_size, header->name_count);
+
+    memcpy(ast->nodes, nodes, nodes_size);
+    ast->node_count = header->node_count;
+
+    memcpy(ast->lists, lists, lists_size);
+    ast->list_size = header->list_size;
+
+    size_t pos = 0;
+    flat_index_t i;
+    for (i = 0; i < header->name_count; i++) {
+        if (pos >= header->names_size) {
+            flat_ast_free(ast);
+            return NULL;
+        }
+
+        ast->names[i] = intern_string(names + pos);
+        pos += strlen(names + pos) + 1;
+    }
+
+    ast->name_count = header->name_count;
+    ast->root = header->root;
+
+    return ast;
+}
+
+flat_ast_t *ast_cache_load(const char *dir, uint64_t hash, size_t source_size) {
+    char *path = cache_path(dir, hash, ".ast");
+    int fd = open(path, O_RDONLY);
+    free(path);
+
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+
+    size_t size = (size_t) st.st_size;
+    char *data = (char *) mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED) return NULL;
+
+    flat_ast_t *ast = read_ast(data, size, hash, source_size);
+    munmap(data, size);
+
+    return ast;
+}
+
+static int write_ast(FILE *file, uint64_t hash, size_t source_size, flat_ast_t *ast) {
+    ast_cache_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, AST_CACHE_MAGIC, sizeof(header.magic));
+    header.version = AST_CACHE_VERSION;
+    header.source_hash = hash;
+    header.source_size = (uint64_t) source_size;
+    header.node_count = ast->node_count;
+    header.list_size = ast->list_size;
+    header.name_count = ast->name_count;
+    header.root = ast->root;
+
+    flat_index_t i;
+    for (i = 0; i < ast->name_count; i++) {
+        header.names_size += strlen(ast->names[i]) + 1;
+    }
+
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(ast->nodes, sizeof(flat_node_t), ast->node_count, file);
+    fwrite(ast->lists, sizeof(flat_index_t), ast->list_size, file);
+
+    for (i = 0; i < ast->name_count; i++) {
+        fwrite(ast->names[i], 1, strlen(ast->names[i]) + 1, file);
+    }
+
+    return ferror(file) != 0;
+}
+
+int ast_cache_store(const char *dir, uint64_t hash, size_t source_size, flat_ast_t *ast) {
+    if (mkdir(dir, 0777) < 0 && errno != EEXIST) {
+        fprintf(stderr, "Couldn't create cache directory %s: %s\n", dir, strerror(errno));
+        return 1;
+    }
+
+    /*
+     * Written under a name of its own and renamed into place, so other runs of the same source never see a partial
+     * file, only the old one or the new one.
+     */
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%ld.tmp", (long) getpid());
+
+    char *path = cache_path(dir, hash, ".ast");
+    char *temp_path = cache_path(dir, hash, suffix);
+    int failed = 1;
+
+    FILE *file = fopen(temp_path, "wb");
+    if (file != NULL) {
+        failed = write_ast(file, hash, source_size, ast);
+        failed = fclose(file) != 0 || failed;
+    }
+
+    if (!failed) {
+        failed = rename(temp_path, path) != 0;
+    }
+
+    if (failed) {
+        fprintf(stderr, "Couldn't write cache file %s: %s\n", path, strerror(errno));
+        remove(temp_path);
+    }
+
+    free(path);
+    free(temp_path);
+
+    return failed;
+}
@@ -0,0 +1,864 @@
+//
+// Created by sarah on 3/21/24.
+//
+
+#include "parser/flat_ast.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define INITIAL_CAPACITY 64
+
+#define grow_array(array, count, capacity, needed) do { \
+        if ((count) + (needed) > (capacity)) { \
+            while ((count) + (needed) > (capacity)) (capacity) *= 2; \
+            void *new_array = realloc((array), sizeof(*(array)) * (capacity)); \
+            if (new_array == NULL) { \
+                fprintf(stderr, "Failed to grow flat AST!\n"); \
+                exit(1); \
+            } \
+            (array) = new_array; \
+        } \
+    } while (0)
+
+// Stack of node indices, for walking operator chains without recursion.
+typedef struct index_stack_t {
+    flat_index_t *items;
+    size_t size;
+    size_t capacity;
+} index_stack_t;
+
+static void index_stack_init(index_stack_t *stack) {
+    stack->size = 0;
+    stack->capacity = INITIAL_CAPACITY;
+    stack->items = (flat_index_t *) malloc(sizeof(flat_index_t) * stack->capacity);
+}
+
+static void index_stack_push(index_stack_t *stack, flat_index_t index) {
+    grow_array(stack->items, stack->size, stack->capacity, 1);
+    stack->items[stack->size++] = index;
+}
+
+#define index_stack_pop(stack) ((stack)->items[--(stack)->size])
+
+#define is_flat_operator(kind) ((kind) == FLAT_UNARY || (kind) == FLAT_BINARY || (kind) == FLAT_CAST)
+
+/*
+ * Shared by all operator chains of one flattening or expansion. Chains nested in calls and ifs are walked while an
+ * outer one is still in progress, so each walk only uses the part of the stacks above where it started.
+ */
+struct flat_scratch_t {
+    ptr_list_t *exprs; // The chain's order when flattening, the expanded operands when expanding
+    ptr_list_t *expr_stack;
+    index_stack_t indices; // The flattened operands when flattening, the chain's order when expanding
+    index_stack_t index_stack;
+};
+
+static void scratch_begin(flat_ast_t *ast) {
+    struct flat_scratch_t *scratch = (struct flat_scratch_t *) malloc(sizeof(struct flat_scratch_t));
+    scratch->exprs = ptr_list_new();
+    scratch->expr_stack = ptr_list_new();
+    index_stack_init(&scratch->indices);
+    index_stack_init(&scratch->index_stack);
+
+    ast->scratch = scratch;
+}
+
+static void scratch_end(flat_ast_t *ast) {
+    ptr_list_free(ast->scratch->exprs);
+    ptr_list_free(ast->scratch->expr_stack);
+    free(ast->scratch->indices.items);
+    free(ast->scratch->index_stack.items);
+    free(ast->scratch);
+
+    ast->scratch = NULL;
+}
+
+flat_ast_t *flat_ast_new() {
+    return flat_ast_new_capacity(INITIAL_CAPACITY, INITIAL_CAPACITY, INITIAL_CAPACITY);
+}
+
+flat_ast_t *flat_ast_new_capacity(flat_index_t nodes, flat_index_t lists, flat_index_t names) {
+    flat_ast_t *ast = (flat_ast_t *) malloc(sizeof(flat_ast_t));
+
+    // The arrays grow by doubling, which never gets anywhere from 0
+    ast->node_count = 0;
+    ast->node_capacity = nodes > 0 ? nodes : 1;
+    ast->nodes = (flat_node_t *) malloc(sizeof(flat_node_t) * ast->node_capacity);
+
+    ast->list_size = 0;
+    ast->list_capacity = lists > 0 ? lists : 1;
+    ast->lists = (flat_index_t *) malloc(sizeof(flat_index_t) * ast->list_capacity);
+
+    ast->name_count = 0;
+    ast->name_capacity = names > 0 ? names : 1;
+    ast->names = (char **) malloc(sizeof(char *) * ast->name_capacity);
+
+    ast->name_slots = NULL;
+    ast->name_slot_mask = 0;
+    ast->scratch = NULL;
+
+    ast->root = FLAT_NONE;
+
+    return ast;
+}
+
+void flat_ast_free(flat_ast_t *ast) {
+    free(ast->name_slots);
+    free(ast->nodes);
+    free(ast->lists);
+    free(ast->names);
+    free(ast);
+}
+
+int flat_ast_equal(flat_ast_t *a, flat_ast_t *b) {
+    // Flattening is deterministic and names are interned, so equal trees give equal arrays
+    return a->node_count == b->node_count && a->list_size == b->list_size && a->name_count == b->name_count
+           && a->root == b->root
+           && memcmp(a->nodes, b->nodes, a->node_count * sizeof(flat_node_t)) == 0
+           && memcmp(a->lists, b->lists, a->list_size * sizeof(flat_index_t)) == 0
+           && memcmp(a->names, b->names, a->name_count * sizeof(char *)) == 0;
+}
+
+size_t flat_ast_memory_size(flat_ast_t *ast) {
+    return sizeof(flat_ast_t)
+           + sizeof(flat_node_t) * ast->node_count
+           + sizeof(flat_index_t) * ast->list_size
+           + sizeof(char *) * ast->name_count;
+}
+
+/* Flattening */
+
+static flat_index_t push_node(flat_ast_t *ast, flat_kind_t kind, flat_index_t a, flat_index_t b, flat_index_t c) {
+    grow_array(ast->nodes, ast->node_count, ast->node_capacity, 1);
+
+    flat_node_t *node = &ast->nodes[ast->node_count];
+    node->kind = (uint8_t) kind;
+    node->flags = 0;
+    node->reserved = 0;
+    node->a = a;
+    node->b = b;
+    node->c = c;
+
+    return ast->node_count++;
+}
+
+#define hash_name(name) ((size_t) (((uintptr_t) (name) >> 3) * 2654435761u))
+
+static void grow_name_slots(flat_ast_t *ast) {
+    size_t slot_count = (ast->name_slot_mask + 1) * 2;
+
+    free(ast->name_slots);
+    ast->name_slots = (flat_index_t *) malloc(sizeof(flat_index_t) * slot_count);
+    ast->name_slot_mask = slot_count - 1;
+    memset(ast->name_slots, 0xFF, sizeof(flat_index_t) * slot_count);
+
+    flat_index_t i;
+    for (i = 0; i < ast->name_count; i++) {
+        size_t slot = hash_name(ast->names[i]) & ast->name_slot_mask;
+        while (ast->name_slots[slot] != FLAT_NONE) slot = (slot + 1) & ast->name_slot_mask;
+
+        ast->name_slots[slot] = i;
+    }
+}
+
+// Names are interned, so they can be deduplicated by pointer.
+static flat_index_t push_name(flat_ast_t *ast, char *name) {
+    if (name == NULL) return FLAT_NONE;
+
+    if (ast->name_count * 2 >= ast->name_slot_mask) {
+        grow_name_slots(ast);
+    }
+
+    size_t slot = hash_name(name) & ast->name_slot_mask;
+    while (ast->name_slots[slot] != FLAT_NONE) {
+        if (ast->names[ast->name_slots[slot]] == name) return ast->name_slots[slot];
+        slot = (slot + 1) & ast->name_slot_mask;
+    }
+
+    grow_array(ast->names, ast->name_count, ast->name_capacity, 1);
+    ast->names[ast->name_count] = name;
+    ast->name_slots[slot] = ast->name_count;
+
+    return ast->name_count++;
+}
+
+// Reserves a list of count children. The children have to be filled in with flat_ast_list_at.
+static flat_index_t reserve_list(flat_ast_t *ast, size_t count) {
+    grow_array(ast->lists, ast->list_size, ast->list_capacity, count + 1);
+
+    flat_index_t list = ast->list_size;
+    ast->lists[list] = (flat_index_t) count;
+    ast->list_size += count + 1;
+
+    return list;
+}
+
+static flat_index_t flatten_expr(flat_ast_t *ast, expr_t *expr);
+static flat_index_t flatten_stmt(flat_ast_t *ast, stmt_t *stmt);
+
+static flat_index_t flatten_stmt_list(flat_ast_t *ast, ptr_list_t *stmts) {
+    size_t count = ptr_list_size(stmts);
+    flat_index_t list = reserve_list(ast, count);
+
+    size_t i;
+    for (i = 0; i < count; i++) {
+        // Flattening the child may grow the list array, so don't hold on to a pointer into it
+        flat_index_t child = flatten_stmt(ast, (stmt_t *) ptr_list_at(stmts, i));
+        flat_ast_list_at(ast, list, i) = child;
+    }
+
+    return list;
+}
+
+static flat_index_t flatten_typed_value(flat_ast_t *ast, typed_ast_value_t *value) {
+    flat_index_t index = push_node(ast, FLAT_TYPED_VALUE, push_name(ast, value->name), push_name(ast, value->type), 0);
+    ast->nodes[index].flags = (uint8_t) value->flags;
+
+    return index;
+}
+
+static flat_index_t flatten_typed_value_list(flat_ast_t *ast, ptr_list_t *values) {
+    size_t count = ptr_list_size(values);
+    flat_index_t list = reserve_list(ast, count);
+
+    size_t i;
+    for (i = 0; i < count; i++) {
+        flat_index_t child = flatten_typed_value(ast, (typed_ast_value_t *) ptr_list_at(values, i));
+        flat_ast_list_at(ast, list, i) = child;
+    }
+
+    return list;
+}
+
+static flat_index_t flatten_prototype(flat_ast_t *ast, prototype_t *prototype) {
+    flat_index_t arguments = flatten_typed_value_list(ast, prototype->arguments);
+    flat_index_t name = push_name(ast, prototype->name);
+    flat_index_t return_type = push_name(ast, prototype->return_type);
+
+    flat_index_t index = push_node(ast, FLAT_PROTOTYPE, name, return_type, arguments);
+    ast->nodes[index].flags = (uint8_t) prototype->is_extern;
+
+    return index;
+}
+
+// Everything but operators.
+static flat_index_t flatten_operand(flat_ast_t *ast, expr_t *expr) {
+    flat_index_t a, b, c;
+    size_t i;
+    uint32_t words[2];
+    call_expr_data_t *call_data;
+    if_expr_data_t *if_data;
+
+    switch (expr->expr_type) {
+        case EXPR_BOOL:
+            return push_node(ast, FLAT_BOOL, (flat_index_t) ((bool_expr_t *) expr)->data, 0, 0);
+        case EXPR_INT:
+            memcpy(words, &((int_expr_t *) expr)->data, sizeof(int64_t));
+            return push_node(ast, FLAT_INT, words[0], words[1], push_name(ast, ((int_expr_t *) expr)->type));
+        case EXPR_FLOAT:
+            memcpy(words, ((float_expr_t *) expr)->data, sizeof(double));
+            return push_node(ast, FLAT_FLOAT, words[0], words[1], push_name(ast, ((float_expr_t *) expr)->type));
+        case EXPR_VARIABLE:
+            return push_node(ast, FLAT_VARIABLE, push_name(ast, ((variable_expr_t *) expr)->name), 0, 0);
+        case EXPR_CALL:
+            call_data = ((call_expr_t *) expr)->data;
+            b = reserve_list(ast, ptr_list_size(call_data->arguments));
+            for (i = 0; i < ptr_list_size(call_data->arguments); i++) {
+                flat_index_t arg = flatten_expr(ast, (expr_t *) ptr_list_at_unchecked(call_data->arguments, i));
+                flat_ast_list_at(ast, b, i) = arg;
+            }
+            return push_node(ast, FLAT_CALL, push_name(ast, call_data->callee_name), b, 0);
+        case EXPR_IF:
+            if_data = ((if_expr_t *) expr)->data;
+            a = flatten_expr(ast, if_data->condition);
+            b = flatten_stmt_list(ast, if_data->then_stmts);
+            c = if_data->else_stmts != NULL ? flatten_stmt_list(ast, if_data->else_stmts) : FLAT_NONE;
+            return push_node(ast, FLAT_IF, a, b, c);
+        default:
+            break;
+    }
+
+    return FLAT_NONE;
+}
+
+// Operator chains are flattened without recursion, see collect_operator_chain.
+static flat_index_t flatten_expr(flat_ast_t *ast, expr_t *expr) {
+    flat_index_t a, b, c;
+    unary_expr_data_t *unary_data;
+    binary_expr_data_t *binary_data;
+    cast_expr_data_t *cast_data;
+
+    if (!is_operator_expr(expr)) return flatten_operand(ast, expr);
+
+    ptr_list_t *order = ast->scratch->exprs;
+    index_stack_t *values = &ast->scratch->indices;
+
+    size_t order_base = ptr_list_size(order);
+    collect_operator_chain(expr, order, ast->scratch->expr_stack);
+
+    size_t i = ptr_list_size(order);
+    while (i-- > order_base) {
+        expr_t *node = (expr_t *) ptr_list_at_unchecked(order, i);
+        flat_index_t index;
+
+        switch (node->expr_type) {
+            case EXPR_UNARY:
+                unary_data = ((unary_expr_t *) node)->data;
+                b = index_stack_pop(values);
+                index = push_node(ast, FLAT_UNARY, (flat_index_t) unary_data->op, b, 0);
+                break;
+            case EXPR_BINARY:
+                binary_data = ((binary_expr_t *) node)->data;
+                c = index_stack_pop(values);
+                b = index_stack_pop(values);
+                index = push_node(ast, FLAT_BINARY, (flat_index_t) binary_data->op, b, c);
+                break;
+            case EXPR_CAST:
+                cast_data = ((cast_expr_t *) node)->data;
+                a = index_stack_pop(values);
+                index = push_node(ast, FLAT_CAST, a, push_name(ast, cast_data->type), 0);
+                break;
+            default:
+                index = flatten_operand(ast, node);
+                break;
+        }
+
+        index_stack_push(values, index);
+    }
+
+    ptr_list_truncate(order, order_base);
+    return index_stack_pop(values);
+}
+
+static flat_index_t flatten_stmt(flat_ast_t *ast, stmt_t *stmt) {
+    flat_index_t a, b, c;
+    function_stmt_data_t *func_data;
+    assignment_stmt_data_t *ass_data;
+    while_stmt_data_t *while_data;
+    declaration_stmt_data_t *declaration_data;
+
+    switch (stmt->stmt_type) {
+        case STMT_RETURN:
+            return push_node(ast, FLAT_RETURN, flatten_expr(ast, ((return_stmt_t *) stmt)->value), 0, 0);
+        case STMT_EXPR:
+            return push_node(ast, FLAT_EXPR, flatten_expr(ast, ((expr_stmt_t *) stmt)->expr), 0, 0);
+        case STMT_FUNCTION:
+            func_data = ((function_stmt_t *) stmt)->data;
+            a = flatten_prototype(ast, func_data->prototype);
+            b = flatten_typed_value_list(ast, func_data->variables);
+            c = flatten_stmt_list(ast, func_data->body);
+            return push_node(ast, FLAT_FUNCTION, a, b, c);
+        case STMT_EXTERN:
+            return push_node(ast, FLAT_EXTERN, flatten_prototype(ast, ((extern_stmt_t *) stmt)->prototype), 0, 0);
+        case STMT_ASSIGNMENT:
+            ass_data = ((assignment_stmt_t *) stmt)->data;
+            b = flatten_expr(ast, ass_data->value);
+            return push_node(ast, FLAT_ASSIGNMENT, push_name(ast, ass_data->name), b, 0);
+        case STMT_WHILE:
+            while_data = ((while_stmt_t *) stmt)->data;
+            a = flatten_expr(ast, while_data->condition);
+            b = flatten_stmt_list(ast, while_data->body);
+            return push_node(ast, FLAT_WHILE, a, b, 0);
+        case STMT_DECLARATION:
+            declaration_data = ((declaration_stmt_t *) stmt)->data;
+            a = flatten_typed_value(ast, declaration_data->variable);
+            b = declaration_data->value != NULL ? flatten_expr(ast, declaration_data->value) : FLAT_NONE;
+            return push_node(ast, FLAT_DECLARATION, a, b, (flat_index_t) declaration_data->index);
+    }
+
+    return FLAT_NONE;
+}
+
+flat_ast_t *flat_ast_from_stmts(ptr_list_t *stmts) {
+    flat_ast_t *ast = flat_ast_new();
+    ast->name_slot_mask = INITIAL_CAPACITY - 1;
+    grow_name_slots(ast);
+    scratch_begin(ast);
+
+    ast->root = flatten_stmt_list(ast, stmts);
+
+    scratch_end(ast);
+    free(ast->name_slots);
+    ast->name_slots = NULL;
+    ast->name_slot_mask = 0;
+
+    return ast;
+}
+
+/* Expanding */
+
+// Same layout the parser produces: nodes with a data payload get it right behind them.
+#define new_node(node_type) ((node_type *) arena_alloc(arena, sizeof(node_type)))
+#define new_node_with_data(node, node_type, data_type) do { \
+        (node) = (node_type *) arena_alloc(arena, sizeof(node_type) + sizeof(data_type)); \
+        (node)->data = (data_type *) ((node) + 1); \
+    } while (0)
+
+#define name_or_null(ast, i) ((i) == FLAT_NONE ? NULL : flat_ast_name(ast, i))
+
+static expr_t *expand_expr(flat_ast_t *ast, flat_index_t index, arena_t *arena);
+static ptr_list_t *expand_stmt_list(flat_ast_t *ast, flat_index_t list, arena_t *arena);
+
+static typed_ast_value_t *expand_typed_value(flat_ast_t *ast, flat_index_t index, arena_t *arena) {
+    flat_node_t *node = flat_ast_node(ast, index);
+
+    typed_ast_value_t *value = new_node(typed_ast_value_t);
+    value->name = flat_ast_name(ast, node->a);
+    value->type = flat_ast_name(ast, node->b);
+    value->flags = (variable_flags_t) node->flags;
+
+    return value;
+}
+
+static ptr_list_t *expand_typed_value_list(flat_ast_t *ast, flat_index_t list, arena_t *arena) {
+    ptr_list_t *values = ptr_list_new_arena(arena, flat_ast_list_size(ast, list));
+
+    flat_index_t i;
+    for (i = 0; i < flat_ast_list_size(ast, list); i++) {
+        ptr_list_push(values, expand_typed_value(ast, flat_ast_list_at(ast, list, i), arena));
+    }
+
+    return values;
+}
+
+static prototype_t *expand_prototype(flat_ast_t *ast, flat_index_t index, arena_t *arena) {
+    flat_node_t *node = flat_ast_node(ast, index);
+
+    prototype_t *prototype = new_node(prototype_t);
+    prototype->name = flat_ast_name(ast, node->a);
+    prototype->return_type = name_or_null(ast, node->b);
+    prototype->arguments = expand_typed_value_list(ast, node->c, arena);
+    prototype->is_extern = node->flags;
+
+    return prototype;
+}
+
+// Everything but operators.
+static expr_t *expand_operand(flat_ast_t *ast, flat_index_t index, arena_t *arena) {
+    flat_node_t *node = flat_ast_node(ast, index);
+    flat_index_t i;
+    uint32_t words[2];
+
+    bool_expr_t *bool_expr;
+    int_expr_t *int_expr;
+    float_expr_t *float_expr;
+    variable_expr_t *variable_expr;
+    call_expr_t *call_expr;
+    if_expr_t *if_expr;
+
+    switch ((flat_kind_t) node->kind) {
+        case FLAT_BOOL:
+            bool_expr = new_node(bool_expr_t);
+            bool_expr->expr_type = EXPR_BOOL;
+            bool_expr->checked_type = NULL;
+            bool_expr->data = (int) node->a;
+            return (expr_t *) bool_expr;
+        case FLAT_INT:
+            int_expr = new_node(int_expr_t);
+            int_expr->expr_type = EXPR_INT;
+            int_expr->checked_type = NULL;
+            int_expr->type = name_or_null(ast, node->c);
+            words[0] = node->a;
+            words[1] = node->b;
+            memcpy(&int_expr->data, words, sizeof(int64_t));
+            return (expr_t *) int_expr;
+        case FLAT_FLOAT:
+            new_node_with_data(float_expr, float_expr_t, double);
+            float_expr->expr_type = EXPR_FLOAT;
+            float_expr->checked_type = NULL;
+            float_expr->type = name_or_null(ast, node->c);
+            words[0] = node->a;
+            words[1] = node->b;
+            memcpy(float_expr->data, words, sizeof(double));
+            return (expr_t *) float_expr;
+        case FLAT_VARIABLE:
+            variable_expr = new_node(variable_expr_t);
+            variable_expr->expr_type = EXPR_VARIABLE;
+            variable_expr->checked_type = NULL;
+            variable_expr->name = flat_ast_name(ast, node->a);
+            variable_expr->slot = SLOT_NONE;
+            return (expr_t *) variable_expr;
+        case FLAT_CALL:
+            new_node_with_data(call_expr, call_expr_t, call_expr_data_t);
+            call_expr->expr_type = EXPR_CALL;
+            call_expr->checked_type = NULL;
+            call_expr->data->callee_name = flat_ast_name(ast, node->a);
+            call_expr->data->callee = NULL;
+            call_expr->data->arguments = ptr_list_new_arena(arena, flat_ast_list_size(ast, node->b));
+            for (i = 0; i < flat_ast_list_size(ast, node->b); i++) {
+                ptr_list_push(call_expr->data->arguments, expand_expr(ast, flat_ast_list_at(ast, node->b, i), arena));
+            }
+            return (expr_t *) call_expr;
+        case FLAT_IF:
+            new_node_with_data(if_expr, if_expr_t, if_expr_data_t);
+            if_expr->expr_type = EXPR_IF;
+            if_expr->checked_type = NULL;
+            if_expr->data->condition = expand_expr(ast, node->a, arena);
+            if_expr->data->then_stmts = expand_stmt_list(ast, node->b, arena);
+            if_expr->data->else_stmts = node->c != FLAT_NONE ? expand_stmt_list(ast, node->c, arena) : NULL;
+            return (expr_t *) if_expr;
+        default:
+            break;
+    }
+
+    fprintf(stderr, "Flat AST node %u is not an expression!\n", index);
+    return NULL;
+}
+
+// Operator chains are expanded without recursion, visiting the nodes in the same order as collect_operator_chain.
+static expr_t *expand_expr(flat_ast_t *ast, flat_index_t index, arena_t *arena) {
+    flat_node_t *node;
+    unary_expr_t *unary_expr;
+    binary_expr_t *binary_expr;
+    cast_expr_t *cast_expr;
+
+    if (!is_flat_operator(flat_ast_node(ast, index)->kind)) return expand_operand(ast, index, arena);
+
+    index_stack_t *stack = &ast->scratch->index_stack;
+    index_stack_t *order = &ast->scratch->indices;
+    ptr_list_t *values = ast->scratch->exprs; // List<expr_t *>
+
+    size_t order_base = order->size;
+    index_stack_push(stack, index);
+    while (stack->size > 0) {
+        flat_index_t current = index_stack_pop(stack);
+        index_stack_push(order, current);
+
+        node = flat_ast_node(ast, current);
+        if (node->kind == FLAT_UNARY) {
+            index_stack_push(stack, node->b);
+        } else if (node->kind == FLAT_BINARY) {
+            index_stack_push(stack, node->b);
+            index_stack_push(stack, node->c);
+        } else if (node->kind == FLAT_CAST) {
+            index_stack_push(stack, node->a);
+        }
+    }
+
+    size_t i = order->size;
+    while (i-- > order_base) {
+        flat_index_t current = order->items[i];
+        node = flat_ast_node(ast, current);
+
+        expr_t *expr;
+        switch ((flat_kind_t) node->kind) {
+            case FLAT_UNARY:
+                new_node_with_data(unary_expr, unary_expr_t, unary_expr_data_t);
+                unary_expr->expr_type = EXPR_UNARY;
+                unary_expr->checked_type = NULL;
+                unary_expr->data->op = (operator_t) node->a;
+                unary_expr->data->value = (expr_t *) ptr_list_pop(values);
+                expr = (expr_t *) unary_expr;
+                break;
+            case FLAT_BINARY:
+                new_node_with_data(binary_expr, binary_expr_t, binary_expr_data_t);
+                binary_expr->expr_type = EXPR_BINARY;
+                binary_expr->checked_type = NULL;
+                binary_expr->data->op = (operator_t) node->a;
+                binary_expr->data->operand_type = NULL;
+                binary_expr->data->rhs = (expr_t *) ptr_list_pop(values);
+                binary_expr->data->lhs = (expr_t *) ptr_list_pop(values);
+                expr = (expr_t *) binary_expr;
+                break;
+            case FLAT_CAST:
+                new_node_with_data(cast_expr, cast_expr_t, cast_expr_data_t);
+                cast_expr->expr_type = EXPR_CAST;
+                cast_expr->checked_type = NULL;
+                cast_expr->data->value = (expr_t *) ptr_list_pop(values);
+                cast_expr->data->type = flat_ast_name(ast, node->b);
+                expr = (expr_t *) cast_expr;
+                break;
+            default:
+                expr = expand_operand(ast, current, arena);
+                break;
+        }
+
+        ptr_list_push(values, expr);
+    }
+
+    order->size = order_base;
+    return (expr_t *) ptr_list_pop(values);
+}
+
+static stmt_t *expand_stmt(flat_ast_t *ast, flat_index_t index, arena_t *arena) {
+    flat_node_t *node = flat_ast_node(ast, index);
+
+    stmt_t *stmt;
+    function_stmt_t *function_stmt;
+    extern_stmt_t *extern_stmt;
+    assignment_stmt_t *assignment_stmt;
+    while_stmt_t *while_stmt;
+    declaration_stmt_t *declaration_stmt;
+
+    switch ((flat_kind_t) node->kind) {
+        case FLAT_RETURN:
+        case FLAT_EXPR:
+            stmt = new_node(stmt_t);
+            stmt->stmt_type = node->kind == FLAT_RETURN ? STMT_RETURN : STMT_EXPR;
+            stmt->data = expand_expr(ast, node->a, arena);
+            return stmt;
+        case FLAT_FUNCTION:
+            new_node_with_data(function_stmt, function_stmt_t, function_stmt_data_t);
+            function_stmt->stmt_type = STMT_FUNCTION;
+            function_stmt->data->prototype = expand_prototype(ast, node->a, arena);
+            function_stmt->data->variables = expand_typed_value_list(ast, node->b, arena);
+            function_stmt->data->body = expand_stmt_list(ast, node->c, arena);
+            return (stmt_t *) function_stmt;
+        case FLAT_EXTERN:
+            extern_stmt = new_node(extern_stmt_t);
+            extern_stmt->stmt_type = STMT_EXTERN;
+            extern_stmt->prototype = expand_prototype(ast, node->a, arena);
+            return (stmt_t *) extern_stmt;
+        case FLAT_ASSIGNMENT:
+            new_node_with_data(assignment_stmt, assignment_stmt_t, assignment_stmt_data_t);
+            assignment_stmt->stmt_type = STMT_ASSIGNMENT;
+            assignment_stmt->data->name = flat_ast_name(ast, node->a);
+            assignment_stmt->data->slot = SLOT_NONE;
+            assignment_stmt->data->value = expand_expr(ast, node->b, arena);
+            return (stmt_t *) assignment_stmt;
+        case FLAT_WHILE:
+            new_node_with_data(while_stmt, while_stmt_t, while_stmt_data_t);
+            while_stmt->stmt_type = STMT_WHILE;
+            while_stmt->data->condition = expand_expr(ast, node->a, arena);
+            while_stmt->data->body = expand_stmt_list(ast, node->b, arena);
+            return (stmt_t *) while_stmt;
+        case FLAT_DECLARATION:
+            new_node_with_data(declaration_stmt, declaration_stmt_t, declaration_stmt_data_t);
+            declaration_stmt->stmt_type = STMT_DECLARATION;
+            declaration_stmt->data->variable = expand_typed_value(ast, node->a, arena);
+            declaration_stmt->data->index = node->c;
+            declaration_stmt->data->slot = SLOT_NONE;
+            declaration_stmt->data->value = node->b != FLAT_NONE ? expand_expr(ast, node->b, arena) : NULL;
+            return (stmt_t *) declaration_stmt;
+        default:
+            break;
+    }
+
+    fprintf(stderr, "Flat AST node %u is not a statement!\n", index);
+    return NULL;
+}
+
+static ptr_list_t *expand_stmt_list(flat_ast_t *ast, flat_index_t list, arena_t *arena) {
+    ptr_list_t *stmts = ptr_list_new_arena(arena, flat_ast_list_size(ast, list));
+
+    flat_index_t i;
+    for (i = 0; i < flat_ast_list_size(ast, list); i++) {
+        ptr_list_push(stmts, expand_stmt(ast, flat_ast_list_at(ast, list, i), arena));
+    }
+
+    return stmts;
+}
+
+ptr_list_t *flat_ast_expand(flat_ast_t *ast, arena_t *arena) {
+    scratch_begin(ast);
+    ptr_list_t *stmts = expand_stmt_list(ast, ast->root, arena);
+    scratch_end(ast);
+
+    return stmts;
+}
+
+/* Printing */
+
+static void print_indent(int indent) {
+    int i;
+    for (i = 0; i < indent; i++) {
+        printf("%c", ' ');
+    }
+}
+
+static void print_node(flat_ast_t *ast, flat_index_t index, int indent);
+
+static void print_list(flat_ast_t *ast, flat_index_t list, int indent) {
+    flat_index_t i;
+    for (i = 0; i < flat_ast_list_size(ast, list); i++) {
+        print_node(ast, flat_ast_list_at(ast, list, i), indent);
+    }
+}
+
+static void print_typed_values(flat_ast_t *ast, flat_index_t list, int indent) {
+    flat_index_t i;
+    for (i = 0; i < flat_ast_list_size(ast, list); i++) {
+        flat_node_t *value = flat_ast_node(ast, flat_ast_list_at(ast, list, i));
+        print_indent(indent);
+        printf("%s (%s)\n", flat_ast_name(ast, value->a), flat_ast_name(ast, value->b));
+    }
+}
+
+static void print_prototype(flat_ast_t *ast, flat_node_t *prototype, int indent) {
+    print_indent(indent);
+    printf("Name: %s\n", flat_ast_name(ast, prototype->a));
+    print_indent(indent);
+    printf("Return type: %s\n", name_or_null(ast, prototype->b));
+    print_indent(indent);
+    printf("Is extern: %s\n", prototype->flags ? "yes" : "no");
+    print_indent(indent);
+    printf("Arguments: (%u)\n", flat_ast_list_size(ast, prototype->c));
+    print_typed_values(ast, prototype->c, indent + 2);
+}
+
+static void print_number_type(flat_ast_t *ast, flat_index_t type) {
+    if (type != FLAT_NONE) {
+        printf(" (%s)", flat_ast_name(ast, type));
+    }
+    printf("\n");
+}
+
+// Prints the line of the node itself. The operands of operators are left to print_node.
+static void print_single_node(flat_ast_t *ast, flat_index_t index, int indent) {
+    flat_node_t *node = flat_ast_node(ast, index);
+    uint32_t words[2];
+    int64_t int_value;
+    double value;
+    flat_node_t *typed_value;
+
+    print_indent(indent);
+
+    switch ((flat_kind_t) node->kind) {
+        case FLAT_BOOL:
+            printf("Bool: %s\n", node->a ? "true" : "false");
+            break;
+        case FLAT_INT:
+            words[0] = node->a;
+            words[1] = node->b;
+            memcpy(&int_value, words, sizeof(int64_t));
+            printf("Int: %lld", (long long) int_value);
+            print_number_type(ast, node->c);
+            break;
+        case FLAT_FLOAT:
+            words[0] = node->a;
+            words[1] = node->b;
+            memcpy(&value, words, sizeof(double));
+            printf("Float: %lf", value);
+            print_number_type(ast, node->c);
+            break;
+        case FLAT_VARIABLE:
+            printf("Variable: %s\n", flat_ast_name(ast, node->a));
+            break;
+        case FLAT_UNARY:
+            printf("Unary expression: %s\n", operator_spelling((operator_t) node->a));
+            break;
+        case FLAT_BINARY:
+            printf("Binary expression: %s\n", operator_spelling((operator_t) node->a));
+            break;
+        case FLAT_CALL:
+            printf("Call: %s\n", flat_ast_name(ast, node->a));
+            print_list(ast, node->b, indent + 2);
+            break;
+        case FLAT_IF:
+            printf("If\n");
+
+            print_indent(indent + 2);
+            printf("Condition:\n");
+            print_node(ast, node->a, indent + 4);
+
+            print_indent(indent + 2);
+            printf("Then: (Statements: %u)\n", flat_ast_list_size(ast, node->b));
+            print_list(ast, node->b, indent + 4);
+
+            if (node->c != FLAT_NONE) {
+                print_indent(indent + 2);
+                printf("Else: (Statements: %u)\n", flat_ast_list_size(ast, node->c));
+                print_list(ast, node->c, indent + 4);
+            }
+            break;
+        case FLAT_CAST:
+            printf("Cast to %s\n", flat_ast_name(ast, node->b));
+            break;
+        case FLAT_RETURN:
+            printf("Return\n");
+            print_node(ast, node->a, indent + 2);
+            break;
+        case FLAT_EXPR:
+            printf("Expr\n");
+            print_node(ast, node->a, indent + 2);
+            break;
+        case FLAT_FUNCTION:
+            printf("Function\n");
+
+            print_indent(indent + 2);
+            printf("Prototype:\n");
+            print_prototype(ast, flat_ast_node(ast, node->a), indent + 4);
+
+            print_indent(indent + 2);
+            printf("Variables: (%u)\n", flat_ast_list_size(ast, node->b));
+            print_typed_values(ast, node->b, indent + 4);
+
+            print_indent(indent + 2);
+            printf("Body:\n");
+            print_list(ast, node->c, indent + 4);
+            break;
+        case FLAT_EXTERN:
+            printf("Extern\n");
+            print_prototype(ast, flat_ast_node(ast, node->a), indent + 2);
+            break;
+        case FLAT_ASSIGNMENT:
+            printf("Assignment to %s\n", flat_ast_name(ast, node->a));
+            print_node(ast, node->b, indent + 2);
+            break;
+        case FLAT_WHILE:
+            printf("While\n");
+
+            print_indent(indent + 2);
+            printf("Condition:\n");
+            print_node(ast, node->a, indent + 4);
+
+            print_indent(indent + 2);
+            printf("Body:\n");
+            print_list(ast, node->b, indent + 4);
+            break;
+        case FLAT_DECLARATION:
+            typed_value = flat_ast_node(ast, node->a);
+            printf("Declaration of %s (%s)\n",
+                    flat_ast_name(ast, typed_value->a), flat_ast_name(ast, typed_value->b));
+            if (node->b != FLAT_NONE) {
+                print_node(ast, node->b, indent + 2);
+            }
+            break;
+        case FLAT_PROTOTYPE:
+        case FLAT_TYPED_VALUE:
+            break;
+    }
+}
+
+// Operator chains are printed without recursion, the stack holds pairs of node index and indent.
+static void print_node(flat_ast_t *ast, flat_index_t index, int indent) {
+    if (!is_flat_operator(flat_ast_node(ast, index)->kind)) {
+        print_single_node(ast, index, indent);
+        return;
+    }
+
+    index_stack_t stack;
+    index_stack_init(&stack);
+    index_stack_push(&stack, index);
+    index_stack_push(&stack, (flat_index_t) indent);
+
+    while (stack.size > 0) {
+        int current_indent = (int) index_stack_pop(&stack);
+        flat_index_t current = index_stack_pop(&stack);
+        flat_node_t *node = flat_ast_node(ast, current);
+
+        print_single_node(ast, current, current_indent);
+
+        // Pushed in reverse, so the left hand side is printed first
+        if (node->kind == FLAT_UNARY) {
+            index_stack_push(&stack, node->b);
+            index_stack_push(&stack, (flat_index_t) (current_indent + 2));
+        } else if (node->kind == FLAT_BINARY) {
+            index_stack_push(&stack, node->c);
+            index_stack_push(&stack, (flat_index_t) (current_indent + 2));
+            index_stack_push(&stack, node->b);
+            index_stack_push(&stack, (flat_index_t) (current_indent + 2));
+        } else if (node->kind == FLAT_CAST) {
+            index_stack_push(&stack, node->a);
+            index_stack_push(&stack, (flat_index_t) (current_indent + 2));
+        }
+    }
+
+    free(stack.items);
+}
+
+void flat_ast_print(flat_ast_t *ast) {
+    print_list(ast, ast->root, 0);
+}
@@ -0,0 +1,400 @@
+//
+// Created by sarah on 3/24/24.
+//
+
+#include "parser/incremental.h"
+#include "parser/parser.h"
+#include "parser/flat_ast.h"
+#include "lexer/lexer.h"
+#include "../util/arena.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Every parse allocates its statements from a new arena, a generation. Statements that survive later edits keep
+ * their generation alive, so each one counts the top level statements still using it.
+ */
+typedef struct ast_generation_t {
+    arena_t *arena;
+    size_t stmt_count;
+} ast_generation_t;
+
+typedef struct top_level_entry_t {
+    stmt_t *stmt;
+    size_t first_token;
+    ast_generation_t *generation;
+} top_level_entry_t;
+
+struct incremental_parser_t {
+    const char *input;
+    size_t size;
+    token_stream_t *tokens; // NULL if there is nothing to update incrementally
+
+    top_level_entry_t *entries;
+    size_t entry_count;
+
+    ptr_list_t *stmts; // List<stmt_t *>
+    ptr_list_t *changed; // List<stmt_t *>
+    ptr_list_t *removed; // List<char *>
+};
+
+/* Statements of one parse of a token range, before they are matched against the old ones */
+typedef struct parsed_range_t {
+    top_level_entry_t *entries;
+    size_t count;
+    ast_generation_t *generation;
+} parsed_range_t;
+
+static void *checked_malloc(size_t size) {
+    void *ptr = malloc(size);
+    if (ptr == NULL) {
+        fprintf(stderr, "Out of memory in incremental parser!\n");
+        exit(1);
+    }
+
+    return ptr;
+}
+
+static ast_generation_t *generation_new() {
+    ast_generation_t *generation = (ast_generation_t *) checked_malloc(sizeof(ast_generation_t));
+    generation->arena = arena_new();
+    generation->stmt_count = 0;
+
+    return generation;
+}
+
+static void generation_release(ast_generation_t *generation) {
+    if (generation->stmt_count-- > 1) return;
+
+    arena_free(generation->arena);
+    free(generation);
+}
+
+incremental_parser_t *incremental_parser_new() {
+    incremental_parser_t *parser = (incremental_parser_t *) checked_malloc(sizeof(incremental_parser_t));
+
+    parser->input = NULL;
+    parser->size = 0;
+    parser->tokens = NULL;
+    parser->entries = NULL;
+    parser->entry_count = 0;
+    parser->stmts = ptr_list_new();
+    parser->changed = ptr_list_new();
+    parser->removed = ptr_list_new();
+
+    return parser;
+}
+
+void incremental_parser_free(incremental_parser_t *parser) {
+    size_t i;
+    for (i = 0; i < parser->entry_count; i++) {
+        generation_release(parser->entries[i].generation);
+    }
+
+    if (parser->tokens != NULL) token_stream_free(parser->tokens);
+    free(parser->entries);
+    ptr_list_free(parser->stmts);
+    ptr_list_free(parser->changed);
+    ptr_list_free(parser->removed);
+    free(parser);
+}
+
+static char *stmt_name(stmt_t *stmt) {
+    if (stmt->stmt_type == STMT_FUNCTION) return ((function_stmt_t *) stmt)->data->prototype->name;
+    return ((extern_stmt_t *) stmt)->prototype->name;
+}
+
+static flat_ast_t *flatten_stmt(stmt_t *stmt) {
+    ptr_list_t *stmts = ptr_list_new();
+    ptr_list_push(stmts, stmt);
+
+    flat_ast_t *ast = flat_ast_from_stmts(stmts);
+    ptr_list_free(stmts);
+
+    return ast;
+}
+
+static int stmts_equal(stmt_t *a, stmt_t *b) {
+    if (a->stmt_type != b->stmt_type) return 0;
+
+    flat_ast_t *flat_a = flatten_stmt(a);
+    flat_ast_t *flat_b = flatten_stmt(b);
+    int equal = flat_ast_equal(flat_a, flat_b);
+
+    flat_ast_free(flat_a);
+    flat_ast_free(flat_b);
+
+    return equal;
+}
+
+// Moves the bodies of function statements along when their tokens shift.
+static void move_entry(top_level_entry_t *entry, size_t first_token) {
+    if (entry->stmt->stmt_type == STMT_FUNCTION) {
+        ((function_stmt_t *) entry->stmt)->data->body_token += first_token - entry->first_token;
+    }
+
+    entry->first_token = first_token;
+}
+
+/*
+ * Parses the top level statements in tokens [start, end). Fails if they don't end exactly at end, which happens when
+ * an edit breaks the statement in front of the range boundary.
+ */
+static int parse_range(token_stream_t *tokens, size_t start, size_t end, int is_quiet, parsed_range_t *range) {
+    size_t capacity = 16;
+    range->entries = (top_level_entry_t *) checked_malloc(capacity * sizeof(top_level_entry_t));
+    range->count = 0;
+    range->generation = generation_new();
+
+    parser_t *parser = parser_new(tokens, range->generation->arena);
+    parser_set_quiet(parser, is_quiet);
+    parser_seek(parser, start);
+
+    int failed = 0;
+    while (parser_position(parser) < end) {
+        size_t first_token = parser_position(parser);
+
+        stmt_t *stmt = parser_parse_next(parser);
+        if (stmt == NULL) {
+            failed = 1;
+            break;
+        }
+
+        if (range->count == capacity) {
+            capacity *= 2;
+            range->entries = (top_level_entry_t *) realloc(range->entries, capacity * sizeof(top_level_entry_t));
+        }
+
+        top_level_entry_t *entry = &range->entries[range->count++];
+        entry->stmt = stmt;
+        entry->first_token = first_token;
+        entry->generation = range->generation;
+    }
+
+    if (parser_position(parser) != end) failed = 1;
+    parser_free(parser);
+
+    if (failed) {
+        arena_free(range->generation->arena);
+        free(range->generation);
+        free(range->entries);
+    }
+
+    return failed;
+}
+
+// Old statements by name, an open addressing table of indices into the replaced entries.
+typedef struct name_table_t {
+    size_t *slots;
+    size_t mask;
+} name_table_t;
+
+#define NAME_TABLE_EMPTY ((size_t) -1)
+#define hash_name(name) ((size_t) (((uintptr_t) (name) >> 3) * 2654435761u))
+
+static void name_table_init(name_table_t *table, top_level_entry_t *entries, size_t count) {
+    size_t capacity = 16;
+    while (capacity < count * 2) capacity *= 2;
+
+    table->slots = (size_t *) checked_malloc(capacity * sizeof(size_t));
+    table->mask = capacity - 1;
+    memset(table->slots, 0xFF, capacity * sizeof(size_t));
+
+    size_t i;
+    for (i = 0; i < count; i++) {
+        size_t slot = hash_name(stmt_name(entries[i].stmt)) & table->mask;
+        while (table->slots[slot] != NAME_TABLE_EMPTY) slot = (slot + 1) & table->mask;
+
+        table->slots[slot] = i;
+    }
+}
+
+// First old statement called name that hasn't been matched yet, or NAME_TABLE_EMPTY.
+static size_t name_table_find(name_table_t *table, top_level_entry_t *entries, char *matched, char *name) {
+    size_t slot = hash_name(name) & table->mask;
+
+    while (table->slots[slot] != NAME_TABLE_EMPTY) {
+        size_t i = table->slots[slot];
+        if (!matched[i] && stmt_name(entries[i].stmt) == name) return i;
+
+        slot = (slot + 1) & table->mask;
+    }
+
+    return NAME_TABLE_EMPTY;
+}
+
+/*
+ * Replaces the entries [first, last) with the newly parsed range. New statements that are equal to an old one of the
+ * same name are dropped in favour of the old one, everything else is reported as changed or removed.
+ */
+static void replace_entries(incremental_parser_t *parser, size_t first, size_t last, parsed_range_t *range,
+                            long token_delta) {
+    top_level_entry_t *old_entries = parser->entries + first;
+    size_t old_count = last - first;
+    size_t tail = parser->entry_count - last;
+
+    char *matched = (char *) calloc(old_count + 1, 1);
+    name_table_t table;
+    name_table_init(&table, old_entries, old_count);
+
+    ptr_list_clear(parser->changed);
+    ptr_list_clear(parser->removed);
+
+    size_t i;
+    for (i = 0; i < range->count; i++) {
+        top_level_entry_t *entry = &range->entries[i];
+        size_t old = name_table_find(&table, old_entries, matched, stmt_name(entry->stmt));
+
+        if (old != NAME_TABLE_EMPTY) {
+            matched[old] = 1;
+
+            if (stmts_equal(old_entries[old].stmt, entry->stmt)) {
+                size_t first_token = entry->first_token;
+                *entry = old_entries[old];
+                move_entry(entry, first_token);
+                continue;
+            }
+
+            generation_release(old_entries[old].generation);
+        }
+
+        range->generation->stmt_count++;
+        ptr_list_push(parser->changed, entry->stmt);
+    }
+
+    for (i = 0; i < old_count; i++) {
+        if (matched[i]) continue;
+
+        ptr_list_push(parser->removed, stmt_name(old_entries[i].stmt));
+        generation_release(old_entries[i].generation);
+    }
+
+    free(table.slots);
+    free(matched);
+
+    if (range->generation->stmt_count == 0) {
+        arena_free(range->generation->arena);
+        free(range->generation);
+    }
+
+    // Splice the range into the entries and move the ones behind it to their new tokens
+    size_t entry_count = first + range->count + tail;
+    top_level_entry_t *entries = (top_level_entry_t *) checked_malloc((entry_count + 1) * sizeof(top_level_entry_t));
+
+    memcpy(entries, parser->entries, first * sizeof(top_level_entry_t));
+    memcpy(entries + first, range->entries, range->count * sizeof(top_level_entry_t));
+    memcpy(entries + first + range->count, parser->entries + last, tail * sizeof(top_level_entry_t));
+
+    for (i = first + range->count; i < entry_count; i++) {
+        move_entry(&entries[i], (size_t) ((long) entries[i].first_token + token_delta));
+    }
+
+    free(parser->entries);
+    free(range->entries);
+    parser->entries = entries;
+    parser->entry_count = entry_count;
+
+    ptr_list_clear(parser->stmts);
+    for (i = 0; i < entry_count; i++) {
+        ptr_list_push(parser->stmts, entries[i].stmt);
+    }
+}
+
+static int fail(incremental_parser_t *parser) {
+    if (parser->tokens != NULL) token_stream_free(parser->tokens);
+    parser->tokens = NULL;
+
+    ptr_list_clear(parser->changed);
+    ptr_list_clear(parser->removed);
+
+    return 1;
+}
+
+int incremental_parser_parse(incremental_parser_t *parser, const char *input, size_t size) {
+    lexer_t *lexer = lexer_new(input, size);
+    if (lexer == NULL) return fail(parser);
+
+    lexer_lex_all(lexer);
+    token_stream_t *tokens = lexer_get_tokens(lexer);
+    lexer_free(lexer);
+
+    parsed_range_t range;
+    if (parse_range(tokens, 0, tokens->size - 1, 0, &range)) {
+        token_stream_free(tokens);
+        return fail(parser);
+    }
+
+    if (parser->tokens != NULL) token_stream_free(parser->tokens);
+    parser->input = input;
+    parser->size = size;
+    parser->tokens = tokens;
+
+    replace_entries(parser, 0, parser->entry_count, &range, 0);
+    return 0;
+}
+
+// Where the text and tokens of entry i start. The first entry also covers everything in front of it.
+#define entry_start_token(parser, i) ((i) == 0 ? 0 : (parser)->entries[i].first_token)
+#define entry_start_offset(parser, i) ((i) == 0 ? 0 : (size_t) (parser)->tokens->offsets[(parser)->entries[i].first_token])
+
+int incremental_parser_update(incremental_parser_t *parser, const char *input, size_t size, source_edit_t edit) {
+    if (parser->tokens == NULL || parser->entry_count == 0) {
+        return incremental_parser_parse(parser, input, size);
+    }
+
+    size_t edit_end = edit.offset + edit.old_length;
+    long delta = (long) edit.new_length - (long) edit.old_length;
+
+    /*
+     * Every entry whose text touches the edit is parsed again, including the ones that merely end or start right at
+     * it. The text in front of the first and behind the last of them is unchanged, so the range boundaries stay
+     * token boundaries.
+     */
+    size_t first = 0;
+    while (first + 1 < parser->entry_count && entry_start_offset(parser, first + 1) < edit.offset) first++;
+
+    size_t last = first;
+    while (last < parser->entry_count && entry_start_offset(parser, last) <= edit_end) last++;
+
+    size_t start_offset = entry_start_offset(parser, first);
+    size_t end_offset = last < parser->entry_count ? entry_start_offset(parser, last) : parser->size;
+    size_t start_token = entry_start_token(parser, first);
+    size_t end_token = last < parser->entry_count ? parser->entries[last].first_token : parser->tokens->size - 1;
+
+    token_stream_t *range_tokens = lexer_lex_range(input, start_offset, (size_t) ((long) end_offset + delta));
+    if (range_tokens == NULL) return fail(parser);
+
+    token_stream_t *tokens = token_stream_splice(parser->tokens, input, start_token, end_token, range_tokens, delta);
+    long token_delta = (long) range_tokens->size - (long) (end_token - start_token);
+    token_stream_free(range_tokens);
+
+    parsed_range_t range;
+    if (parse_range(tokens, start_token, (size_t) ((long) end_token + token_delta), 1, &range)) {
+        // Most likely the edit broke a statement, the full parse reports it properly
+        token_stream_free(tokens);
+        return incremental_parser_parse(parser, input, size);
+    }
+
+    token_stream_free(parser->tokens);
+    parser->input = input;
+    parser->size = size;
+    parser->tokens = tokens;
+
+    replace_entries(parser, first, last, &range, token_delta);
+    return 0;
+}
+
+ptr_list_t *incremental_parser_stmts(incremental_parser_t *parser) {
+    return parser->stmts;
+}
+
+ptr_list_t *incremental_parser_changed(incremental_parser_t *parser) {
+    return parser->changed;
+}
+
+ptr_list_t *incremental_parser_removed(incremental_parser_t *parser) {
+    return parser->removed;
+}
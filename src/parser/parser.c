@@ -5,106 +5,221 @@
 #include "parser/parser.h"
 #include "parser/ast.h"
 #include "lexer/token.h"
+#include "../util/intern.h"
 
 #include <stdlib.h>
 #include <stdio.h>
-#include <wchar.h>
 
-#define current_token ((token_t *) ptr_list_at(parser->tokens, parser->pos))
-#define advance() do { parser->pos++; } while (0)
-
-#define expected(str) fprintf(stderr, "[%lu:%lu] Expected %ls\n", current_token->token_pos.line, current_token->token_pos.column, str)
-#define assert_token_type(tt, name) do if (current_token->type != tt) { expected(name); return NULL; } while (0)
-#define assert_is_identifier() assert_token_type(TOKEN_IDENTIFIER, L"identifier")
-
-#define get_identifier() (((token_identifier_t *) current_token)->value)
-#define get_integer() (((token_integer_t *) current_token)->value)
-#define get_float() (((token_float_t *) current_token)->value)
-#define get_operator() (((token_operator_t *) current_token)->op)
+#define current_slot (token_slot(parser->tokens, parser->pos))
+#define current_type ((token_type_t) parser->tokens->types[current_slot])
+#define current_value (parser->tokens->values[current_slot])
+#define advance() next_token(parser)
+
+#define expected(str) report_expected(parser, str)
+#define assert_token_type(tt, name) do if (current_type != tt) { expected(name); return NULL; } while (0)
+#define assert_is_identifier() assert_token_type(TOKEN_IDENTIFIER, "identifier")
+
+#define get_identifier() (current_value.name)
+#define get_integer() (current_value.integer)
+#define get_float() (current_value.floating)
+#define get_operator() (current_value.op)
+
+// AST nodes all come from the parser's arena. Nodes with a data payload get it allocated right behind them.
+#define new_node(node_type) ((node_type *) arena_alloc(parser->arena, sizeof(node_type)))
+#define new_node_with_data(node, node_type, data_type) do { \
+        (node) = (node_type *) arena_alloc(parser->arena, sizeof(node_type) + sizeof(data_type)); \
+        (node)->data = (data_type *) ((node) + 1); \
+    } while (0)
+#define begin_list() next_scratch_list(parser)
+#define end_list(list) (parser->scratch_depth--, ptr_list_freeze(list, parser->arena))
 
 static expr_t *parse_expr(parser_t *parser);
 static stmt_t *parse_stmt(parser_t *parser);
+static void skip_end_of_statements(parser_t *parser);
 
 struct parser_t {
-    ptr_list_t *tokens;
+    token_stream_t *tokens;
+    lexer_t *lexer; // Only set when streaming
     size_t pos;
     function_stmt_t *current_function;
-};
+    arena_t *arena;
+
+    // List<ptr_list_t *>, one list per nesting depth, reused for every AST list collected at that depth
+    ptr_list_t *scratch_lists;
+    size_t scratch_depth;
 
-typedef struct operator_precedence_t {
-    const wchar_t *op;
-    int precedence;
-} operator_precedence_t;
-
-static operator_precedence_t operator_precedences[] = {
-        { L"=", 1 },
-        { L"==", 10 },
-        { L"!=", 10 },
-        { L"<=", 10 },
-        { L">=", 10 },
-        { L"<", 20 },
-        { L">", 20 },
-        { L"+", 30 },
-        { L"-", 30 },
-        { L"*", 40 },
-        { L"/", 40 },
-        { L"to", 100 }, // Cast binds very strongly
+    // Explicit stacks of parse_expr, see there
+    ptr_list_t *operand_stack; // List<expr_t *>
+    ptr_list_t *operator_stack; // List<expr_t *>, the unary and binary nodes still missing their operands
+
+    size_t nesting_depth; // Of expressions and blocks that are parsed recursively
+
+    int is_quiet; // Set for parallel workers, which leave the diagnostics to a sequential rerun
+    int is_lazy; // Function bodies are skipped until parser_parse_body() is called for them
 };
 
-static size_t operator_count = sizeof(operator_precedences) / sizeof(operator_precedence_t);
+static ptr_list_t *next_scratch_list(parser_t *parser) {
+    if (parser->scratch_depth == ptr_list_size(parser->scratch_lists)) {
+        ptr_list_push(parser->scratch_lists, ptr_list_new());
+    }
+
+    return (ptr_list_t *) ptr_list_at_unchecked(parser->scratch_lists, parser->scratch_depth++);
+}
+
+/*
+ * Error returns leave the lists they began as they are. The entry points that can be called again after an error put
+ * the depth back to where they started and clear the lists above it, so later parses don't pick up stale entries.
+ */
+static void abandon_lists(parser_t *parser, size_t depth) {
+    while (parser->scratch_depth > depth) {
+        ptr_list_clear((ptr_list_t *) ptr_list_at_unchecked(parser->scratch_lists, --parser->scratch_depth));
+    }
+}
+
+static void report_error(parser_t *parser, const char *message);
+
+/*
+ * Operator chains are parsed without recursion, but calls, ifs and blocks still nest on the native stack. Bounding
+ * their depth keeps the parser and every recursive walk over its AST within a small, fixed amount of stack.
+ */
+#define MAX_NESTING_DEPTH 512
+
+static int enter_nesting(parser_t *parser) {
+    if (parser->nesting_depth == MAX_NESTING_DEPTH) {
+        report_error(parser, "Expressions and blocks are nested too deeply!\n");
+        return 0;
+    }
+
+    parser->nesting_depth++;
+    return 1;
+}
+
+#define leave_nesting(parser) ((parser)->nesting_depth--)
+
+static void report_error(parser_t *parser, const char *message) {
+    if (parser->is_quiet) return;
+
+    fputs(message, stderr);
+}
+
+static void report_invalid_integer(parser_t *parser) {
+    if (parser->is_quiet) return;
+
+    token_pos_t pos = token_stream_position(parser->tokens, parser->pos);
+    fprintf(stderr, "[%lu:%lu] Integer literal %.*s is out of range!\n", pos.line, pos.column,
+            (int) parser->tokens->lengths[token_slot(parser->tokens, parser->pos)],
+            token_spelling(parser->tokens, parser->pos));
+}
+
+static void report_expected(parser_t *parser, const char *what) {
+    if (parser->is_quiet) return;
 
-static const wchar_t *unary_operators[] = {
-        L"!",
+    token_pos_t pos = token_stream_position(parser->tokens, parser->pos);
+    fprintf(stderr, "[%lu:%lu] Expected %s\n", pos.line, pos.column, what);
+}
+
+// Never moves past the TOKEN_NULL at the end of the stream.
+static void next_token(parser_t *parser) {
+    if (current_type == TOKEN_NULL) return;
+
+    parser->pos++;
+
+    if (parser->lexer != NULL && parser->pos == parser->tokens->size) {
+        lexer_next_token(parser->lexer);
+    }
+}
+
+// Binding power of every binary operator, -1 for operators that can't be used infix.
+static const int operator_precedences[OPERATOR_COUNT] = {
+        1, // =
+        -1, // !
+        20, // <
+        20, // >
+        30, // +
+        30, // -
+        40, // *
+        40, // /
+        10, // ==
+        10, // !=
+        10, // <=
+        10, // >=
+        100, // to, cast binds very strongly
 };
 
-parser_t *parser_new(ptr_list_t *tokens) {
+static parser_t *create_parser(token_stream_t *tokens, lexer_t *lexer, arena_t *arena, size_t pos) {
     parser_t *parser = (parser_t *) malloc(sizeof(parser_t));
 
     parser->tokens = tokens;
-    parser->pos = 0;
+    parser->lexer = lexer;
+    parser->pos = pos;
     parser->current_function = NULL;
+    parser->arena = arena;
+    parser->scratch_lists = ptr_list_new();
+    parser->scratch_depth = 0;
+    parser->operand_stack = ptr_list_new();
+    parser->operator_stack = ptr_list_new();
+    parser->nesting_depth = 0;
+    parser->is_quiet = 0;
+    parser->is_lazy = 0;
+
+    if (lexer != NULL && tokens->size == 0) {
+        lexer_next_token(lexer);
+    }
+
+    // Leading blank lines and comments
+    skip_end_of_statements(parser);
 
     return parser;
 }
 
+parser_t *parser_new(token_stream_t *tokens, arena_t *arena) {
+    return create_parser(tokens, NULL, arena, 0);
+}
+
+parser_t *parser_new_streaming(lexer_t *lexer, arena_t *arena) {
+    return create_parser(lexer_get_tokens(lexer), lexer, arena, 0);
+}
+
 void parser_free(parser_t *parser) {
+    size_t i;
+    for (i = 0; i < ptr_list_size(parser->scratch_lists); i++) {
+        ptr_list_free((ptr_list_t *) ptr_list_at_unchecked(parser->scratch_lists, i));
+    }
+
+    ptr_list_free(parser->scratch_lists);
+    ptr_list_free(parser->operand_stack);
+    ptr_list_free(parser->operator_stack);
     free(parser);
 }
 
-static int is_keyword(token_t *token, keyword_t keyword) {
-    if (token->type != TOKEN_KEYWORD) return 0;
-    return ((token_keyword_t *) token)->keyword == keyword;
+static int is_keyword(parser_t *parser, keyword_t keyword) {
+    if (current_type != TOKEN_KEYWORD) return 0;
+    return current_value.keyword == keyword;
 }
 
-static int is_char(token_t *token, wchar_t c) {
-    if (token->type != TOKEN_CHAR) return 0;
-    if (((token_char_t *) token)->value != c) return 0;
+static int is_char(parser_t *parser, char c) {
+    if (current_type != TOKEN_CHAR) return 0;
+    if (current_value.character != c) return 0;
 
     return 1;
 }
 
-static int is_operator(token_t *token, wchar_t *op) {
-    if (token->type != TOKEN_OPERATOR) return 0;
-    if (wcscmp(((token_operator_t *) token)->op, op) != 0) return 0;
+static int is_operator(parser_t *parser, operator_t op) {
+    if (current_type != TOKEN_OPERATOR) return 0;
 
-    return 1;
+    return current_value.op == op;
 }
 
 static void skip_end_of_statements(parser_t *parser) {
-    while (current_token) {
-        if (current_token->type == TOKEN_END_OF_STATEMENT) {
-            advance();
-            continue;
-        }
-
-        break;
+    while (current_type == TOKEN_END_OF_STATEMENT) {
+        advance();
     }
 }
 
 static int has_arg_separator(parser_t *parser, ptr_list_t *arguments) {
     if (ptr_list_size(arguments) != 0) {
-        if (!is_char(current_token, L',')) {
-            fprintf(stderr, "Expected ',' to separate function arguments\n");;
+        if (!is_char(parser, ',')) {
+            report_error(parser, "Expected ',' to separate function arguments\n");
             return 0;
         }
 
@@ -116,33 +231,33 @@ static int has_arg_separator(parser_t *parser, ptr_list_t *arguments) {
 
 static prototype_t *parse_prototype(parser_t *parser, int is_extern) {
     assert_is_identifier();
-    wchar_t *name = get_identifier();
+    char *name = get_identifier();
     advance();
 
-    if (!is_char(current_token, L'(')) {
-        fprintf(stderr, "Expected '(' after function name\n");
+    if (!is_char(parser, '(')) {
+        report_error(parser, "Expected '(' after function name\n");
         return NULL;
     }
     advance();
 
-    ptr_list_t *arguments = ptr_list_new();
-    while (!is_char(current_token, L')')) {
+    ptr_list_t *arguments = begin_list();
+    while (!is_char(parser, ')')) {
         if (!has_arg_separator(parser, arguments)) return NULL;
 
         assert_is_identifier();
-        wchar_t *arg_name = get_identifier();
+        char *arg_name = get_identifier();
 
         advance();
-        if (!is_char(current_token, L':')) {
-            expected(L"Expected ':' after function argument");
+        if (!is_char(parser, ':')) {
+            expected("Expected ':' after function argument");
             return NULL;
         }
 
         advance();
         assert_is_identifier();
-        wchar_t *arg_type = get_identifier();
+        char *arg_type = get_identifier();
 
-        typed_ast_value_t *typed_arg = (typed_ast_value_t *) malloc(sizeof(typed_ast_value_t));
+        typed_ast_value_t *typed_arg = new_node(typed_ast_value_t);
         typed_arg->name = arg_name;
         typed_arg->type = arg_type;
         typed_arg->flags = VAR_IS_PARAM | VAR_IS_IMMUTABLE;
@@ -152,37 +267,39 @@ static prototype_t *parse_prototype(parser_t *parser, int is_extern) {
     }
 
     advance();
-    wchar_t *return_type = NULL;
-    if (is_char(current_token, L':')) {
+    char *return_type = NULL;
+    if (is_char(parser, ':')) {
         advance();
         assert_is_identifier();
         return_type = get_identifier();
         advance();
     }
 
-    prototype_t *prototype = (prototype_t *) malloc(sizeof(prototype_t));
+    prototype_t *prototype = new_node(prototype_t);
     prototype->name = name;
     prototype->return_type = return_type;
-    prototype->arguments = arguments;
+    prototype->arguments = end_list(arguments);
     prototype->is_extern = is_extern;
     return prototype;
 }
 
 static expr_t *parse_identifier(parser_t *parser) {
-    wchar_t *identifier = get_identifier();
+    char *identifier = get_identifier();
     advance();
 
-    if (!is_char(current_token, L'(')) {
-        variable_expr_t *expr = (variable_expr_t *) malloc(sizeof(variable_expr_t));
+    if (!is_char(parser, '(')) {
+        variable_expr_t *expr = new_node(variable_expr_t);
         expr->expr_type = EXPR_VARIABLE;
+        expr->checked_type = NULL;
         expr->name = identifier;
+        expr->slot = SLOT_NONE;
         return (expr_t *) expr;
     }
 
     advance();
 
-    ptr_list_t *call_args = ptr_list_new();
-    while (!is_char(current_token, L')')) {
+    ptr_list_t *call_args = begin_list();
+    while (!is_char(parser, ')')) {
         if (!has_arg_separator(parser, call_args)) return NULL;
 
         expr_t *arg = parse_expr(parser);
@@ -192,18 +309,30 @@ static expr_t *parse_identifier(parser_t *parser) {
 
     advance();
 
-    call_expr_t *expr = (call_expr_t *) malloc(sizeof(call_expr_t));
+    call_expr_t *expr;
+    new_node_with_data(expr, call_expr_t, call_expr_data_t);
     expr->expr_type = EXPR_CALL;
-    expr->data = (call_expr_data_t *) malloc(sizeof(call_expr_data_t));
+    expr->checked_type = NULL;
     expr->data->callee_name = identifier;
-    expr->data->arguments = call_args;
+    expr->data->callee = NULL;
+    expr->data->arguments = end_list(call_args);
 
     return (expr_t *) expr;
 }
 
+// Interned type name of the current number's suffix, NULL if it has none.
+static char *get_number_type(parser_t *parser) {
+    number_suffix_t suffix = token_number_suffix(parser->tokens, parser->pos);
+    if (suffix == SUFFIX_NONE) return NULL;
+
+    return intern_string(number_suffix_type_name(suffix));
+}
+
 static expr_t *parse_int(parser_t *parser) {
-    int_expr_t *expr = (int_expr_t *) malloc(sizeof(int_expr_t));
+    int_expr_t *expr = new_node(int_expr_t);
     expr->expr_type = EXPR_INT;
+    expr->checked_type = NULL;
+    expr->type = get_number_type(parser);
     expr->data = get_integer();
     advance();
 
@@ -211,9 +340,12 @@ static expr_t *parse_int(parser_t *parser) {
 }
 
 static expr_t *parse_float(parser_t *parser) {
-    float_expr_t *expr = (float_expr_t *) malloc(sizeof(float_expr_t));
+    float_expr_t *expr;
+    new_node_with_data(expr, float_expr_t, double);
     expr->expr_type = EXPR_FLOAT;
-    expr->data = get_float();
+    expr->checked_type = NULL;
+    expr->type = get_number_type(parser);
+    *expr->data = get_float();
     advance();
 
     return (expr_t *) expr;
@@ -224,7 +356,12 @@ static ptr_list_t *parse_body(parser_t *parser);
 static expr_t *parse_if(parser_t *parser) {
     advance();
 
-    if_expr_data_t *data = (if_expr_data_t *) malloc(sizeof(if_expr_data_t));
+    if_expr_t *expr;
+    new_node_with_data(expr, if_expr_t, if_expr_data_t);
+    expr->expr_type = EXPR_IF;
+    expr->checked_type = NULL;
+
+    if_expr_data_t *data = expr->data;
 
     data->condition = parse_expr(parser);
     if (data->condition == NULL) return NULL;
@@ -236,7 +373,7 @@ static expr_t *parse_if(parser_t *parser) {
 
     data->else_stmts = NULL;
 
-    if (is_keyword(current_token, KEYWORD_ELSE)) {
+    if (is_keyword(parser, KEYWORD_ELSE)) {
         advance();
         skip_end_of_statements(parser);
         data->else_stmts = parse_body(parser);
@@ -244,133 +381,199 @@ static expr_t *parse_if(parser_t *parser) {
         if (data->else_stmts == NULL) return NULL;
     }
 
-    if_expr_t *expr = (if_expr_t *) malloc(sizeof(if_expr_t));
-    expr->expr_type = EXPR_IF;
-    expr->data = data;
     return (expr_t *) expr;
 }
 
 static expr_t *parse_bool(parser_t *parser) {
-    bool_expr_t *expr = (bool_expr_t *) malloc(sizeof(bool_expr_t));
+    bool_expr_t *expr = new_node(bool_expr_t);
     expr->expr_type = EXPR_BOOL;
-    expr->data = is_keyword(current_token, KEYWORD_TRUE);
+    expr->checked_type = NULL;
+    expr->data = is_keyword(parser, KEYWORD_TRUE);
 
     advance();
     return (expr_t *) expr;
 }
 
-static expr_t *parse_unary_expr(parser_t *parser) {
-    unary_expr_data_t *data = (unary_expr_data_t *) malloc(sizeof(unary_expr_data_t));
-    data->op = get_identifier();
-    advance();
-
-    data->value = parse_expr(parser);
-
-    unary_expr_t *expr = (unary_expr_t *) malloc(sizeof(unary_expr_t));
-    expr->expr_type = EXPR_UNARY;
-    expr->data = data;
-    return (expr_t *) expr;
-}
-
-static expr_t *parse_primary(parser_t *parser) {
-    skip_end_of_statements(parser);
-
-    switch (current_token->type) {
+// Operand of an expression that doesn't start with a prefix operator or a parenthesis.
+static expr_t *parse_atom(parser_t *parser) {
+    switch (current_type) {
         case TOKEN_IDENTIFIER:
             return parse_identifier(parser);
         case TOKEN_INTEGER:
             return parse_int(parser);
         case TOKEN_FLOAT:
             return parse_float(parser);
-        case TOKEN_OPERATOR:
-            return parse_unary_expr(parser);
+        case TOKEN_INVALID_INTEGER:
+            report_invalid_integer(parser);
+            return NULL;
         default:
             break;
     }
 
-    if (is_keyword(current_token, KEYWORD_TRUE) || is_keyword(current_token, KEYWORD_FALSE)) {
+    if (is_keyword(parser, KEYWORD_TRUE) || is_keyword(parser, KEYWORD_FALSE)) {
         return parse_bool(parser);
     }
 
-    if (is_keyword(current_token, KEYWORD_IF)) {
+    if (is_keyword(parser, KEYWORD_IF)) {
         return parse_if(parser);
     }
 
-    if (is_char(current_token, L'(')) {
-        advance();
-        expr_t *value = parse_expr(parser);
-
-        if (!is_char(current_token, L')')) {
-            expected(L"')' after parenthesis expression!\n");
-        }
-        advance();
-
-        return value;
-    }
-
-    fprintf(stderr, "Unexpected token!\n");
+    report_error(parser, "Unexpected token!\n");
     return NULL;
 }
 
 static int get_precedence(parser_t *parser) {
-    if (current_token->type != TOKEN_OPERATOR) return -1;
-    wchar_t *op = get_operator();
+    if (current_type != TOKEN_OPERATOR) return -1;
 
-    size_t i;
-    for (i = 0; i < operator_count; i++) {
-        if (!wcscmp(op, operator_precedences[i].op)) {
-            return operator_precedences[i].precedence;
+    return operator_precedences[current_value.op];
+}
+
+/*
+ * Binding power of an entry on the operator stack. Prefix operators apply to the whole rest of the expression, so
+ * only the end of it or a closing parenthesis takes them off the stack. NULL marks an open parenthesis.
+ */
+#define PRECEDENCE_PREFIX (-1)
+#define PRECEDENCE_PAREN (-2)
+
+static int stack_precedence(expr_t *op) {
+    if (op == NULL) return PRECEDENCE_PAREN;
+    if (op->expr_type == EXPR_UNARY) return PRECEDENCE_PREFIX;
+
+    return operator_precedences[((binary_expr_t *) op)->data->op];
+}
+
+/*
+ * Pops operators binding at least as strongly as precedence and applies them to their operands. The last operand
+ * isn't kept on the operand stack but passed in, and the result is returned the same way.
+ */
+static expr_t *reduce_operators(parser_t *parser, size_t base, int precedence, expr_t *operand) {
+    ptr_list_t *operators = parser->operator_stack;
+
+    while (ptr_list_size(operators) > base && stack_precedence(ptr_list_top(operators)) >= precedence) {
+        expr_t *op = (expr_t *) ptr_list_pop(operators);
+
+        if (op->expr_type == EXPR_UNARY) {
+            ((unary_expr_t *) op)->data->value = operand;
+        } else {
+            binary_expr_data_t *data = ((binary_expr_t *) op)->data;
+            data->rhs = operand;
+            data->lhs = (expr_t *) ptr_list_pop(parser->operand_stack);
         }
+
+        operand = op;
     }
 
-    return -1;
+    return operand;
 }
 
-static expr_t *parse_binary_expr_rhs(parser_t *parser, expr_t *lhs, int precedence) {
-    while (1) {
-        int token_precedence = get_precedence(parser);
-        if (token_precedence < precedence) return lhs;
+static expr_t *make_cast(parser_t *parser, expr_t *value) {
+    cast_expr_t *cast_expr;
+    new_node_with_data(cast_expr, cast_expr_t, cast_expr_data_t);
+    cast_expr->expr_type = EXPR_CAST;
+    cast_expr->checked_type = NULL;
+    cast_expr->data->value = value;
+    cast_expr->data->type = get_identifier();
+    advance();
 
-        wchar_t *op = get_operator();
-        advance();
+    return (expr_t *) cast_expr;
+}
+
+/*
+ * Operator precedence parsing with explicit stacks, so long operator chains and deep parentheses don't use any native
+ * stack. The stacks live in the parser and are shared with the expressions nested in calls and ifs, which only use
+ * the part above where they started.
+ */
+static expr_t *parse_expr(parser_t *parser) {
+    ptr_list_t *operands = parser->operand_stack;
+    ptr_list_t *operators = parser->operator_stack;
+    size_t operand_base = ptr_list_size(operands);
+    size_t operator_base = ptr_list_size(operators);
+    size_t open_parens = 0;
+    expr_t *result = NULL;
 
-        if (!wcscmp(L"to", op)) {
-            assert_is_identifier();
+    if (!enter_nesting(parser)) return NULL;
 
-            cast_expr_data_t *data = (cast_expr_data_t *) malloc(sizeof(cast_expr_data_t));
-            data->value = lhs;
-            data->type = get_identifier();
+    while (1) {
+        skip_end_of_statements(parser);
+
+        if (current_type == TOKEN_OPERATOR) {
+            unary_expr_t *unary_expr;
+            new_node_with_data(unary_expr, unary_expr_t, unary_expr_data_t);
+            unary_expr->expr_type = EXPR_UNARY;
+            unary_expr->checked_type = NULL;
+            unary_expr->data->op = get_operator();
             advance();
 
-            lhs = (expr_t *) malloc(sizeof(cast_expr_t));
-            lhs->expr_type = EXPR_CAST;
-            lhs->data = data;
+            ptr_list_push(operators, unary_expr);
             continue;
         }
 
-        expr_t *rhs = parse_primary(parser);
-        if (rhs == NULL) return NULL;
-
-        int next_precedence = get_precedence(parser);
-        if (token_precedence < next_precedence) {
-            rhs = parse_binary_expr_rhs(parser, rhs, token_precedence + 1);
+        if (is_char(parser, '(')) {
+            advance();
+            ptr_list_push(operators, NULL);
+            open_parens++;
+            continue;
         }
 
-        binary_expr_t *binary_expr = (binary_expr_t *) malloc(sizeof(binary_expr_t));
-        binary_expr->expr_type = EXPR_BINARY;
-        binary_expr->data = (binary_expr_data_t *) malloc(sizeof(binary_expr_data_t));
-        binary_expr->data->op = op;
-        binary_expr->data->lhs = lhs;
-        binary_expr->data->rhs = rhs;
+        // The newest operand stays out of the operand stack, so simple expressions don't touch it at all
+        expr_t *operand = parse_atom(parser);
+        if (operand == NULL) goto done;
+
+        // Postfix casts and closing parentheses, until the next binary operator or the end of the expression
+        while (1) {
+            int precedence = get_precedence(parser);
+
+            if (precedence < 0 && open_parens > 0 && is_char(parser, ')')) {
+                operand = reduce_operators(parser, operator_base, PRECEDENCE_PREFIX, operand);
+                ptr_list_pop(operators);
+                open_parens--;
+                advance();
+                continue;
+            }
+
+            if (precedence < 0) {
+                if (open_parens > 0) {
+                    expected("')' after parenthesis expression!\n");
+                    goto done;
+                }
+
+                result = reduce_operators(parser, operator_base, PRECEDENCE_PREFIX, operand);
+                goto done;
+            }
+
+            operand = reduce_operators(parser, operator_base, precedence, operand);
+
+            if (is_operator(parser, OPERATOR_CAST)) {
+                advance();
+                if (current_type != TOKEN_IDENTIFIER) {
+                    expected("identifier");
+                    goto done;
+                }
+
+                operand = make_cast(parser, operand);
+                continue;
+            }
+
+            binary_expr_t *binary_expr;
+            new_node_with_data(binary_expr, binary_expr_t, binary_expr_data_t);
+            binary_expr->expr_type = EXPR_BINARY;
+            binary_expr->checked_type = NULL;
+            binary_expr->data->op = get_operator();
+            binary_expr->data->operand_type = NULL;
+            advance();
 
-        lhs = (expr_t *) binary_expr;
+            ptr_list_push(operands, operand);
+            ptr_list_push(operators, binary_expr);
+            break;
+        }
     }
-}
 
-static expr_t *parse_expr(parser_t *parser) {
-    expr_t *lhs = parse_primary(parser);
+    done:
+    ptr_list_truncate(operands, operand_base);
+    ptr_list_truncate(operators, operator_base);
+    leave_nesting(parser);
 
-    return parse_binary_expr_rhs(parser, lhs, 0);
+    return result;
 }
 
 static int is_assignment_stmt_candidate(expr_t *expr) {
@@ -378,18 +581,17 @@ static int is_assignment_stmt_candidate(expr_t *expr) {
 
     binary_expr_data_t *expr_data = (binary_expr_data_t *) expr->data;
 
-    if (wcscmp(L"=", expr_data->op) != 0) return 0;
+    if (expr_data->op != OPERATOR_ASSIGN) return 0;
     return expr_data->lhs->expr_type == EXPR_VARIABLE;
 }
 
-static stmt_t *make_assignment_stmt(wchar_t *var_name, expr_t *value) {
-    assignment_stmt_data_t *data = (assignment_stmt_data_t *) malloc(sizeof(assignment_stmt_data_t *));
-    data->name = var_name;
-    data->value = value;
-
-    assignment_stmt_t *stmt = (assignment_stmt_t *) malloc(sizeof(assignment_stmt_t));
+static stmt_t *make_assignment_stmt(parser_t *parser, char *var_name, expr_t *value) {
+    assignment_stmt_t *stmt;
+    new_node_with_data(stmt, assignment_stmt_t, assignment_stmt_data_t);
     stmt->stmt_type = STMT_ASSIGNMENT;
-    stmt->data = data;
+    stmt->data->name = var_name;
+    stmt->data->slot = SLOT_NONE;
+    stmt->data->value = value;
 
     return (stmt_t *) stmt;
 }
@@ -397,49 +599,62 @@ static stmt_t *make_assignment_stmt(wchar_t *var_name, expr_t *value) {
 static stmt_t *parse_declaration(parser_t *parser, int is_var) {
     advance();
     assert_is_identifier();
-    wchar_t *var_name = get_identifier();
+    char *var_name = get_identifier();
     advance();
 
-    if (!is_char(current_token, L':')) {
-        expected(L"type for variable declaration");
+    if (!is_char(parser, ':')) {
+        expected("type for variable declaration");
         return NULL;
     }
 
     advance();
     assert_is_identifier();
-    wchar_t *var_type = get_identifier();
+    char *var_type = get_identifier();
     advance();
 
-    typed_ast_value_t *var = (typed_ast_value_t *) malloc(sizeof(typed_ast_value_t));
+    typed_ast_value_t *var = new_node(typed_ast_value_t);
     var->name = var_name;
     var->type = var_type;
     var->flags = is_var ? VAR_IS_MUTABLE : VAR_IS_IMMUTABLE;
 
-    ptr_list_push(parser->current_function->data->variables, var);
+    ptr_list_t *variables = parser->current_function->data->variables;
+
+    declaration_stmt_t *stmt;
+    new_node_with_data(stmt, declaration_stmt_t, declaration_stmt_data_t);
+    stmt->stmt_type = STMT_DECLARATION;
+    stmt->data->variable = var;
+    stmt->data->index = ptr_list_size(variables);
+    stmt->data->slot = SLOT_NONE;
+    stmt->data->value = NULL;
 
-    if (current_token->type == TOKEN_END_OF_STATEMENT) {
+    ptr_list_push(variables, var);
+
+    if (current_type == TOKEN_END_OF_STATEMENT) {
         // let has to have a value!
-        if (!is_var) expected(L"value for immutable variable");
+        if (!is_var) {
+            expected("value for immutable variable");
+            return NULL;
+        }
 
-        return parse_stmt(parser);
+        return (stmt_t *) stmt;
     }
 
-    if (!is_operator(current_token, L"=")) {
-        expected(L"end of statement or '=' after variable declaration");
+    if (!is_operator(parser, OPERATOR_ASSIGN)) {
+        expected("end of statement or '=' after variable declaration");
+        return NULL;
     }
 
     advance();
-    expr_t *value = parse_expr(parser);
-
-    stmt_t *ass_stmt = make_assignment_stmt(var_name, value);
+    stmt->data->value = parse_expr(parser);
+    if (stmt->data->value == NULL) return NULL;
 
-    return ass_stmt;
+    return (stmt_t *) stmt;
 }
 
-static stmt_t *make_assignment_stmt_from_expr(expr_t *expr) {
+static stmt_t *make_assignment_stmt_from_expr(parser_t *parser, expr_t *expr) {
     binary_expr_data_t *bin_expr_data = (binary_expr_data_t *) expr->data;
     variable_expr_t *var_expr = (variable_expr_t *) bin_expr_data->lhs;
-    return make_assignment_stmt(var_expr->name, bin_expr_data->rhs);
+    return make_assignment_stmt(parser, var_expr->name, bin_expr_data->rhs);
 }
 
 static stmt_t *parse_while(parser_t *parser) {
@@ -449,32 +664,31 @@ static stmt_t *parse_while(parser_t *parser) {
     if (condition == NULL) return NULL;
 
     ptr_list_t *body = parse_body(parser);
+    if (body == NULL) return NULL;
 
-    while_stmt_data_t *data = (while_stmt_data_t *) malloc(sizeof(while_stmt_data_t));
-    data->condition = condition;
-    data->body = body;
-
-    while_stmt_t *stmt = (while_stmt_t *) malloc(sizeof(while_stmt_t));
+    while_stmt_t *stmt;
+    new_node_with_data(stmt, while_stmt_t, while_stmt_data_t);
     stmt->stmt_type = STMT_WHILE;
-    stmt->data = data;
+    stmt->data->condition = condition;
+    stmt->data->body = body;
 
     return (stmt_t *) stmt;
 }
 
 static stmt_t *parse_stmt(parser_t *parser) {
-    if (is_keyword(current_token, KEYWORD_VAR)) {
+    if (is_keyword(parser, KEYWORD_VAR)) {
         return parse_declaration(parser, 1);
-    } else if (is_keyword(current_token, KEYWORD_LET)) {
+    } else if (is_keyword(parser, KEYWORD_LET)) {
         return parse_declaration(parser, 0);
     }
 
-    if (is_keyword(current_token, KEYWORD_WHILE)) {
+    if (is_keyword(parser, KEYWORD_WHILE)) {
         return parse_while(parser);
     }
 
     stmt_type_t stmt_type = STMT_EXPR;
 
-    if (is_keyword(current_token, KEYWORD_RETURN)) {
+    if (is_keyword(parser, KEYWORD_RETURN)) {
         stmt_type = STMT_RETURN;
         advance();
     }
@@ -483,56 +697,96 @@ static stmt_t *parse_stmt(parser_t *parser) {
     if (expr == NULL) return NULL;
 
     if (is_assignment_stmt_candidate(expr)) {
-        return make_assignment_stmt_from_expr(expr);
+        return make_assignment_stmt_from_expr(parser, expr);
     }
 
-    stmt_t *stmt = (stmt_t *) malloc(sizeof(stmt_t));
+    stmt_t *stmt = new_node(stmt_t);
     stmt->stmt_type = stmt_type;
     stmt->data = expr;
     return stmt;
 }
 
-static ptr_list_t *parse_body(parser_t *parser) {
-    if (!is_char(current_token, L'{')) {
-        fprintf(stderr, "Expected '{' to open block\n");
+static ptr_list_t *parse_body_stmts(parser_t *parser) {
+    if (!is_char(parser, '{')) {
+        report_error(parser, "Expected '{' to open block\n");
         return NULL;
     }
 
     advance();
     skip_end_of_statements(parser);
 
-    ptr_list_t *stmts = ptr_list_new();
+    ptr_list_t *stmts = begin_list();
 
-    while (!is_char(current_token, L'}')) {
+    while (!is_char(parser, '}')) {
         stmt_t *stmt = parse_stmt(parser);
         if (stmt == NULL) return NULL;
         ptr_list_push(stmts, stmt);
 
-        assert_token_type(TOKEN_END_OF_STATEMENT, L"end of statement");
+        assert_token_type(TOKEN_END_OF_STATEMENT, "end of statement");
         advance();
     }
 
     advance();
 
-    return stmts;
+    return end_list(stmts);
+}
+
+static ptr_list_t *parse_body(parser_t *parser) {
+    if (!enter_nesting(parser)) return NULL;
+
+    ptr_list_t *body = parse_body_stmts(parser);
+    leave_nesting(parser);
+
+    return body;
+}
+
+// Moves past the block starting at the current '{' without building any AST for it.
+static int skip_body(parser_t *parser) {
+    if (!is_char(parser, '{')) {
+        report_error(parser, "Expected '{' to open block\n");
+        return 0;
+    }
+
+    size_t depth = 0;
+    do {
+        if (current_type == TOKEN_NULL) {
+            expected("'}' to close block");
+            return 0;
+        }
+
+        if (is_char(parser, '{')) depth++;
+        if (is_char(parser, '}')) depth--;
+        advance();
+    } while (depth > 0);
+
+    return 1;
 }
 
 static stmt_t *parse_function(parser_t *parser) {
-    if (!is_keyword(current_token, KEYWORD_FUNCTION)) {
-        fprintf(stderr, "Expected function keyword!\n");
+    if (!is_keyword(parser, KEYWORD_FUNCTION)) {
+        report_error(parser, "Expected function keyword!\n");
         return NULL;
     }
 
     advance();
     prototype_t *prototype = parse_prototype(parser, 0);
+    if (prototype == NULL) return NULL;
+
+    function_stmt_t *stmt;
+    new_node_with_data(stmt, function_stmt_t, function_stmt_data_t);
+    stmt->stmt_type = STMT_FUNCTION;
 
-    function_stmt_data_t *data = (function_stmt_data_t *) malloc(sizeof(function_stmt_data_t));
+    function_stmt_data_t *data = stmt->data;
     data->prototype = prototype;
-    data->variables = ptr_list_new();
+    data->body_token = parser->pos;
 
-    function_stmt_t *stmt = (function_stmt_t *) malloc(sizeof(function_stmt_t));
-    stmt->stmt_type = STMT_FUNCTION;
-    stmt->data = data;
+    if (parser->is_lazy) {
+        data->variables = NULL;
+        data->body = NULL;
+        return skip_body(parser) ? (stmt_t *) stmt : NULL;
+    }
+
+    data->variables = begin_list();
 
     parser->current_function = stmt;
 
@@ -541,50 +795,258 @@ static stmt_t *parse_function(parser_t *parser) {
 
     parser->current_function = NULL;
 
+    if (body == NULL) return NULL;
+    data->variables = end_list(data->variables);
+
     return (stmt_t *) stmt;
 }
 
 static stmt_t *parse_extern(parser_t *parser) {
-    if (!is_keyword(current_token, KEYWORD_EXTERN)) {
-        fprintf(stderr, "Expected extern keyword!");
+    if (!is_keyword(parser, KEYWORD_EXTERN)) {
+        report_error(parser, "Expected extern keyword!");
         return NULL;
     }
 
     advance();
     prototype_t *prototype = parse_prototype(parser, 1);
+    if (prototype == NULL) return NULL;
 
-    assert_token_type(TOKEN_END_OF_STATEMENT, L"end of statement after extern declaration");
+    assert_token_type(TOKEN_END_OF_STATEMENT, "end of statement after extern declaration");
     advance();
 
-    extern_stmt_t *stmt = (extern_stmt_t *) malloc(sizeof(extern_stmt_t));
+    extern_stmt_t *stmt = new_node(extern_stmt_t);
     stmt->stmt_type = STMT_EXTERN;
     stmt->prototype = prototype;
     return (stmt_t *) stmt;
 }
 
 static stmt_t *parse_top_level_stmt(parser_t *parser) {
-    if (is_keyword(current_token, KEYWORD_FUNCTION)) {
+    if (is_keyword(parser, KEYWORD_FUNCTION)) {
         return parse_function(parser);
     }
 
-    if (is_keyword(current_token, KEYWORD_EXTERN)) {
+    if (is_keyword(parser, KEYWORD_EXTERN)) {
         return parse_extern(parser);
     }
 
-    expected(L"function or extern keyword for top level statement");
+    expected("function or extern keyword for top level statement");
     return NULL;
 }
 
+size_t parser_position(parser_t *parser) {
+    return parser->pos;
+}
+
+void parser_seek(parser_t *parser, size_t pos) {
+    parser->pos = pos;
+    skip_end_of_statements(parser);
+}
+
+void parser_set_quiet(parser_t *parser, int is_quiet) {
+    parser->is_quiet = is_quiet;
+}
+
+void parser_set_lazy(parser_t *parser, int is_lazy) {
+    parser->is_lazy = is_lazy;
+}
+
+int parser_parse_body(parser_t *parser, function_stmt_t *function) {
+    function_stmt_data_t *data = function->data;
+    size_t pos = parser->pos;
+
+    parser->pos = data->body_token;
+    parser->current_function = function;
+
+    size_t scratch_depth = parser->scratch_depth;
+    data->variables = begin_list();
+    data->body = parse_body(parser);
+
+    if (data->body != NULL) {
+        data->variables = end_list(data->variables);
+    } else {
+        abandon_lists(parser, scratch_depth);
+        data->variables = NULL;
+    }
+
+    parser->current_function = NULL;
+    parser->pos = pos;
+
+    return data->body == NULL;
+}
+
+int parser_at_end(parser_t *parser) {
+    return current_type == TOKEN_NULL;
+}
+
+stmt_t *parser_parse_next(parser_t *parser) {
+    size_t scratch_depth = parser->scratch_depth;
+
+    stmt_t *stmt = parse_top_level_stmt(parser);
+    if (stmt == NULL) {
+        abandon_lists(parser, scratch_depth);
+        return NULL;
+    }
+
+    skip_end_of_statements(parser);
+
+    return stmt;
+}
+
 ptr_list_t *parser_parse_all(parser_t *parser) {
-    ptr_list_t *stmts = ptr_list_new();
+    size_t scratch_depth = parser->scratch_depth;
+    ptr_list_t *stmts = begin_list();
 
-    while (current_token != NULL) {
-        stmt_t *stmt = parse_top_level_stmt(parser);
-        if (stmt == NULL) return NULL;
+    while (!parser_at_end(parser)) {
+        stmt_t *stmt = parser_parse_next(parser);
+        if (stmt == NULL) {
+            abandon_lists(parser, scratch_depth);
+            return NULL;
+        }
 
         ptr_list_push(stmts, stmt);
+    }
 
-        skip_end_of_statements(parser);
+    return end_list(stmts);
+}
+
+/*
+ * Parallel parsing cuts the token stream into ranges of whole top level statements. Every range starts at a func or
+ * extern keyword that follows an end of statement outside of any braces. Each range is parsed by its own parser into
+ * its own arena, and a range only counts if parsing ends exactly where the next one starts. Then the parsers went
+ * through the same tokens a sequential parse would have.
+ */
+
+#define PARALLEL_MIN_RANGE_TOKENS 4096
+#define PARALLEL_RANGES_PER_THREAD 4
+
+typedef struct parse_range_t {
+    token_stream_t *tokens;
+    size_t start;
+    size_t end; // Start of the next range, or the final TOKEN_NULL
+    arena_t *arena;
+    ptr_list_t *stmts; // NULL if the range didn't parse cleanly
+} parse_range_t;
+
+static int is_range_start(token_stream_t *tokens, size_t i) {
+    if (i == 0 || tokens->types[i] != TOKEN_KEYWORD || tokens->types[i - 1] != TOKEN_END_OF_STATEMENT) return 0;
+
+    keyword_t keyword = tokens->values[i].keyword;
+    return keyword == KEYWORD_FUNCTION || keyword == KEYWORD_EXTERN;
+}
+
+static parse_range_t *new_parse_range(token_stream_t *tokens, size_t start) {
+    parse_range_t *range = (parse_range_t *) malloc(sizeof(parse_range_t));
+    range->tokens = tokens;
+    range->start = start;
+    range->end = tokens->size - 1;
+    range->arena = arena_new();
+    range->stmts = NULL;
+
+    return range;
+}
+
+// Returns List<parse_range_t *> covering the whole stream.
+static ptr_list_t *split_parse_ranges(token_stream_t *tokens, size_t target_size) {
+    ptr_list_t *ranges = ptr_list_new();
+    parse_range_t *range = new_parse_range(tokens, 0);
+    ptr_list_push(ranges, range);
+
+    size_t depth = 0;
+    size_t i;
+    for (i = 0; i + 1 < tokens->size; i++) {
+        if (tokens->types[i] == TOKEN_CHAR) {
+            char c = tokens->values[i].character;
+            if (c == '{') depth++;
+            if (c == '}' && depth > 0) depth--;
+            continue;
+        }
+
+        if (depth == 0 && i - range->start >= target_size && is_range_start(tokens, i)) {
+            range->end = i;
+            range = new_parse_range(tokens, i);
+            ptr_list_push(ranges, range);
+        }
+    }
+
+    return ranges;
+}
+
+static void parse_range(void *arg) {
+    parse_range_t *range = (parse_range_t *) arg;
+
+    parser_t *parser = create_parser(range->tokens, NULL, range->arena, range->start);
+    parser->is_quiet = 1;
+
+    ptr_list_t *stmts = begin_list();
+
+    while (parser->pos < range->end) {
+        stmt_t *stmt = parser_parse_next(parser);
+        if (stmt == NULL) break;
+
+        ptr_list_push(stmts, stmt);
+    }
+
+    if (parser->pos == range->end) {
+        range->stmts = end_list(stmts);
+    }
+
+    parser_free(parser);
+}
+
+ptr_list_t *parser_parse_parallel(token_stream_t *tokens, arena_t *arena, thread_pool_t *pool) {
+    size_t target_size = tokens->size / (thread_pool_size(pool) * PARALLEL_RANGES_PER_THREAD) + 1;
+    if (target_size < PARALLEL_MIN_RANGE_TOKENS) target_size = PARALLEL_MIN_RANGE_TOKENS;
+
+    ptr_list_t *ranges = split_parse_ranges(tokens, target_size);
+    size_t range_count = ptr_list_size(ranges);
+
+    size_t i;
+    for (i = 0; i < range_count; i++) {
+        thread_pool_submit(pool, parse_range, ptr_list_at_unchecked(ranges, i));
+    }
+
+    thread_pool_wait(pool);
+
+    size_t stmt_count = 0;
+    int failed = 0;
+    for (i = 0; i < range_count; i++) {
+        parse_range_t *range = (parse_range_t *) ptr_list_at_unchecked(ranges, i);
+        if (range->stmts == NULL) {
+            failed = 1;
+        } else {
+            stmt_count += ptr_list_size(range->stmts);
+        }
+    }
+
+    ptr_list_t *stmts = NULL;
+    if (!failed) {
+        stmts = ptr_list_new_arena(arena, stmt_count);
+    }
+
+    for (i = 0; i < range_count; i++) {
+        parse_range_t *range = (parse_range_t *) ptr_list_at_unchecked(ranges, i);
+
+        if (failed) {
+            arena_free(range->arena);
+        } else {
+            size_t j;
+            for (j = 0; j < ptr_list_size(range->stmts); j++) {
+                ptr_list_push(stmts, ptr_list_at_unchecked(range->stmts, j));
+            }
+
+            arena_merge(arena, range->arena);
+        }
+
+        free(range);
+    }
+
+    ptr_list_free(ranges);
+
+    if (failed) {
+        // Parse again on this thread, so the errors come out just like without threads
+        parser_t *parser = parser_new(tokens, arena);
+        stmts = parser_parse_all(parser);
+        parser_free(parser);
     }
 
     return stmts;
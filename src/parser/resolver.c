@@ -0,0 +1,197 @@
+//
+// Created by sarah on 3/25/24.
+//
+
+#include "parser/resolver.h"
+#include "../util/ptr_map.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef struct binding_t {
+    char *name;
+    size_t slot;
+    size_t depth; // Of the scope that declared it
+    size_t shadowed; // Index + 1 of the binding of the same name it hides, 0 if none
+} binding_t;
+
+typedef struct resolver_t {
+    /*
+     * Name to index + 1 of its innermost visible binding. The map can't remove entries, so names that go out of
+     * scope are mapped to NULL instead, which reads the same as a missing name.
+     */
+    ptr_map_t *names;
+
+    binding_t *bindings;
+    size_t binding_count;
+    size_t binding_capacity;
+
+    size_t depth;
+    size_t variable_base; // Slot of the function's first variable, after the parameters
+
+    chain_walker_t walker;
+} resolver_t;
+
+static int resolve_stmt_list(resolver_t *resolver, ptr_list_t *stmts);
+
+#define binding_ref(index) ((void *) (uintptr_t) ((index) + 1))
+
+static binding_t *find_binding(resolver_t *resolver, char *name) {
+    uintptr_t ref = (uintptr_t) ptr_map_get(resolver->names, name);
+    if (ref == 0) return NULL;
+
+    return &resolver->bindings[ref - 1];
+}
+
+static int declare(resolver_t *resolver, char *name, size_t slot) {
+    binding_t *visible = find_binding(resolver, name);
+    if (visible != NULL && visible->depth == resolver->depth) {
+        fprintf(stderr, "Redeclaration of variable %s!\n", name);
+        return 1;
+    }
+
+    if (resolver->binding_count == resolver->binding_capacity) {
+        resolver->binding_capacity *= 2;
+        resolver->bindings = (binding_t *) realloc(resolver->bindings, sizeof(binding_t) * resolver->binding_capacity);
+    }
+
+    size_t index = resolver->binding_count++;
+    binding_t *binding = &resolver->bindings[index];
+    binding->name = name;
+    binding->slot = slot;
+    binding->depth = resolver->depth;
+    binding->shadowed = visible != NULL ? (size_t) (visible - resolver->bindings) + 1 : 0;
+
+    ptr_map_put(resolver->names, name, binding_ref(index));
+    return 0;
+}
+
+static int lookup(resolver_t *resolver, char *name, size_t *slot) {
+    binding_t *binding = find_binding(resolver, name);
+    if (binding == NULL) {
+        fprintf(stderr, "Unknown variable %s!\n", name);
+        return 1;
+    }
+
+    *slot = binding->slot;
+    return 0;
+}
+
+// Resolves the statements in a scope of their own, dropping their declarations again afterwards.
+static int resolve_scope(resolver_t *resolver, ptr_list_t *stmts) {
+    size_t base = resolver->binding_count;
+
+    resolver->depth++;
+    int failed = resolve_stmt_list(resolver, stmts);
+    resolver->depth--;
+
+    while (resolver->binding_count > base) {
+        binding_t *binding = &resolver->bindings[--resolver->binding_count];
+        ptr_map_put(resolver->names, binding->name, binding->shadowed ? binding_ref(binding->shadowed - 1) : NULL);
+    }
+
+    return failed;
+}
+
+static int resolve_expr(resolver_t *resolver, expr_t *expr);
+
+static int resolve_operand(resolver_t *resolver, expr_t *expr) {
+    size_t i;
+    call_expr_data_t *call_data;
+    if_expr_data_t *if_data;
+
+    switch (expr->expr_type) {
+        case EXPR_VARIABLE:
+            return lookup(resolver, ((variable_expr_t *) expr)->name, &((variable_expr_t *) expr)->slot);
+        case EXPR_CALL:
+            call_data = ((call_expr_t *) expr)->data;
+            for (i = 0; i < ptr_list_size(call_data->arguments); i++) {
+                if (resolve_expr(resolver, (expr_t *) ptr_list_at_unchecked(call_data->arguments, i))) return 1;
+            }
+            return 0;
+        case EXPR_IF:
+            if_data = ((if_expr_t *) expr)->data;
+            if (resolve_expr(resolver, if_data->condition)) return 1;
+            if (resolve_scope(resolver, if_data->then_stmts)) return 1;
+            return if_data->else_stmts != NULL && resolve_scope(resolver, if_data->else_stmts);
+        default:
+            return 0;
+    }
+}
+
+static int visit_operand(void *resolver, expr_t *expr) {
+    return resolve_operand((resolver_t *) resolver, expr);
+}
+
+static int resolve_expr(resolver_t *resolver, expr_t *expr) {
+    return walk_operator_chain(&resolver->walker, expr, visit_operand, NULL, resolver);
+}
+
+static int resolve_stmt(resolver_t *resolver, stmt_t *stmt) {
+    assignment_stmt_data_t *assignment_data;
+    declaration_stmt_data_t *declaration_data;
+    while_stmt_data_t *while_data;
+
+    switch (stmt->stmt_type) {
+        case STMT_RETURN:
+            return resolve_expr(resolver, ((return_stmt_t *) stmt)->value);
+        case STMT_EXPR:
+            return resolve_expr(resolver, ((expr_stmt_t *) stmt)->expr);
+        case STMT_ASSIGNMENT:
+            assignment_data = ((assignment_stmt_t *) stmt)->data;
+            if (resolve_expr(resolver, assignment_data->value)) return 1;
+            return lookup(resolver, assignment_data->name, &assignment_data->slot);
+        case STMT_DECLARATION:
+            // The value is resolved first, so a variable's own name in it still refers to the one it shadows
+            declaration_data = ((declaration_stmt_t *) stmt)->data;
+            if (declaration_data->value != NULL && resolve_expr(resolver, declaration_data->value)) return 1;
+            declaration_data->slot = resolver->variable_base + declaration_data->index;
+            return declare(resolver, declaration_data->variable->name, declaration_data->slot);
+        case STMT_WHILE:
+            while_data = ((while_stmt_t *) stmt)->data;
+            if (resolve_expr(resolver, while_data->condition)) return 1;
+            return resolve_scope(resolver, while_data->body);
+        default:
+            // Functions and externs inside of functions are reported by the checker
+            return 0;
+    }
+}
+
+static int resolve_stmt_list(resolver_t *resolver, ptr_list_t *stmts) {
+    size_t i;
+    for (i = 0; i < ptr_list_size(stmts); i++) {
+        if (resolve_stmt(resolver, (stmt_t *) ptr_list_at_unchecked(stmts, i))) return 1;
+    }
+
+    return 0;
+}
+
+int resolve_function(function_stmt_t *function) {
+    ptr_list_t *arguments = function->data->prototype->arguments;
+
+    resolver_t resolver;
+    resolver.names = ptr_map_new();
+    resolver.binding_capacity = 16;
+    resolver.bindings = (binding_t *) malloc(sizeof(binding_t) * resolver.binding_capacity);
+    resolver.binding_count = 0;
+    resolver.depth = 0;
+    resolver.variable_base = ptr_list_size(arguments);
+    chain_walker_init(&resolver.walker);
+
+    int failed = 0;
+    size_t i;
+    for (i = 0; i < ptr_list_size(arguments) && !failed; i++) {
+        failed = declare(&resolver, ((typed_ast_value_t *) ptr_list_at_unchecked(arguments, i))->name, i);
+    }
+
+    if (!failed) {
+        failed = resolve_scope(&resolver, function->data->body);
+    }
+
+    ptr_map_free(resolver.names);
+    free(resolver.bindings);
+    chain_walker_free(&resolver.walker);
+
+    return failed;
+}
@@ -0,0 +1,128 @@
+//
+// Created by sarah on 3/20/24.
+//
+
+#include "arena.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define CHUNK_SIZE (64 * 1024)
+#define ALIGNMENT 8 // Nothing in the AST needs more than a pointer or a double
+
+typedef struct arena_chunk_t arena_chunk_t;
+
+struct arena_chunk_t {
+    arena_chunk_t *previous;
+    size_t capacity;
+    char *data;
+};
+
+struct arena_t {
+    arena_chunk_t *current;
+    char *top; // Next free byte in the current chunk
+    char *end;
+    size_t used;
+};
+
+static void *checked_calloc(size_t size) {
+    void *ptr = calloc(1, size);
+    if (ptr == NULL) {
+        fprintf(stderr, "Out of memory while allocating arena chunk!\n");
+        exit(1);
+    }
+
+    return ptr;
+}
+
+static void push_chunk(arena_t *arena, size_t min_size) {
+    size_t capacity = min_size > CHUNK_SIZE ? min_size : CHUNK_SIZE;
+
+    // calloc instead of zeroing every allocation, the OS hands out zeroed pages anyway
+    arena_chunk_t *chunk = (arena_chunk_t *) checked_calloc(sizeof(arena_chunk_t) + capacity);
+    chunk->previous = arena->current;
+    chunk->capacity = capacity;
+    chunk->data = (char *) (chunk + 1);
+
+    arena->current = chunk;
+    arena->top = chunk->data;
+    arena->end = chunk->data + capacity;
+}
+
+arena_t *arena_new() {
+    arena_t *arena = (arena_t *) malloc(sizeof(arena_t));
+    arena->current = NULL;
+    arena->top = NULL;
+    arena->end = NULL;
+    arena->used = 0;
+
+    return arena;
+}
+
+void arena_free(arena_t *arena) {
+    arena_chunk_t *chunk = arena->current;
+    while (chunk != NULL) {
+        arena_chunk_t *previous = chunk->previous;
+        free(chunk);
+        chunk = previous;
+    }
+
+    free(arena);
+}
+
+void arena_reset(arena_t *arena) {
+    if (arena->current == NULL) return;
+
+    arena_chunk_t *chunk = arena->current->previous;
+    while (chunk != NULL) {
+        arena_chunk_t *previous = chunk->previous;
+        free(chunk);
+        chunk = previous;
+    }
+
+    // Only the part that was handed out needs zeroing again
+    memset(arena->current->data, 0, (size_t) (arena->top - arena->current->data));
+
+    arena->current->previous = NULL;
+    arena->top = arena->current->data;
+    arena->used = 0;
+}
+
+void *arena_alloc(arena_t *arena, size_t size) {
+    size = (size + ALIGNMENT - 1) & ~((size_t) ALIGNMENT - 1);
+
+    if ((size_t) (arena->end - arena->top) < size) {
+        push_chunk(arena, size);
+    }
+
+    void *ptr = arena->top;
+    arena->top += size;
+    arena->used += size;
+
+    return ptr;
+}
+
+void arena_merge(arena_t *arena, arena_t *other) {
+    if (other->current != NULL) {
+        // Other's chunks go below the current one, which keeps its free space for further allocations
+        arena_chunk_t *oldest = other->current;
+        while (oldest->previous != NULL) oldest = oldest->previous;
+
+        if (arena->current == NULL) {
+            arena->current = other->current;
+            arena->top = other->top;
+            arena->end = other->end;
+        } else {
+            oldest->previous = arena->current->previous;
+            arena->current->previous = other->current;
+        }
+    }
+
+    arena->used += other->used;
+    free(other);
+}
+
+size_t arena_used(arena_t *arena) {
+    return arena->used;
+}
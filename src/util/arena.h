@@ -0,0 +1,31 @@
+//
+// Created by sarah on 3/20/24.
+//
+
+#ifndef PASTEL_ARENA_H
+#define PASTEL_ARENA_H
+
+#include <stddef.h>
+
+/*
+ * Bump pointer allocator. Everything allocated from an arena lives until the arena itself is freed, there is no way
+ * to free a single allocation. Used for the AST, which is built once and thrown away as a whole.
+ */
+typedef struct arena_t arena_t;
+
+arena_t *arena_new();
+void arena_free(arena_t *arena);
+
+// Drops all allocations at once. Keeps the newest chunk for the ones that come after, so a reused arena rarely mallocs.
+void arena_reset(arena_t *arena);
+
+// Returns zeroed memory, aligned for any AST node. Never returns NULL.
+void *arena_alloc(arena_t *arena, size_t size);
+
+// Hands all of other's allocations over to arena, so they're freed along with it. Frees other itself.
+void arena_merge(arena_t *arena, arena_t *other);
+
+// Number of bytes handed out so far.
+size_t arena_used(arena_t *arena);
+
+#endif //PASTEL_ARENA_H
@@ -0,0 +1,186 @@
+//
+// Created by sarah on 3/19/24.
+//
+
+#include "intern.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#define INITIAL_CAPACITY 128 // Per shard, has to be a power of two
+#define STRING_CHUNK_SIZE 16384 // In bytes
+#define SHARD_BITS 4
+#define SHARD_COUNT (1 << SHARD_BITS)
+
+typedef struct intern_entry_t {
+    char *str; // NULL for empty slots
+    size_t length;
+    uint32_t hash;
+} intern_entry_t;
+
+typedef struct string_chunk_t string_chunk_t;
+
+struct string_chunk_t {
+    string_chunk_t *previous;
+    size_t used;
+    size_t capacity;
+    char chars[];
+};
+
+/*
+ * The lexer interns from several threads at once, so the table is split into shards by the top bits of the hash,
+ * each with its own lock. Slots within a shard are picked by the low bits.
+ */
+typedef struct intern_shard_t {
+    pthread_mutex_t lock;
+    intern_entry_t *entries;
+    size_t entry_count;
+    size_t capacity;
+
+    // Interned strings are never freed, so they are bump allocated from big chunks instead of malloc'ing each one.
+    string_chunk_t *current_chunk;
+} intern_shard_t;
+
+static intern_shard_t shards[SHARD_COUNT];
+static pthread_once_t shards_once = PTHREAD_ONCE_INIT;
+
+static void init_shards(void) {
+    size_t i;
+    for (i = 0; i < SHARD_COUNT; i++) {
+        pthread_mutex_init(&shards[i].lock, NULL);
+        shards[i].entries = NULL;
+        shards[i].entry_count = 0;
+        shards[i].capacity = 0;
+        shards[i].current_chunk = NULL;
+    }
+}
+
+// Returns the shard a hash belongs to, locked.
+static intern_shard_t *lock_shard(uint32_t hash) {
+    pthread_once(&shards_once, init_shards);
+
+    intern_shard_t *shard = &shards[hash >> (32 - SHARD_BITS)];
+    pthread_mutex_lock(&shard->lock);
+    return shard;
+}
+
+static void *checked_malloc(size_t size) {
+    void *ptr = malloc(size);
+    if (ptr == NULL) {
+        fprintf(stderr, "Out of memory while interning strings!\n");
+        exit(1);
+    }
+
+    return ptr;
+}
+
+static char *store_string(intern_shard_t *shard, size_t length) {
+    string_chunk_t *current_chunk = shard->current_chunk;
+    if (current_chunk == NULL || current_chunk->capacity - current_chunk->used < length + 1) {
+        size_t chunk_capacity = length + 1 > STRING_CHUNK_SIZE ? length + 1 : STRING_CHUNK_SIZE;
+
+        string_chunk_t *chunk = (string_chunk_t *) checked_malloc(sizeof(string_chunk_t) + chunk_capacity);
+        chunk->previous = current_chunk;
+        chunk->used = 0;
+        chunk->capacity = chunk_capacity;
+        shard->current_chunk = current_chunk = chunk;
+    }
+
+    char *str = current_chunk->chars + current_chunk->used;
+    current_chunk->used += length + 1;
+    return str;
+}
+
+/* FNV-1a over the bytes */
+
+#define FNV_OFFSET_BASIS 2166136261u
+#define FNV_PRIME 16777619u
+
+static uint32_t hash_bytes(const char *str, size_t length) {
+    uint32_t hash = FNV_OFFSET_BASIS;
+    size_t i;
+    for (i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned char) str[i]) * FNV_PRIME;
+    }
+
+    return hash;
+}
+
+static void grow(intern_shard_t *shard) {
+    size_t old_capacity = shard->capacity;
+    intern_entry_t *old_entries = shard->entries;
+
+    size_t capacity = old_capacity == 0 ? INITIAL_CAPACITY : old_capacity * 2;
+    intern_entry_t *entries = (intern_entry_t *) checked_malloc(capacity * sizeof(intern_entry_t));
+    memset(entries, 0, capacity * sizeof(intern_entry_t));
+
+    size_t i;
+    for (i = 0; i < old_capacity; i++) {
+        intern_entry_t *entry = &old_entries[i];
+        if (entry->str == NULL) continue;
+
+        size_t slot = entry->hash & (capacity - 1);
+        while (entries[slot].str != NULL) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+
+        entries[slot] = *entry;
+    }
+
+    free(old_entries);
+    shard->entries = entries;
+    shard->capacity = capacity;
+}
+
+// Returns the slot that holds the string, or the empty slot where it should be inserted.
+static intern_entry_t *find(intern_shard_t *shard, const char *str, size_t length, uint32_t hash) {
+    size_t slot = hash & (shard->capacity - 1);
+
+    while (1) {
+        intern_entry_t *entry = &shard->entries[slot];
+        if (entry->str == NULL) return entry;
+
+        if (entry->hash == hash && entry->length == length && !memcmp(entry->str, str, length)) {
+            return entry;
+        }
+
+        slot = (slot + 1) & (shard->capacity - 1);
+    }
+}
+
+// Keeps the load factor at or below 1/2.
+static void ensure_capacity(intern_shard_t *shard) {
+    if ((shard->entry_count + 1) * 2 > shard->capacity) grow(shard);
+}
+
+char *intern_string(const char *str) {
+    return intern_bytes(str, strlen(str));
+}
+
+char *intern_bytes(const char *start, size_t length) {
+    uint32_t hash = hash_bytes(start, length);
+
+    intern_shard_t *shard = lock_shard(hash);
+    ensure_capacity(shard);
+
+    intern_entry_t *entry = find(shard, start, length, hash);
+    if (entry->str != NULL) {
+        pthread_mutex_unlock(&shard->lock);
+        return entry->str;
+    }
+
+    char *copy = store_string(shard, length);
+    memcpy(copy, start, length);
+    copy[length] = 0;
+
+    entry->str = copy;
+    entry->length = length;
+    entry->hash = hash;
+    shard->entry_count++;
+    pthread_mutex_unlock(&shard->lock);
+
+    return copy;
+}
@@ -0,0 +1,22 @@
+//
+// Created by sarah on 3/19/24.
+//
+
+#ifndef PASTEL_INTERN_H
+#define PASTEL_INTERN_H
+
+#include <stddef.h>
+
+/*
+ * Global string interning table. Interning returns the one canonical copy of a string, so two interned strings are
+ * equal exactly if they're the same pointer. All names in the tokens, the AST and the compiler's symbol tables are
+ * interned. Strings are UTF-8 bytes, like the sources they come from. The returned strings live until the end of the
+ * program and must not be modified. Safe to call from several threads at once.
+ */
+
+char *intern_string(const char *str);
+
+// Interns length bytes starting at start, like the spelling of a token. They don't have to be null-terminated.
+char *intern_bytes(const char *start, size_t length);
+
+#endif //PASTEL_INTERN_H
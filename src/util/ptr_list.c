@@ -6,46 +6,88 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
-#define DEFAULT_CAPACITY 64
+static void *checked_realloc(void *ptr, size_t size) {
+    void *new_ptr = realloc(ptr, size);
+    if (new_ptr == NULL) {
+        fprintf(stderr, "Failed to realloc pointer list!\n");
+        exit(1);
+    }
 
-struct ptr_list_t {
-    void **ptrs;
-    size_t size;
-    size_t capacity;
-    size_t iter_pos;
-};
+    return new_ptr;
+}
 
 void ensure_capacity(ptr_list_t *list) {
     if (list->size < list->capacity) return;
 
     list->capacity *= 2;
-    void **new_ptrs = (void **) realloc(list->ptrs, sizeof(void *) * list->capacity);
-    if (new_ptrs == NULL) {
-        fprintf(stderr, "Failed to realloc pointer list!\n");
-        exit(1);
+
+    if (list->arena != NULL) {
+        void **new_ptrs = (void **) arena_alloc(list->arena, sizeof(void *) * list->capacity);
+        memcpy(new_ptrs, list->ptrs, sizeof(void *) * list->size);
+        list->ptrs = new_ptrs;
+        return;
+    }
+
+    if (list->ptrs == list->inline_ptrs) {
+        void **new_ptrs = (void **) checked_realloc(NULL, sizeof(void *) * list->capacity);
+        memcpy(new_ptrs, list->inline_ptrs, sizeof(void *) * list->size);
+        list->ptrs = new_ptrs;
+        return;
     }
 
-    list->ptrs = new_ptrs;
+    list->ptrs = (void **) checked_realloc(list->ptrs, sizeof(void *) * list->capacity);
+}
+
+static void init_list(ptr_list_t *list) {
+    list->ptrs = list->inline_ptrs;
+    list->size = 0;
+    list->capacity = PTR_LIST_INLINE_CAPACITY;
+    list->iter_pos = 0;
+    list->arena = NULL;
 }
 
 ptr_list_t *ptr_list_new() {
-    return ptr_list_new_capacity(DEFAULT_CAPACITY);
+    ptr_list_t *list = (ptr_list_t *) malloc(sizeof(ptr_list_t));
+    init_list(list);
+
+    return list;
 }
 
 ptr_list_t *ptr_list_new_capacity(size_t capacity) {
-    ptr_list_t *list = (ptr_list_t *) malloc(sizeof(ptr_list_t));
+    ptr_list_t *list = ptr_list_new();
 
-    list->ptrs = (void **) malloc(sizeof(void *) * capacity);
-    list->size = 0;
-    list->capacity = capacity;
-    list->iter_pos = 0;
+    if (capacity > PTR_LIST_INLINE_CAPACITY) {
+        list->ptrs = (void **) checked_realloc(NULL, sizeof(void *) * capacity);
+        list->capacity = capacity;
+    }
+
+    return list;
+}
+
+ptr_list_t *ptr_list_new_arena(arena_t *arena, size_t capacity) {
+    size_t extra = capacity > PTR_LIST_INLINE_CAPACITY ? capacity : 0;
+    ptr_list_t *list = (ptr_list_t *) arena_alloc(arena, sizeof(ptr_list_t) + sizeof(void *) * extra);
+
+    init_list(list);
+    list->arena = arena;
+
+    if (extra != 0) {
+        list->ptrs = (void **) (list + 1);
+        list->capacity = capacity;
+    }
 
     return list;
 }
 
 void ptr_list_free(ptr_list_t *list) {
-    free(list->ptrs);
+    if (list->arena != NULL) return;
+
+    if (list->ptrs != list->inline_ptrs) {
+        free(list->ptrs);
+    }
+
     free(list);
 }
 
@@ -55,14 +97,36 @@ void ptr_list_push(ptr_list_t *list, void *ptr) {
     list->ptrs[list->size++] = ptr;
 }
 
-size_t ptr_list_size(ptr_list_t *list) {
-    return list->size;
+void ptr_list_shrink_to_fit(ptr_list_t *list) {
+    if (list->arena != NULL || list->ptrs == list->inline_ptrs) return;
+
+    if (list->size <= PTR_LIST_INLINE_CAPACITY) {
+        memcpy(list->inline_ptrs, list->ptrs, sizeof(void *) * list->size);
+        free(list->ptrs);
+
+        list->ptrs = list->inline_ptrs;
+        list->capacity = PTR_LIST_INLINE_CAPACITY;
+        return;
+    }
+
+    list->ptrs = (void **) checked_realloc(list->ptrs, sizeof(void *) * list->size);
+    list->capacity = list->size;
+}
+
+void ptr_list_clear(ptr_list_t *list) {
+    list->size = 0;
+    list->iter_pos = 0;
 }
 
-void *ptr_list_at(ptr_list_t *list, size_t i) {
-    if (i >= list->size) return NULL;
+ptr_list_t *ptr_list_freeze(ptr_list_t *list, arena_t *arena) {
+    ptr_list_t *frozen = ptr_list_new_arena(arena, list->size);
+    memcpy(frozen->ptrs, list->ptrs, sizeof(void *) * list->size);
+    frozen->size = list->size;
+
+    list->size = 0;
+    list->iter_pos = 0;
 
-    return list->ptrs[i];
+    return frozen;
 }
 
 void *ptr_list_get(ptr_list_t *list) {
@@ -7,16 +7,71 @@
 
 #include <stddef.h>
 
-typedef struct ptr_list_t ptr_list_t;
+#include "arena.h"
+
+// Lists up to this size don't need any storage besides the list itself.
+#define PTR_LIST_INLINE_CAPACITY 4
+
+typedef struct ptr_list_t {
+    void **ptrs; // Points at inline_ptrs until the list outgrows it
+    size_t size;
+    size_t capacity;
+    size_t iter_pos;
+    arena_t *arena; // NULL if malloc'd
+    void *inline_ptrs[PTR_LIST_INLINE_CAPACITY];
+} ptr_list_t;
 
 ptr_list_t *ptr_list_new();
 ptr_list_t *ptr_list_new_capacity(size_t capacity);
+
+// The list and its storage live in the arena. ptr_list_free does nothing for these, they go away with the arena.
+ptr_list_t *ptr_list_new_arena(arena_t *arena, size_t capacity);
+
 void ptr_list_free(ptr_list_t *list);
 
 void ptr_list_push(ptr_list_t *list, void *ptr);
 
-size_t ptr_list_size(ptr_list_t *list);
-void *ptr_list_at(ptr_list_t *list, size_t i);
+// Removes all elements but keeps the storage.
+void ptr_list_clear(ptr_list_t *list);
+
+// Gives back unused capacity of a malloc'd list.
+void ptr_list_shrink_to_fit(ptr_list_t *list);
+
+/*
+ * Copies the list into an arena list of exactly the right size and empties the original, which keeps its storage.
+ * Meant for lists that are collected in a reused scratch list and never change after that, like the ones in the AST.
+ */
+ptr_list_t *ptr_list_freeze(ptr_list_t *list, arena_t *arena);
+
+static inline size_t ptr_list_size(ptr_list_t *list) {
+    return list->size;
+}
+
+static inline void *ptr_list_at(ptr_list_t *list, size_t i) {
+    if (i >= list->size) return NULL;
+
+    return list->ptrs[i];
+}
+
+// Only for indices known to be below ptr_list_size.
+#define ptr_list_at_unchecked(list, i) ((list)->ptrs[i])
+
+/* Stack methods, for lists used as explicit stacks when walking deep trees */
+
+// Only for non-empty lists.
+#define ptr_list_top(list) ((list)->ptrs[(list)->size - 1])
+
+// Removes and returns the last element, NULL if the list is empty.
+static inline void *ptr_list_pop(ptr_list_t *list) {
+    if (list->size == 0) return NULL;
+
+    return list->ptrs[--list->size];
+}
+
+// Drops every element from index size on, keeping the storage.
+static inline void ptr_list_truncate(ptr_list_t *list, size_t size) {
+    if (size < list->size) list->size = size;
+}
 
 /* Iterator methods */
 
@@ -0,0 +1,100 @@
+//
+// Created by sarah on 3/25/24.
+//
+
+#include "ptr_map.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#define INITIAL_CAPACITY 16 // Has to be a power of two
+
+static ptr_map_entry_t *checked_calloc(size_t count) {
+    ptr_map_entry_t *entries = (ptr_map_entry_t *) calloc(count, sizeof(ptr_map_entry_t));
+    if (entries == NULL) {
+        fprintf(stderr, "Failed to allocate pointer map!\n");
+        exit(1);
+    }
+
+    return entries;
+}
+
+// Pointers are aligned and close together, so the low bits are mixed into all the others before masking.
+static inline size_t hash_ptr(const void *key) {
+    uint64_t hash = (uint64_t) (uintptr_t) key;
+    hash ^= hash >> 33;
+    hash *= UINT64_C(0xff51afd7ed558ccd);
+    hash ^= hash >> 33;
+
+    return (size_t) hash;
+}
+
+// Returns the slot holding key, or the empty slot where it belongs.
+static ptr_map_entry_t *find_slot(ptr_map_entry_t *entries, size_t mask, const void *key) {
+    size_t i = hash_ptr(key) & mask;
+    while (entries[i].key != NULL && entries[i].key != key) {
+        i = (i + 1) & mask;
+    }
+
+    return &entries[i];
+}
+
+static void grow(ptr_map_t *map) {
+    size_t old_capacity = map->mask + 1;
+    size_t new_mask = old_capacity * 2 - 1;
+    ptr_map_entry_t *new_entries = checked_calloc(old_capacity * 2);
+
+    size_t i;
+    for (i = 0; i < old_capacity; i++) {
+        if (map->entries[i].key == NULL) continue;
+
+        *find_slot(new_entries, new_mask, map->entries[i].key) = map->entries[i];
+    }
+
+    free(map->entries);
+    map->entries = new_entries;
+    map->mask = new_mask;
+}
+
+ptr_map_t *ptr_map_new() {
+    ptr_map_t *map = (ptr_map_t *) malloc(sizeof(ptr_map_t));
+    map->entries = checked_calloc(INITIAL_CAPACITY);
+    map->size = 0;
+    map->mask = INITIAL_CAPACITY - 1;
+
+    return map;
+}
+
+void ptr_map_free(ptr_map_t *map) {
+    free(map->entries);
+    free(map);
+}
+
+void *ptr_map_get(ptr_map_t *map, const void *key) {
+    return find_slot(map->entries, map->mask, key)->value;
+}
+
+void *ptr_map_put(ptr_map_t *map, const void *key, void *value) {
+    // Kept at most half full, so probe sequences stay short
+    if ((map->size + 1) * 2 > map->mask + 1) grow(map);
+
+    ptr_map_entry_t *entry = find_slot(map->entries, map->mask, key);
+    void *previous = entry->value;
+
+    if (entry->key == NULL) {
+        entry->key = key;
+        map->size++;
+    }
+
+    entry->value = value;
+    return previous;
+}
+
+void ptr_map_clear(ptr_map_t *map) {
+    if (map->size == 0) return;
+
+    memset(map->entries, 0, sizeof(ptr_map_entry_t) * (map->mask + 1));
+    map->size = 0;
+}
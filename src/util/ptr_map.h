@@ -0,0 +1,41 @@
+//
+// Created by sarah on 3/25/24.
+//
+
+#ifndef PASTEL_PTR_MAP_H
+#define PASTEL_PTR_MAP_H
+
+#include <stddef.h>
+
+/*
+ * Open addressing hash map from pointers to pointers. Keys are compared by address, which is meant for interned
+ * strings: two names are equal exactly if they are the same pointer. NULL can't be used as a key.
+ */
+typedef struct ptr_map_entry_t {
+    const void *key; // NULL for empty slots
+    void *value;
+} ptr_map_entry_t;
+
+typedef struct ptr_map_t {
+    ptr_map_entry_t *entries;
+    size_t size;
+    size_t mask; // Capacity - 1, the capacity is a power of two
+} ptr_map_t;
+
+ptr_map_t *ptr_map_new();
+void ptr_map_free(ptr_map_t *map);
+
+// Returns NULL if the key isn't in the map.
+void *ptr_map_get(ptr_map_t *map, const void *key);
+
+// Inserts the key or replaces its value. Returns the value it had before, NULL if it's new.
+void *ptr_map_put(ptr_map_t *map, const void *key, void *value);
+
+// Removes all entries but keeps the storage.
+void ptr_map_clear(ptr_map_t *map);
+
+static inline size_t ptr_map_size(ptr_map_t *map) {
+    return map->size;
+}
+
+#endif //PASTEL_PTR_MAP_H
@@ -0,0 +1,84 @@
+//
+// Created by sarah on 3/18/24.
+//
+
+#include "source.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+struct source_t {
+    const char *data;
+    size_t size;
+    size_t mapped_size;
+};
+
+source_t *source_open(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Couldn't open %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        fprintf(stderr, "Couldn't stat %s: %s\n", path, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+
+    size_t size = (size_t) st.st_size;
+    size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+
+    /*
+     * Reserve one page more than the file needs. The tail of the last file page is zero filled by the kernel, and the
+     * extra anonymous page covers the case where the file size is an exact multiple of the page size, so the view is
+     * null-terminated either way without copying anything.
+     */
+    size_t mapped_size = (size / page_size + 1) * page_size;
+    char *data = (char *) mmap(NULL, mapped_size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "Couldn't map %s: %s\n", path, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+
+    if (size > 0) {
+        if (mmap(data, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+            fprintf(stderr, "Couldn't map %s: %s\n", path, strerror(errno));
+            munmap(data, mapped_size);
+            close(fd);
+            return NULL;
+        }
+
+        madvise(data, size, MADV_SEQUENTIAL);
+    }
+
+    close(fd);
+
+    source_t *source = (source_t *) malloc(sizeof(source_t));
+    source->data = data;
+    source->size = size;
+    source->mapped_size = mapped_size;
+
+    return source;
+}
+
+void source_close(source_t *source) {
+    munmap((void *) source->data, source->mapped_size);
+    free(source);
+}
+
+const char *source_data(source_t *source) {
+    return source->data;
+}
+
+size_t source_size(source_t *source) {
+    return source->size;
+}
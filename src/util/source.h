@@ -0,0 +1,22 @@
+//
+// Created by sarah on 3/18/24.
+//
+
+#ifndef PASTEL_SOURCE_H
+#define PASTEL_SOURCE_H
+
+#include <stddef.h>
+
+typedef struct source_t source_t;
+
+/*
+ * Maps the file at path read-only. The view is always followed by at least one null byte, so it can be handed to the
+ * lexer directly. Returns NULL if the file can't be opened or mapped.
+ */
+source_t *source_open(const char *path);
+void source_close(source_t *source);
+
+const char *source_data(source_t *source);
+size_t source_size(source_t *source);
+
+#endif //PASTEL_SOURCE_H
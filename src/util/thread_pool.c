@@ -0,0 +1,164 @@
+//
+// Created by sarah on 3/23/24.
+//
+
+#include "thread_pool.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+typedef struct thread_pool_job_t thread_pool_job_t;
+
+struct thread_pool_job_t {
+    thread_pool_job_t *next;
+    thread_task_t task;
+    void *arg;
+};
+
+struct thread_pool_t {
+    pthread_t *threads;
+    size_t thread_count;
+
+    pthread_mutex_t lock;
+    pthread_cond_t job_available;
+    pthread_cond_t all_done;
+
+    // Queue of jobs that no worker has picked up yet
+    thread_pool_job_t *head;
+    thread_pool_job_t *tail;
+
+    size_t unfinished; // Queued plus running
+    int stopping;
+};
+
+static void *checked_malloc(size_t size) {
+    void *ptr = malloc(size);
+    if (ptr == NULL) {
+        fprintf(stderr, "Out of memory in thread pool!\n");
+        exit(1);
+    }
+
+    return ptr;
+}
+
+static void *run_worker(void *arg) {
+    thread_pool_t *pool = (thread_pool_t *) arg;
+
+    pthread_mutex_lock(&pool->lock);
+
+    while (1) {
+        while (pool->head == NULL && !pool->stopping) {
+            pthread_cond_wait(&pool->job_available, &pool->lock);
+        }
+
+        if (pool->head == NULL) break; // Stopping and nothing left to do
+
+        thread_pool_job_t *job = pool->head;
+        pool->head = job->next;
+        if (pool->head == NULL) pool->tail = NULL;
+
+        pthread_mutex_unlock(&pool->lock);
+        job->task(job->arg);
+        free(job);
+        pthread_mutex_lock(&pool->lock);
+
+        if (--pool->unfinished == 0) {
+            pthread_cond_broadcast(&pool->all_done);
+        }
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+size_t thread_pool_cpu_count(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (size_t) count : 1;
+}
+
+thread_pool_t *thread_pool_new(size_t thread_count) {
+    if (thread_count == 0) thread_count = thread_pool_cpu_count();
+
+    thread_pool_t *pool = (thread_pool_t *) checked_malloc(sizeof(thread_pool_t));
+
+    pool->threads = (pthread_t *) checked_malloc(thread_count * sizeof(pthread_t));
+    pool->thread_count = 0;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->job_available, NULL);
+    pthread_cond_init(&pool->all_done, NULL);
+    pool->head = NULL;
+    pool->tail = NULL;
+    pool->unfinished = 0;
+    pool->stopping = 0;
+
+    size_t i;
+    for (i = 0; i < thread_count; i++) {
+        if (pthread_create(&pool->threads[i], NULL, run_worker, pool) != 0) {
+            fprintf(stderr, "Failed to start worker thread!\n");
+            break;
+        }
+
+        pool->thread_count++;
+    }
+
+    if (pool->thread_count == 0) {
+        thread_pool_free(pool);
+        return NULL;
+    }
+
+    return pool;
+}
+
+void thread_pool_free(thread_pool_t *pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->job_available);
+    pthread_mutex_unlock(&pool->lock);
+
+    size_t i;
+    for (i = 0; i < pool->thread_count; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->job_available);
+    pthread_cond_destroy(&pool->all_done);
+    free(pool->threads);
+    free(pool);
+}
+
+void thread_pool_submit(thread_pool_t *pool, thread_task_t task, void *arg) {
+    thread_pool_job_t *job = (thread_pool_job_t *) checked_malloc(sizeof(thread_pool_job_t));
+    job->next = NULL;
+    job->task = task;
+    job->arg = arg;
+
+    pthread_mutex_lock(&pool->lock);
+
+    if (pool->tail == NULL) {
+        pool->head = job;
+    } else {
+        pool->tail->next = job;
+    }
+    pool->tail = job;
+    pool->unfinished++;
+
+    pthread_cond_signal(&pool->job_available);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void thread_pool_wait(thread_pool_t *pool) {
+    pthread_mutex_lock(&pool->lock);
+
+    while (pool->unfinished > 0) {
+        pthread_cond_wait(&pool->all_done, &pool->lock);
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+}
+
+size_t thread_pool_size(thread_pool_t *pool) {
+    return pool->thread_count;
+}
@@ -0,0 +1,34 @@
+//
+// Created by sarah on 3/23/24.
+//
+
+#ifndef PASTEL_THREAD_POOL_H
+#define PASTEL_THREAD_POOL_H
+
+#include <stddef.h>
+
+/*
+ * Fixed set of worker threads that run submitted tasks in submission order. Used to spread the front end of large
+ * sources over all cores; tasks must not submit further tasks and then wait for them.
+ */
+typedef struct thread_pool_t thread_pool_t;
+
+typedef void (*thread_task_t)(void *arg);
+
+// A thread_count of 0 uses one thread per online CPU.
+thread_pool_t *thread_pool_new(size_t thread_count);
+
+// Waits for all pending tasks, then stops the workers.
+void thread_pool_free(thread_pool_t *pool);
+
+void thread_pool_submit(thread_pool_t *pool, thread_task_t task, void *arg);
+
+// Blocks until every task submitted so far has finished.
+void thread_pool_wait(thread_pool_t *pool);
+
+size_t thread_pool_size(thread_pool_t *pool);
+
+// Number of online CPUs, at least 1.
+size_t thread_pool_cpu_count(void);
+
+#endif //PASTEL_THREAD_POOL_H